@@ -0,0 +1,293 @@
+#include "AsyncPcapReader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PerfCounters.h"
+#include "log.h"
+
+AsyncPcapReader::AsyncPcapReader(const std::string& filename)
+	: filename(filename), storage(CHUNK_COUNT * (MAX_RECORD_SIZE + CHUNK_SIZE), "async pcap chunks") {
+	if (!storage.data()) {
+		return;
+	}
+	// The storage is page aligned, and so is every chunk since both sizes are multiples of ALIGNMENT
+	for (size_t i = 0; i < CHUNK_COUNT; ++i) {
+		chunks[i].data = static_cast<uint8_t*>(storage.data()) + i * (MAX_RECORD_SIZE + CHUNK_SIZE) + MAX_RECORD_SIZE;
+	}
+
+	fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+	direct = fd >= 0;
+	if (fd < 0 && errno == EINVAL) {
+		fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+	if (fd < 0) {
+		LOG_ERROR("Cannot open file: " << filename << ": " << std::strerror(errno));
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		LOG_ERROR("Cannot stat " << filename << ": " << std::strerror(errno));
+		return;
+	}
+	fileSize = static_cast<uint64_t>(info.st_size);
+
+	// Some file systems accept O_DIRECT on open and only reject the reads
+	if (direct && pread(fd, chunks[0].data, ALIGNMENT, 0) < 0 && errno == EINVAL) {
+		::close(fd);
+		fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+		direct = false;
+		if (fd < 0) {
+			LOG_ERROR("Cannot open file: " << filename << ": " << std::strerror(errno));
+			return;
+		}
+	}
+
+	ring = std::make_unique<IoUring>(CHUNK_COUNT);
+	if (!ring->isValid()) {
+		LOG_INFO("io_uring is not available (" << ring->getError() << "), reading with pread");
+		ring.reset();
+	}
+	LOG_INFO("Reading " << filename << " (" << fileSize << " bytes) with " << (ring ? "io_uring" : "pread")
+			<< (direct ? ", O_DIRECT" : " through the page cache") << ", " << CHUNK_COUNT << " reads of "
+			<< CHUNK_SIZE / (1024 * 1024) << " MB ahead");
+
+	readFileHeader();
+}
+
+AsyncPcapReader::~AsyncPcapReader() {
+	// The kernel may still be writing into the chunks
+	drain();
+	if (fd >= 0) {
+		::close(fd);
+	}
+}
+
+void AsyncPcapReader::startAt(uint64_t offset) {
+	drain();
+	uint64_t aligned = offset / ALIGNMENT * ALIGNMENT;
+	skip = offset - aligned;
+	nextReadOffset = aligned;
+	// The first advance moves to chunk 0
+	current = CHUNK_COUNT - 1;
+	holdingChunk = false;
+	cursor = end = nullptr;
+	for (size_t i = 0; i < CHUNK_COUNT; ++i) {
+		queueChunk(i);
+	}
+}
+
+void AsyncPcapReader::queueChunk(size_t index) {
+	Chunk& chunk = chunks[index];
+	chunk.offset = nextReadOffset;
+	chunk.filled = 0;
+	chunk.error = 0;
+	if (nextReadOffset >= fileSize) {
+		chunk.length = 0;
+		return;
+	}
+	// Rounded up for O_DIRECT; the read stops short at the end of the file
+	chunk.length = std::min<uint64_t>(CHUNK_SIZE, (fileSize - nextReadOffset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+	nextReadOffset += chunk.length;
+	if (ring) {
+		// A failed submission stays queued and is reported when the chunk is awaited
+		issue(index);
+		ring->submit(false);
+	}
+}
+
+void AsyncPcapReader::issue(size_t index) {
+	Chunk& chunk = chunks[index];
+	// At most CHUNK_COUNT reads are in flight, so the submission ring always has room
+	ring->queueRead(fd, chunk.data + chunk.filled, static_cast<uint32_t>(chunk.length - chunk.filled),
+			chunk.offset + chunk.filled, index);
+	chunk.inFlight = true;
+	inFlight++;
+}
+
+void AsyncPcapReader::reap() {
+	uint64_t index;
+	int32_t result;
+	bool reissued = false;
+	while (ring->popCompletion(index, result)) {
+		Chunk& chunk = chunks[index];
+		chunk.inFlight = false;
+		inFlight--;
+		if (result == -EAGAIN || result == -EINTR) {
+			issue(index);
+			reissued = true;
+		} else if (result < 0) {
+			chunk.error = -result;
+		} else if (result == 0) {
+			chunk.length = chunk.filled;   // The file shrank
+		} else {
+			chunk.filled += static_cast<size_t>(result);
+			if (chunk.filled < chunk.length && chunk.offset + chunk.filled < fileSize) {
+				issue(index);
+				reissued = true;
+			}
+		}
+	}
+	if (reissued) {
+		ring->submit(false);
+	}
+}
+
+bool AsyncPcapReader::awaitChunk(size_t index) {
+	Chunk& chunk = chunks[index];
+	if (ring) {
+		while (chunk.inFlight) {
+			if (!ring->submit(true)) {
+				chunk.error = errno;
+				break;
+			}
+			reap();
+		}
+	} else {
+		while (chunk.error == 0 && chunk.filled < chunk.length) {
+			ssize_t n = pread(fd, chunk.data + chunk.filled, chunk.length - chunk.filled,
+					static_cast<off_t>(chunk.offset + chunk.filled));
+			if (n < 0 && errno != EINTR) {
+				chunk.error = errno;
+			} else if (n == 0) {
+				break;
+			} else if (n > 0) {
+				chunk.filled += static_cast<size_t>(n);
+			}
+		}
+	}
+	if (chunk.error != 0) {
+		LOG_ERROR("Reading " << filename << " at offset " << chunk.offset << " failed: " << std::strerror(chunk.error));
+		return false;
+	}
+	return chunk.filled > 0;
+}
+
+void AsyncPcapReader::drain() {
+	while (ring && inFlight > 0) {
+		if (!ring->submit(true)) {
+			break;
+		}
+		uint64_t index;
+		int32_t result;
+		while (ring->popCompletion(index, result)) {
+			chunks[index].inFlight = false;
+			inFlight--;
+		}
+	}
+}
+
+bool AsyncPcapReader::advanceChunk() {
+	size_t remainder = static_cast<size_t>(end - cursor);
+	size_t next = (current + 1) % CHUNK_COUNT;
+	if (!awaitChunk(next)) {
+		if (remainder > 0 && chunks[next].error == 0) {
+			LOG_WARNING(filename << " ends inside a record, " << remainder << " bytes dropped");
+		}
+		return false;
+	}
+
+	// The partial record moves into the carry room right in front of the next chunk's data
+	Chunk& chunk = chunks[next];
+	std::memcpy(chunk.data - remainder, cursor, remainder);
+	cursor = chunk.data - remainder + skip;
+	end = chunk.data + chunk.filled;
+	skip = 0;
+
+	if (holdingChunk) {
+		queueChunk(current);
+	}
+	holdingChunk = true;
+	current = next;
+	return true;
+}
+
+void AsyncPcapReader::readFileHeader() {
+	startAt(0);
+	while (static_cast<size_t>(end - cursor) < sizeof(PCAPFileHeader)) {
+		if (!advanceChunk()) {
+			LOG_ERROR(filename << " ends before its pcap file header");
+			return;
+		}
+	}
+
+	PCAPFileHeader fileHeader;
+	std::memcpy(&fileHeader, cursor, sizeof(fileHeader));
+	cursor += sizeof(fileHeader);
+	uint32_t magic = le32toh(fileHeader.magic_number);
+	if (magic != PCAP_MAGIC_MICROSECONDS && magic != PCAP_MAGIC_NANOSECONDS) {
+		LOG_ERROR("Invalid PCAP file format. Unrecognized magic number 0x" << std::hex << magic << std::dec);
+		return;
+	}
+	nanosecondTimestamps = (magic == PCAP_MAGIC_NANOSECONDS);
+	nextPacketOffset = sizeof(PCAPFileHeader);
+	is_valid = true;
+}
+
+bool AsyncPcapReader::seek(uint64_t offset) {
+	if (offset < sizeof(PCAPFileHeader) || offset > fileSize) {
+		LOG_WARNING("Cannot seek to offset " << offset << ", file size is " << fileSize);
+		return false;
+	}
+	startAt(offset);
+	nextPacketOffset = offset;
+	return true;
+}
+
+bool AsyncPcapReader::nextPacket(CapturedPacket& packet) {
+	if (!is_valid) {
+		return false;
+	}
+	for (;;) {
+		if (perfCounters) {
+			perfCounters->begin();
+		}
+		size_t available = static_cast<size_t>(end - cursor);
+		if (available >= sizeof(PCAPPacketHeader)) {
+			PCAPPacketHeader header;
+			std::memcpy(&header, cursor, sizeof(header));
+			header.ts_sec = le32toh(header.ts_sec);
+			header.ts_usec = le32toh(header.ts_usec);
+			header.incl_len = le32toh(header.incl_len);
+			header.orig_len = le32toh(header.orig_len);
+			if (header.incl_len > MAX_RECORD_SIZE - sizeof(header)) {
+				LOG_ERROR("Pcap record " << packetCount + 1 << " at offset " << nextPacketOffset << " claims "
+						<< header.incl_len << " bytes, file is corrupt");
+				is_valid = false;
+				return false;
+			}
+
+			size_t recordSize = sizeof(header) + header.incl_len;
+			if (available >= recordSize) {
+				const uint8_t* frame = cursor + sizeof(header);
+				cursor += recordSize;
+				nextPacketOffset += recordSize;
+				++packetCount;
+				if (perfCounters) {
+					perfCounters->end(PerfStage::PcapRead);
+					perfCounters->begin();
+				}
+				bool parsed = parseLinkLayer(frame, header.incl_len, packet);
+				if (perfCounters) {
+					perfCounters->end(PerfStage::LinkParse);
+				}
+				if (parsed) {
+					packet.captureTime = pcapCaptureTimeNs(header, nanosecondTimestamps);
+					return true;
+				}
+				continue;
+			}
+		}
+		bool advanced = advanceChunk();
+		if (perfCounters) {
+			perfCounters->end(PerfStage::PcapRead);
+		}
+		if (!advanced) {
+			return false;
+		}
+	}
+}
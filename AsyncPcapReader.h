@@ -0,0 +1,98 @@
+// AsyncPcapReader.h
+
+#ifndef ASYNC_PCAP_READER_H
+#define ASYNC_PCAP_READER_H
+
+#include <memory>
+#include <string>
+
+#include "IoUring.h"
+#include "PCAPParser.h"
+#include "Placement.h"
+
+// Reads a pcap file at device speed when it is not in the page cache, e.g. a
+// cold capture on NVMe. The file is opened with O_DIRECT and read in large
+// chunks through io_uring, keeping CHUNK_COUNT reads queued so the device is
+// never idle while records are parsed. Chunks are consumed in file order and
+// records are parsed in place; the few bytes of a record that straddles two
+// chunks are copied into carry room in front of the next chunk, as in
+// PcapStreamReader. Without io_uring the chunks are read with pread(2), and
+// without O_DIRECT support (tmpfs, some network file systems) through the
+// page cache.
+class AsyncPcapReader : public SeekablePacketSource {
+	public:
+		static constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024;
+		static constexpr unsigned CHUNK_COUNT = 4;
+		// O_DIRECT offsets, lengths and buffers must be multiples of the logical block size
+		static constexpr size_t ALIGNMENT = 4096;
+		// Largest snaplen plus room for a pcap record header; carry room keeps chunks aligned
+		static constexpr size_t MAX_RECORD_SIZE = 262144 + 4096;
+		static_assert(MAX_RECORD_SIZE % ALIGNMENT == 0 && CHUNK_SIZE % ALIGNMENT == 0);
+
+		explicit AsyncPcapReader(const std::string& filename);
+		~AsyncPcapReader();
+
+		AsyncPcapReader(const AsyncPcapReader&) = delete;
+		AsyncPcapReader& operator=(const AsyncPcapReader&) = delete;
+
+		bool isValid() const override { return is_valid; }
+
+		bool nextPacket(CapturedPacket& packet) override;
+
+		void setPerfCounters(PerfCounters* counters) noexcept override { perfCounters = counters; }
+
+		uint64_t position() const override { return nextPacketOffset; }
+		bool seek(uint64_t offset) override;
+		uint64_t getFileSize() const override { return fileSize; }
+
+	private:
+		struct Chunk {
+			uint8_t* data = nullptr;     // CHUNK_SIZE bytes, preceded by MAX_RECORD_SIZE bytes of carry room
+			uint64_t offset = 0;         // File offset of data[0]
+			size_t length = 0;           // Bytes requested
+			size_t filled = 0;
+			bool inFlight = false;
+			int error = 0;               // errno of a failed read
+		};
+
+		// Restarts reading at offset: waits for reads in flight, then queues the first chunks
+		void startAt(uint64_t offset);
+		// Queues the read of the next chunk of the file into chunks[index], if any is left
+		void queueChunk(size_t index);
+		void issue(size_t index);
+		// Waits until chunks[index] holds its whole range or the rest of the file;
+		// false at the end of the file or on a read error
+		bool awaitChunk(size_t index);
+		// Accounts finished reads, queueing the rest of short ones again
+		void reap();
+		// Waits for every read in flight, e.g. before the chunks are reused
+		void drain();
+		// Releases the current chunk and moves to the next, carrying over a partial record
+		bool advanceChunk();
+		void readFileHeader();
+
+		std::string filename;
+		int fd = -1;
+		bool direct = false;
+		std::unique_ptr<IoUring> ring;   // Null when reading with pread(2)
+		unsigned inFlight = 0;
+
+		HugePageBuffer storage;
+		Chunk chunks[CHUNK_COUNT];
+		size_t current = 0;
+		bool holdingChunk = false;       // chunks[current] is complete and being parsed
+		uint64_t nextReadOffset = 0;     // Of the next chunk to queue
+		uint64_t skip = 0;               // Bytes before the start offset in the first chunk
+		const uint8_t* cursor = nullptr;
+		const uint8_t* end = nullptr;
+
+		bool is_valid = false;
+		bool nanosecondTimestamps = false;
+		uint64_t fileSize = 0;
+		uint64_t nextPacketOffset = 0;
+		uint64_t packetCount = 0;
+
+		PerfCounters* perfCounters = nullptr;
+};
+
+#endif // ASYNC_PCAP_READER_H
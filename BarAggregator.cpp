@@ -0,0 +1,105 @@
+#include "BarAggregator.h"
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
+BarAggregator::BarAggregator(uint64_t intervalNs, BarHandler onClose, size_t historySize)
+	: interval(std::max<uint64_t>(intervalNs, 1)), historySize(std::max<size_t>(historySize, 1)),
+	onClose(std::move(onClose)) {}
+
+void BarAggregator::onExecution(const OrderExecution& execution, uint64_t transactTime) {
+	uint64_t start = transactTime - transactTime % interval;
+	if (start > currentStart) {
+		closeAll();
+		currentStart = start;
+	} else if (start < currentStart) [[unlikely]] {
+		// Reordered input: counted, and folded into the current interval
+		lateTrades++;
+	}
+
+	uint32_t index = instruments.assign(execution.SecurityID);
+	if (index == series.size()) [[unlikely]] {
+		series.emplace_back();
+		history.resize(series.size() * historySize);
+	}
+
+	Series& s = series[index];
+	Bar& bar = s.current;
+	if (!s.open) {
+		bar = Bar{};
+		bar.securityId = execution.SecurityID;
+		bar.startTime = currentStart;
+		bar.interval = interval;
+		bar.open = bar.high = bar.low = execution.LastPx;
+		s.open = true;
+		openSeries.push_back(index);
+	}
+
+	if (execution.LastPx.mantissa > bar.high.mantissa) {
+		bar.high = execution.LastPx;
+	}
+	if (execution.LastPx.mantissa < bar.low.mantissa) {
+		bar.low = execution.LastPx;
+	}
+	bar.close = execution.LastPx;
+	bar.volume += execution.LastQty;
+	bar.notional += BarNotional{execution.LastPx.mantissa} * execution.LastQty;
+	bar.tradeCount++;
+}
+
+void BarAggregator::closeAll() {
+	for (uint32_t index : openSeries) {
+		close(index);
+	}
+	openSeries.clear();
+}
+
+void BarAggregator::reserve(size_t instrumentCount) {
+	instruments.reserve(instrumentCount);
+	series.reserve(instrumentCount);
+	history.reserve(instrumentCount * historySize);
+}
+
+void BarAggregator::close(uint32_t index) {
+	Series& s = series[index];
+	history[index * historySize + s.next] = s.current;
+	s.next = (s.next + 1) % historySize;
+	s.count = std::min(s.count + 1, historySize);
+	s.open = false;
+	barsClosed++;
+
+	if (onClose) {
+		onClose(s.current);
+	}
+}
+
+const Bar* BarAggregator::currentBar(int32_t securityId) const {
+	uint32_t index = instruments.find(securityId);
+	return (index != InstrumentIndex::NOT_FOUND && series[index].open) ? &series[index].current : nullptr;
+}
+
+std::optional<uint64_t> BarAggregator::parseInterval(std::string_view text) {
+	uint64_t value = 0;
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (error != std::errc() || value == 0) {
+		return std::nullopt;
+	}
+
+	std::string_view unit(end, static_cast<size_t>(text.data() + text.size() - end));
+	uint64_t scale = 0;
+	if (unit == "ms") {
+		scale = 1000000;
+	} else if (unit.empty() || unit == "s") {
+		scale = 1000000000;
+	} else if (unit == "m") {
+		scale = 60ULL * 1000000000;
+	} else if (unit == "h") {
+		scale = 3600ULL * 1000000000;
+	} else {
+		return std::nullopt;
+	}
+	if (value > std::numeric_limits<uint64_t>::max() / scale) {
+		return std::nullopt;
+	}
+	return value * scale;
+}
@@ -0,0 +1,116 @@
+// BarAggregator.h
+
+#ifndef BAR_AGGREGATOR_H
+#define BAR_AGGREGATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "InstrumentIndex.h"
+#include "SimbaDecoder.h"
+
+// 128-bit accumulator: a day of mantissa * quantity products overflows 64 bits
+__extension__ typedef __int128 BarNotional;
+
+// One OHLCV bar of an instrument. Prices are exact Decimal5 values; the
+// notional is kept exactly in mantissa units and divided once, so the VWAP
+// is the true average rounded to the price grid.
+struct Bar {
+	int32_t securityId = 0;
+	uint64_t startTime = 0;      // ns since epoch, a multiple of interval
+	uint64_t interval = 0;       // ns
+	Decimal5 open{0};
+	Decimal5 high{0};
+	Decimal5 low{0};
+	Decimal5 close{0};
+	int64_t volume = 0;
+	BarNotional notional = 0;    // Sum of LastPx mantissa * LastQty
+	uint32_t tradeCount = 0;
+
+	// Rounded half away from zero
+	[[nodiscard]] Decimal5 vwap() const noexcept {
+		if (volume <= 0) {
+			return close;
+		}
+		BarNotional half = volume / 2;
+		BarNotional rounded = notional >= 0 ? notional + half : notional - half;
+		return Decimal5{static_cast<int64_t>(rounded / volume)};
+	}
+};
+
+using BarHandler = std::function<void(const Bar&)>;
+
+// Rolls OrderExecutions into fixed-interval OHLCV/VWAP bars per instrument.
+// Every execution is O(1): it updates the instrument's open bar. Bars are
+// aligned to the interval on exchange time (the packet TransactTime), and
+// when an execution falls into a later interval every open bar is closed,
+// handed to the handler and stored in its instrument's history ring.
+// Instruments are numbered by an InstrumentIndex; their series and rings of
+// historySize bars live in flat arrays indexed by it, preallocated by
+// reserve(). Intervals without trades produce no bar.
+class BarAggregator {
+	public:
+		static constexpr size_t DEFAULT_HISTORY = 1024;
+
+		BarAggregator(uint64_t intervalNs, BarHandler onClose = {}, size_t historySize = DEFAULT_HISTORY);
+
+		// transactTime is the TransactTime of the packet carrying the execution
+		void onExecution(const OrderExecution& execution, uint64_t transactTime);
+
+		// Closes all open bars, e.g. at the end of the input
+		void closeAll();
+
+		// Sizes series and history storage for a known instrument universe
+		void reserve(size_t instrumentCount);
+
+		// Open bar of an instrument, or nullptr if it has no trades in the current interval
+		[[nodiscard]] const Bar* currentBar(int32_t securityId) const;
+
+		// Calls fn(const Bar&) for the retained closed bars of an instrument, oldest first
+		template<typename Fn>
+		void forEachClosedBar(int32_t securityId, Fn&& fn) const {
+			uint32_t index = instruments.find(securityId);
+			if (index == InstrumentIndex::NOT_FOUND) {
+				return;
+			}
+			const Series& s = series[index];
+			const Bar* ring = history.data() + index * historySize;
+			size_t first = (s.next + historySize - s.count) % historySize;
+			for (size_t i = 0; i < s.count; ++i) {
+				fn(ring[(first + i) % historySize]);
+			}
+		}
+
+		[[nodiscard]] uint64_t getInterval() const noexcept { return interval; }
+		[[nodiscard]] uint64_t getBarsClosed() const noexcept { return barsClosed; }
+		[[nodiscard]] uint64_t getLateTrades() const noexcept { return lateTrades; }
+
+		// Parses "250ms", "1s", "5m", "1h" or a plain number of seconds into nanoseconds
+		static std::optional<uint64_t> parseInterval(std::string_view text);
+
+	private:
+		struct Series {
+			Bar current;
+			bool open = false;
+			size_t next = 0;             // Position in the history ring of the next closed bar
+			size_t count = 0;
+		};
+
+		void close(uint32_t index);
+
+		uint64_t interval;
+		size_t historySize;
+		BarHandler onClose;
+		InstrumentIndex instruments;
+		std::vector<Series> series;        // series[i] belongs to instruments.securityIdAt(i)
+		std::vector<Bar> history;          // historySize closed bars per instrument, in index order
+		std::vector<uint32_t> openSeries;  // Instruments with an open bar, closed together
+		uint64_t currentStart = 0;
+		uint64_t barsClosed = 0;
+		uint64_t lateTrades = 0;
+};
+
+#endif // BAR_AGGREGATOR_H
@@ -0,0 +1,175 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+
+#include "log.h"
+
+namespace {
+
+uint64_t steadyNowNs() noexcept {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t peakRssBytes() {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;   // Linux reports kilobytes
+}
+
+// Exact percentile of sorted samples
+uint64_t percentile(const std::vector<uint32_t>& sorted, double p) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()));
+	return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+double perSecond(double amount, uint64_t elapsedNs) {
+	return elapsedNs ? amount * 1e9 / static_cast<double>(elapsedNs) : 0.0;
+}
+
+} // namespace
+
+Benchmark::Benchmark(const BenchmarkConfig& config) : config(config) {}
+
+bool Benchmark::load(PacketSource& source) {
+	CapturedPacket packet;
+	while (source.nextPacket(packet)) {
+		packets.push_back(Packet{arena.size(), static_cast<uint32_t>(packet.length), packet.captureTime});
+		arena.insert(arena.end(), packet.data, packet.data + packet.length);
+	}
+	arena.shrink_to_fit();
+	LOG_INFO("Benchmark: preloaded " << packets.size() << " packets, " << arena.size() << " payload bytes");
+	return !packets.empty();
+}
+
+uint64_t Benchmark::decodePass(SimbaDecoder& decoder, uint32_t* samples) {
+	uint64_t passStart = steadyNowNs();
+	if (!samples) {
+		for (const Packet& packet : packets) {
+			decoder.decodeEvents(arena.data() + packet.offset, packet.length, packet.captureTime, events);
+		}
+		return steadyNowNs() - passStart;
+	}
+
+	uint64_t previous = passStart;
+	for (const Packet& packet : packets) {
+		decoder.decodeEvents(arena.data() + packet.offset, packet.length, packet.captureTime, events);
+		uint64_t now = steadyNowNs();
+		*samples++ = static_cast<uint32_t>(std::min<uint64_t>(now - previous, UINT32_MAX));
+		previous = now;
+	}
+	return previous - passStart;
+}
+
+uint64_t Benchmark::decodeBatchPass(SimbaDecoder& decoder, uint32_t* samples) {
+	uint64_t passStart = steadyNowNs();
+	if (!samples) {
+		for (size_t first = 0; first < spans.size(); first += config.batchSize) {
+			decoder.decodeBatch(spans.data() + first, std::min(config.batchSize, spans.size() - first), batchResults);
+		}
+		return steadyNowNs() - passStart;
+	}
+
+	uint64_t previous = passStart;
+	for (size_t first = 0; first < spans.size(); first += config.batchSize) {
+		size_t count = std::min(config.batchSize, spans.size() - first);
+		decoder.decodeBatch(spans.data() + first, count, batchResults);
+		uint64_t now = steadyNowNs();
+		// Amortised: every packet of the batch is charged an equal share
+		uint32_t share = static_cast<uint32_t>(std::min<uint64_t>((now - previous) / count, UINT32_MAX));
+		samples = std::fill_n(samples, count, share);
+		previous = now;
+	}
+	return previous - passStart;
+}
+
+uint64_t Benchmark::countMessages(const DecoderSetup& setup) {
+	SimbaDecoder decoder;
+	setup(decoder);
+	uint64_t messages = 0;
+	for (const Packet& packet : packets) {
+		if (decoder.decodeEvents(arena.data() + packet.offset, packet.length, packet.captureTime, events)) {
+			// Every SBE message starts one event; snapshot entries continue theirs
+			messages += static_cast<uint64_t>(std::count_if(events.begin(), events.end(),
+					[](const DecodedEvent& event) { return event.type != DecodedEventType::SnapshotEntry; }));
+		}
+	}
+	return messages;
+}
+
+BenchmarkResult Benchmark::run(const DecoderSetup& setup) {
+	BenchmarkResult result;
+	result.packets = packets.size();
+	result.iterations = config.iterations;
+	result.latencyIterations = config.latencyIterations;
+	result.batchSize = config.batchSize;
+	for (const Packet& packet : packets) {
+		result.payloadBytes += packet.length;
+	}
+
+	// Allocated up front so the measured passes do not grow it
+	std::vector<uint32_t> samples(packets.size() * config.latencyIterations);
+	spans.clear();
+	for (const Packet& packet : packets) {
+		spans.push_back(PacketSpan{arena.data() + packet.offset, packet.length, packet.captureTime});
+	}
+	auto pass = [&](uint32_t* passSamples) {
+		SimbaDecoder decoder;
+		setup(decoder);
+		return config.batchSize > 0 ? decodeBatchPass(decoder, passSamples) : decodePass(decoder, passSamples);
+	};
+
+	bool logging = Logger::is_enabled();
+	Logger::set_enabled(false);
+	result.messages = countMessages(setup);
+	for (unsigned i = 0; i < config.warmupIterations; ++i) {
+		pass(nullptr);
+	}
+	for (unsigned i = 0; i < config.iterations; ++i) {
+		uint64_t passNs = pass(nullptr);
+		result.elapsedNs += passNs;
+		result.bestPassNs = i == 0 ? passNs : std::min(result.bestPassNs, passNs);
+	}
+	for (unsigned i = 0; i < config.latencyIterations; ++i) {
+		pass(samples.data() + i * packets.size());
+	}
+	Logger::set_enabled(logging);
+
+	std::sort(samples.begin(), samples.end());
+	result.p50Ns = percentile(samples, 50.0);
+	result.p99Ns = percentile(samples, 99.0);
+	result.p999Ns = percentile(samples, 99.9);
+	result.maxNs = samples.empty() ? 0 : samples.back();
+	result.peakRssBytes = peakRssBytes();
+	return result;
+}
+
+void Benchmark::printReport(const BenchmarkResult& result) {
+	uint64_t passNs = result.iterations ? result.elapsedNs / result.iterations : 0;
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(1)
+		<< "Benchmark: " << result.iterations << " passes of " << result.packets << " packets, "
+		<< result.messages << " messages, " << result.payloadBytes << " payload bytes\n"
+		<< "  mean pass " << static_cast<double>(passNs) / 1e6 << " ms, best "
+		<< static_cast<double>(result.bestPassNs) / 1e6 << " ms\n"
+		<< "  " << static_cast<uint64_t>(perSecond(static_cast<double>(result.packets), passNs)) << " packets/s, "
+		<< static_cast<uint64_t>(perSecond(static_cast<double>(result.messages), passNs)) << " messages/s, "
+		<< perSecond(static_cast<double>(result.payloadBytes), passNs) / 1e6 << " MB/s\n";
+	if (result.latencyIterations > 0) {
+		report << "  per packet, " << result.latencyIterations << " timed passes"
+			<< (result.batchSize > 0 ? " (batches of " + std::to_string(result.batchSize) + ")" : std::string())
+			<< ": p50=" << result.p50Ns << " p99=" << result.p99Ns
+			<< " p99.9=" << result.p999Ns << " max=" << result.maxNs << " ns\n";
+	}
+	report << "  peak RSS " << static_cast<double>(result.peakRssBytes) / (1024.0 * 1024.0) << " MB";
+
+	std::cout << report.str() << std::endl;
+	LOG_INFO(report.str());
+}
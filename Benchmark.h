@@ -0,0 +1,80 @@
+// Benchmark.h
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "DecodedEvent.h"
+#include "PCAPParser.h"
+#include "SimbaDecoder.h"
+
+struct BenchmarkConfig {
+	unsigned iterations = 5;          // Throughput passes over the capture
+	unsigned latencyIterations = 1;   // Further passes timing every packet, for the percentiles
+	unsigned warmupIterations = 1;    // Unmeasured passes that warm caches and allocators
+	size_t batchSize = 0;             // Packets per decodeBatch() call, 0 for decodeEvents() per packet
+};
+
+struct BenchmarkResult {
+	uint64_t packets = 0;             // Per pass
+	uint64_t messages = 0;            // SBE messages, whatever the templates of their packet
+	uint64_t payloadBytes = 0;
+	unsigned iterations = 0;
+	unsigned latencyIterations = 0;
+	size_t batchSize = 0;
+	uint64_t elapsedNs = 0;           // All throughput passes
+	uint64_t bestPassNs = 0;
+	uint64_t p50Ns = 0;               // Per-packet decodeEvents() time, or batch time / batch size
+	uint64_t p99Ns = 0;
+	uint64_t p999Ns = 0;
+	uint64_t maxNs = 0;
+	uint64_t peakRssBytes = 0;
+};
+
+// End-to-end decoder throughput on a capture held in memory. load() reads the
+// SIMBA payloads of every packet into one contiguous arena once; run() then
+// feeds them to a freshly set up decoder per pass through decodeEvents(), or
+// decodeBatch() when batching. Throughput passes read the clock only around
+// the whole pass; separate latency passes time each call for the
+// percentiles. Messages are counted once, in an unmeasured pass. File I/O
+// happens only in load() and logging is suspended while passes run, so
+// neither is part of the figures.
+class Benchmark {
+	public:
+		explicit Benchmark(const BenchmarkConfig& config = {});
+
+		// Preloads every packet of source; returns false if it yields none
+		bool load(PacketSource& source);
+
+		// Applies the decoder settings (fragment limits, skipping, instruments) to each pass's decoder
+		using DecoderSetup = std::function<void(SimbaDecoder&)>;
+
+		BenchmarkResult run(const DecoderSetup& setup);
+
+		static void printReport(const BenchmarkResult& result);
+
+	private:
+		struct Packet {
+			size_t offset;
+			uint32_t length;
+			uint64_t captureTime;
+		};
+
+		// One full pass; with samples, per-packet times are appended to it, otherwise the
+		// clock is read only at the start and end of the pass
+		uint64_t decodePass(SimbaDecoder& decoder, uint32_t* samples);
+		uint64_t decodeBatchPass(SimbaDecoder& decoder, uint32_t* samples);
+		uint64_t countMessages(const DecoderSetup& setup);
+
+		BenchmarkConfig config;
+		std::vector<uint8_t> arena;
+		std::vector<Packet> packets;
+		std::vector<PacketSpan> spans;                          // packets as decodeBatch() input
+		std::vector<std::optional<DecodedMessage>> batchResults;
+		std::vector<DecodedEvent> events;
+};
+
+#endif // BENCHMARK_H
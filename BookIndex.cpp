@@ -0,0 +1,196 @@
+#include "BookIndex.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+
+BookIndexWriter::BookIndexWriter(const std::string& path, uint64_t intervalNs, const std::string& pcapFile,
+		uint64_t pcapFileSize, uint64_t startOffset)
+	: path(path), tmpPath(path + ".tmp") {
+	file.open(tmpPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		LOG_ERROR("Cannot create book index " << tmpPath);
+		return;
+	}
+	header.magic = BOOK_INDEX_MAGIC;
+	header.version = BOOK_INDEX_VERSION;
+	header.intervalNs = intervalNs;
+	header.pcapFileSize = pcapFileSize;
+	std::snprintf(header.pcapFile, sizeof(header.pcapFile), "%s", pcapFile.c_str());
+	// Rewritten with the directory offsets by finish()
+	append(&header, sizeof(header));
+
+	// Before the first boundary every book is empty
+	boundaries.push_back(BookIndexBoundary{0, startOffset, 0, 0});
+}
+
+void BookIndexWriter::append(const void* data, size_t length) {
+	if (!file.write(static_cast<const char*>(data), static_cast<std::streamsize>(length))) {
+		failed = true;
+	}
+	fileOffset += length;
+}
+
+void BookIndexWriter::onMessage(const std::vector<int32_t>& changed, const OrderBookManager& books,
+		uint64_t transactTime, uint32_t msgSeqNum, uint64_t pcapOffset) {
+	for (int32_t securityId : changed) {
+		uint32_t index = dirtyIndex.assign(securityId);
+		if (index == dirty.size()) {
+			dirty.push_back(0);
+		}
+		if (!dirty[index]) {
+			dirty[index] = 1;
+			dirtyList.push_back(securityId);
+		}
+	}
+
+	if (transactTime >= nextBoundaryTime) {
+		if (nextBoundaryTime != 0) {
+			writeBoundary(books, transactTime, msgSeqNum, pcapOffset);
+		}
+		nextBoundaryTime = (transactTime / header.intervalNs + 1) * header.intervalNs;
+	}
+}
+
+void BookIndexWriter::writeBoundary(const OrderBookManager& books, uint64_t transactTime, uint32_t msgSeqNum,
+		uint64_t pcapOffset) {
+	uint32_t boundary = static_cast<uint32_t>(boundaries.size());
+	for (int32_t securityId : dirtyList) {
+		const OrderBook* book = books.find(securityId);
+		BookIndexEntry entry{};
+		entry.securityId = securityId;
+		entry.rptSeq = book->getRptSeq();
+		entry.boundary = boundary;
+		entry.ordersOffset = fileOffset;
+		entry.orderCount = book->orderCount();
+		book->forEachOrder([&](int64_t id, int64_t price, int64_t size, MDEntryType side) {
+				CheckpointOrder order{};
+				order.id = id;
+				order.price = price;
+				order.size = size;
+				order.side = static_cast<char>(side);
+				append(&order, sizeof(order));
+			});
+		entries.push_back(entry);
+		dirty[dirtyIndex.find(securityId)] = 0;
+	}
+	dirtyList.clear();
+	boundaries.push_back(BookIndexBoundary{transactTime, pcapOffset, msgSeqNum, 0});
+}
+
+bool BookIndexWriter::finish(const OrderBookManager& books, uint64_t transactTime, uint32_t msgSeqNum,
+		uint64_t pcapOffset) {
+	if (!file.is_open()) {
+		return false;
+	}
+	writeBoundary(books, transactTime, msgSeqNum, pcapOffset);
+
+	// Written in boundary order, so a stable sort leaves each instrument's images by boundary
+	std::stable_sort(entries.begin(), entries.end(), [](const BookIndexEntry& a, const BookIndexEntry& b) {
+			return a.securityId < b.securityId;
+		});
+	header.boundaryCount = boundaries.size();
+	header.entryCount = entries.size();
+	header.boundariesOffset = fileOffset;
+	append(boundaries.data(), boundaries.size() * sizeof(BookIndexBoundary));
+	header.entriesOffset = fileOffset;
+	append(entries.data(), entries.size() * sizeof(BookIndexEntry));
+	file.seekp(0);
+	append(&header, sizeof(header));
+	file.close();
+	if (failed || file.fail()) {
+		LOG_ERROR("Failed to write book index " << tmpPath);
+		return false;
+	}
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		LOG_ERROR("Failed to rename book index " << tmpPath << " to " << path << ": " << std::strerror(errno));
+		return false;
+	}
+	LOG_INFO("Book index written to " << path << ": " << header.boundaryCount << " boundaries, "
+			<< header.entryCount << " book images, " << header.entriesOffset + header.entryCount * sizeof(BookIndexEntry)
+			<< " bytes");
+	return true;
+}
+
+BookIndex::BookIndex(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		LOG_ERROR("Cannot open book index " << path << ": " << std::strerror(errno));
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(BookIndexHeader)) {
+		LOG_ERROR("Book index " << path << " is truncated");
+		close(fd);
+		return;
+	}
+	size = static_cast<size_t>(st.st_size);
+	void* region = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (region == MAP_FAILED) {
+		LOG_ERROR("mmap of book index " << path << " failed: " << std::strerror(errno));
+		return;
+	}
+	base = static_cast<const uint8_t*>(region);
+
+	const auto* candidate = reinterpret_cast<const BookIndexHeader*>(base);
+	bool ok = candidate->magic == BOOK_INDEX_MAGIC && candidate->version == BOOK_INDEX_VERSION
+		&& candidate->boundaryCount > 0
+		&& candidate->boundariesOffset <= size
+		&& candidate->boundaryCount <= (size - candidate->boundariesOffset) / sizeof(BookIndexBoundary)
+		&& candidate->entriesOffset <= size
+		&& candidate->entryCount <= (size - candidate->entriesOffset) / sizeof(BookIndexEntry);
+	if (!ok) {
+		LOG_ERROR("Book index " << path << " is corrupt or has an unsupported version");
+		return;
+	}
+	header = candidate;
+	boundaries = reinterpret_cast<const BookIndexBoundary*>(base + header->boundariesOffset);
+	entries = reinterpret_cast<const BookIndexEntry*>(base + header->entriesOffset);
+}
+
+BookIndex::~BookIndex() {
+	if (base) {
+		munmap(const_cast<uint8_t*>(base), size);
+	}
+}
+
+std::string BookIndex::pcapFile() const {
+	return std::string(header->pcapFile, strnlen(header->pcapFile, sizeof(header->pcapFile)));
+}
+
+size_t BookIndex::boundaryAt(uint64_t transactTime) const noexcept {
+	const BookIndexBoundary* end = boundaries + header->boundaryCount;
+	const BookIndexBoundary* after = std::upper_bound(boundaries, end, transactTime,
+			[](uint64_t time, const BookIndexBoundary& boundary) { return time < boundary.transactTime; });
+	// The first boundary has TransactTime 0, so after is never the first
+	return static_cast<size_t>(after - boundaries) - 1;
+}
+
+std::pair<const BookIndexEntry*, const BookIndexEntry*> BookIndex::entriesOf(int32_t securityId) const noexcept {
+	const BookIndexEntry* end = entries + header->entryCount;
+	const BookIndexEntry* first = std::lower_bound(entries, end, securityId,
+			[](const BookIndexEntry& entry, int32_t id) { return entry.securityId < id; });
+	const BookIndexEntry* last = std::upper_bound(first, end, securityId,
+			[](int32_t id, const BookIndexEntry& entry) { return id < entry.securityId; });
+	return {first, last};
+}
+
+void BookIndex::restore(const BookIndexEntry& entry, OrderBook& book) const {
+	book.clear();
+	if (entry.ordersOffset > size || entry.orderCount > (size - entry.ordersOffset) / sizeof(CheckpointOrder)) {
+		LOG_ERROR("Book image of SecurityID " << entry.securityId << " lies outside the index file");
+		return;
+	}
+	const auto* orders = reinterpret_cast<const CheckpointOrder*>(base + entry.ordersOffset);
+	for (uint64_t i = 0; i < entry.orderCount; ++i) {
+		book.restoreOrder(orders[i].id, orders[i].price, orders[i].size, static_cast<MDEntryType>(orders[i].side));
+	}
+	book.setRptSeq(entry.rptSeq);
+}
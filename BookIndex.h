@@ -0,0 +1,136 @@
+// BookIndex.h
+
+#ifndef BOOK_INDEX_H
+#define BOOK_INDEX_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "InstrumentIndex.h"
+#include "OrderBook.h"
+
+// Sidecar of periodic per-instrument book images for point-in-time queries
+// ("the book of SecurityID X at time T") without decoding a capture from the
+// start. While decoding, a boundary is recorded whenever TransactTime crosses
+// a multiple of the interval: the capture offset of the next packet and the
+// TransactTime and MsgSeqNum of the last one applied. At each boundary the
+// order-by-order image of every book changed since the previous boundary is
+// written. A book without an image at a boundary is unchanged since its last
+// image, so a query restores that image, seeks to the last boundary at or
+// before T and replays at most one interval of incrementals.
+//
+// Layout (8-byte aligned POD records, mmap'ed by BookIndex):
+//
+//   BookIndexHeader
+//   CheckpointOrder[] ...                   images, in the order written
+//   BookIndexBoundary[boundaryCount]        by TransactTime
+//   BookIndexEntry[entryCount]              by SecurityID, then boundary
+
+static constexpr uint64_t BOOK_INDEX_MAGIC = 0x5849444E4B424D53; // "SMBKNDIX"
+static constexpr uint32_t BOOK_INDEX_VERSION = 1;
+
+struct BookIndexHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t intervalNs;
+	uint64_t pcapFileSize;         // Size of the indexed capture
+	uint64_t boundaryCount;
+	uint64_t entryCount;
+	uint64_t boundariesOffset;
+	uint64_t entriesOffset;
+	char pcapFile[256];
+};
+
+struct BookIndexBoundary {
+	uint64_t transactTime;         // Of the last packet applied before the boundary, 0 for the first
+	uint64_t pcapOffset;           // Of the first packet after the boundary
+	uint32_t lastMsgSeqNum;
+	uint32_t reserved;
+};
+
+struct BookIndexEntry {
+	int32_t securityId;
+	uint32_t rptSeq;
+	uint32_t boundary;             // Index into the boundaries
+	uint32_t reserved;
+	uint64_t ordersOffset;         // File offset of orderCount CheckpointOrder records
+	uint64_t orderCount;
+};
+
+// Builds a book index while a capture is decoded
+class BookIndexWriter {
+	public:
+		// startOffset: position of the capture's first packet
+		BookIndexWriter(const std::string& path, uint64_t intervalNs, const std::string& pcapFile,
+				uint64_t pcapFileSize, uint64_t startOffset);
+
+		bool isValid() const { return file.is_open() && !failed; }
+
+		// After a packet's message was applied to books; changed as filled by OrderBookManager::apply,
+		// pcapOffset is the position of the next packet
+		void onMessage(const std::vector<int32_t>& changed, const OrderBookManager& books,
+				uint64_t transactTime, uint32_t msgSeqNum, uint64_t pcapOffset);
+
+		// Records the end of the capture as the last boundary and writes the directory
+		bool finish(const OrderBookManager& books, uint64_t transactTime, uint32_t msgSeqNum, uint64_t pcapOffset);
+
+	private:
+		void writeBoundary(const OrderBookManager& books, uint64_t transactTime, uint32_t msgSeqNum, uint64_t pcapOffset);
+		void append(const void* data, size_t length);
+
+		std::string path;
+		std::string tmpPath;
+		std::ofstream file;
+		bool failed = false;
+		uint64_t fileOffset = 0;
+		BookIndexHeader header{};
+		uint64_t nextBoundaryTime = 0;
+
+		std::vector<BookIndexBoundary> boundaries;
+		std::vector<BookIndexEntry> entries;
+
+		// Books changed since the last boundary
+		InstrumentIndex dirtyIndex;
+		std::vector<uint8_t> dirty;
+		std::vector<int32_t> dirtyList;
+};
+
+// Read-only view of a book index file
+class BookIndex {
+	public:
+		explicit BookIndex(const std::string& path);
+		~BookIndex();
+
+		BookIndex(const BookIndex&) = delete;
+		BookIndex& operator=(const BookIndex&) = delete;
+
+		bool isValid() const { return header != nullptr; }
+
+		[[nodiscard]] std::string pcapFile() const;
+		[[nodiscard]] uint64_t pcapFileSize() const noexcept { return header->pcapFileSize; }
+		[[nodiscard]] uint64_t intervalNs() const noexcept { return header->intervalNs; }
+
+		[[nodiscard]] size_t boundaryCount() const noexcept { return header->boundaryCount; }
+		[[nodiscard]] const BookIndexBoundary& boundary(size_t index) const noexcept { return boundaries[index]; }
+		// Last boundary with TransactTime <= transactTime
+		[[nodiscard]] size_t boundaryAt(uint64_t transactTime) const noexcept;
+
+		// Images of one instrument, ordered by boundary
+		[[nodiscard]] std::pair<const BookIndexEntry*, const BookIndexEntry*> entriesOf(int32_t securityId) const noexcept;
+
+		// Fills book from an image
+		void restore(const BookIndexEntry& entry, OrderBook& book) const;
+
+	private:
+		const uint8_t* base = nullptr;
+		size_t size = 0;
+		const BookIndexHeader* header = nullptr;
+		const BookIndexBoundary* boundaries = nullptr;
+		const BookIndexEntry* entries = nullptr;
+};
+
+#endif // BOOK_INDEX_H
@@ -0,0 +1,142 @@
+// BroadcastRing.h
+
+#ifndef BROADCAST_RING_H
+#define BROADCAST_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "Placement.h"
+
+// Single-producer, multi-consumer broadcast ring of fixed-size slots
+// (Disruptor style). Every subscriber owns its cursor and sees every event;
+// the producer never waits for anybody. A subscriber that falls more than
+// Capacity events behind is lapped: it detects this through the per-slot
+// sequence, counts the lost events and resumes from the oldest slot still
+// in the ring. Slot storage is a HugePageBuffer, so it follows the
+// configured NUMA node and huge page settings.
+template<typename T, size_t Capacity>
+class BroadcastRing {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static_assert(std::is_trivially_copyable_v<T>, "Ring slots are copied while they may be overwritten");
+
+	public:
+		class Subscriber {
+			public:
+				enum class PollResult {
+					Event,
+					Empty,
+					Closed
+				};
+
+				// Copies the next event into out; never blocks
+				PollResult poll(T& out) noexcept {
+					for (;;) {
+						uint64_t available = ring->published.load(std::memory_order_acquire);
+						if (cursor >= available) {
+							return ring->closed.load(std::memory_order_acquire) &&
+								cursor >= ring->published.load(std::memory_order_acquire)
+								? PollResult::Closed : PollResult::Empty;
+						}
+
+						const Slot& slot = ring->slots[cursor & MASK];
+						uint64_t expected = completeSequence(cursor);
+						if (slot.sequence.load(std::memory_order_acquire) == expected) {
+							out = slot.value;
+							std::atomic_thread_fence(std::memory_order_acquire);
+							if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+								++cursor;
+								return PollResult::Event;
+							}
+						}
+
+						// The producer overwrote our slot: skip to the oldest event still available
+						uint64_t latest = ring->published.load(std::memory_order_acquire);
+						uint64_t oldest = latest > Capacity ? latest - Capacity + 1 : 0;
+						if (oldest > cursor) {
+							lost += oldest - cursor;
+							++overruns;
+							cursor = oldest;
+						}
+					}
+				}
+
+				// Events published but not consumed yet
+				[[nodiscard]] uint64_t lag() const noexcept {
+					return ring->published.load(std::memory_order_acquire) - cursor;
+				}
+
+				[[nodiscard]] uint64_t getLost() const noexcept { return lost; }
+				[[nodiscard]] uint64_t getOverruns() const noexcept { return overruns; }
+				[[nodiscard]] uint64_t getCursor() const noexcept { return cursor; }
+
+			private:
+				friend class BroadcastRing;
+
+				Subscriber(const BroadcastRing* ring, uint64_t cursor) : ring(ring), cursor(cursor) {}
+
+				const BroadcastRing* ring;
+				uint64_t cursor;
+				uint64_t lost = 0;
+				uint64_t overruns = 0;
+		};
+
+		BroadcastRing() : storage(sizeof(Slot) * Capacity, "broadcast ring") {
+			if (!storage.data()) {
+				throw std::bad_alloc();
+			}
+			slots = static_cast<Slot*>(storage.data());
+			std::uninitialized_default_construct_n(slots, Capacity);
+		}
+		~BroadcastRing() { std::destroy_n(slots, Capacity); }
+
+		BroadcastRing(const BroadcastRing&) = delete;
+		BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+		// Subscribers only see events published after they subscribed
+		[[nodiscard]] Subscriber subscribe() const noexcept {
+			return Subscriber(this, published.load(std::memory_order_acquire));
+		}
+
+		// Producer side; must only be called from one thread
+		void publish(const T& value) noexcept {
+			uint64_t sequence = nextSequence++;
+			Slot& slot = slots[sequence & MASK];
+
+			slot.sequence.store(writingSequence(sequence), std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.value = value;
+			slot.sequence.store(completeSequence(sequence), std::memory_order_release);
+
+			published.store(sequence + 1, std::memory_order_release);
+		}
+
+		// Tells subscribers that no further events will be published
+		void close() noexcept { closed.store(true, std::memory_order_release); }
+
+		[[nodiscard]] uint64_t getPublished() const noexcept { return published.load(std::memory_order_acquire); }
+
+	private:
+		static constexpr uint64_t MASK = Capacity - 1;
+
+		// Slot sequences encode the event number, so a reader can tell its event
+		// from one written a lap later; odd values mark a write in progress
+		static constexpr uint64_t writingSequence(uint64_t sequence) noexcept { return 2 * sequence + 1; }
+		static constexpr uint64_t completeSequence(uint64_t sequence) noexcept { return 2 * sequence + 2; }
+
+		struct alignas(64) Slot {
+			std::atomic<uint64_t> sequence{0};
+			T value;
+		};
+
+		HugePageBuffer storage;
+		Slot* slots = nullptr;
+		alignas(64) std::atomic<uint64_t> published{0};
+		std::atomic<bool> closed{false};
+		alignas(64) uint64_t nextSequence = 0;
+};
+
+#endif // BROADCAST_RING_H
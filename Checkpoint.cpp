@@ -0,0 +1,194 @@
+#include "Checkpoint.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "log.h"
+
+namespace {
+
+template<typename T>
+void appendRecord(std::vector<uint8_t>& out, const T& record) {
+	const auto* bytes = reinterpret_cast<const uint8_t*>(&record);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // namespace
+
+bool Checkpoint::save(const std::string& path, const SimbaDecoder& decoder, const OrderBookManager& books,
+		const std::string& pcapFile, uint64_t pcapOffset, uint64_t pcapFileSize) {
+	std::vector<uint8_t> out;
+	out.reserve(1024 * 1024);
+
+	CheckpointHeader header{};
+	header.magic = CHECKPOINT_MAGIC;
+	header.version = CHECKPOINT_VERSION;
+	header.lastIncrementalMsgSeqNum = decoder.getLastMsgSeqNum(SimbaDecoder::Channel::Incremental);
+	header.lastSnapshotMsgSeqNum = decoder.getLastMsgSeqNum(SimbaDecoder::Channel::Snapshot);
+	header.pcapOffset = pcapOffset;
+	header.pcapFileSize = pcapFileSize;
+	header.createdAt = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+	std::snprintf(header.pcapFile, sizeof(header.pcapFile), "%s", pcapFile.c_str());
+	appendRecord(out, header);
+
+	decoder.forEachPendingFragment([&](SimbaDecoder::FragmentKind kind, int32_t securityId, const std::vector<uint8_t>& data) {
+			CheckpointFragment fragment{};
+			fragment.kind = static_cast<uint8_t>(kind);
+			fragment.securityId = securityId;
+			fragment.length = data.size();
+			appendRecord(out, fragment);
+			out.insert(out.end(), data.begin(), data.end());
+			out.resize(out.size() + padded(data.size()) - data.size(), 0);
+			header.fragmentCount++;
+		});
+
+	books.forEachBook([&](int32_t securityId, const OrderBook& book) {
+			CheckpointBook record{};
+			record.securityId = securityId;
+			record.rptSeq = book.getRptSeq();
+			record.orderCount = book.orderCount();
+			appendRecord(out, record);
+			book.forEachOrder([&](int64_t id, int64_t price, int64_t size, MDEntryType side) {
+					CheckpointOrder order{};
+					order.id = id;
+					order.price = price;
+					order.size = size;
+					order.side = static_cast<char>(side);
+					appendRecord(out, order);
+				});
+			header.bookCount++;
+		});
+
+	std::memcpy(out.data(), &header, sizeof(header));
+
+	std::string tmpPath = path + ".tmp";
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		LOG_ERROR("Failed to create checkpoint " << tmpPath << ": " << std::strerror(errno));
+		return false;
+	}
+	const uint8_t* data = out.data();
+	size_t remaining = out.size();
+	while (remaining > 0) {
+		ssize_t written = ::write(fd, data, remaining);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written < 0) {
+			break;
+		}
+		data += written;
+		remaining -= static_cast<size_t>(written);
+	}
+	// The data must be on disk before the rename makes it the checkpoint
+	bool synced = remaining == 0 && fsync(fd) == 0;
+	if (close(fd) != 0 || !synced) {
+		LOG_ERROR("Failed to write checkpoint " << tmpPath << ": " << std::strerror(errno));
+		return false;
+	}
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		LOG_ERROR("Failed to rename checkpoint " << tmpPath << " to " << path << ": " << std::strerror(errno));
+		return false;
+	}
+
+	LOG_INFO("Checkpoint written to " << path << ": " << out.size() << " bytes, "
+			<< header.fragmentCount << " pending fragments, " << header.bookCount << " books, "
+			<< "pcap offset " << pcapOffset << ", incremental MsgSeqNum " << header.lastIncrementalMsgSeqNum
+			<< ", snapshot MsgSeqNum " << header.lastSnapshotMsgSeqNum);
+	return true;
+}
+
+bool Checkpoint::restore(const std::string& path, SimbaDecoder& decoder, OrderBookManager& books, CheckpointInfo& info) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		LOG_INFO("No checkpoint at " << path << ", starting from the beginning");
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CheckpointHeader)) {
+		LOG_ERROR("Checkpoint " << path << " is truncated");
+		close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(st.st_size);
+	void* region = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (region == MAP_FAILED) {
+		LOG_ERROR("mmap of checkpoint " << path << " failed: " << std::strerror(errno));
+		return false;
+	}
+
+	const auto* base = static_cast<const uint8_t*>(region);
+	const auto* header = reinterpret_cast<const CheckpointHeader*>(base);
+	bool ok = header->magic == CHECKPOINT_MAGIC && header->version == CHECKPOINT_VERSION;
+	size_t offset = sizeof(CheckpointHeader);
+	if (ok) {
+		// Carried over so a run that decodes nothing new does not checkpoint MsgSeqNum 0,
+		// and set first so restored fragments count their age from the checkpoint
+		decoder.setLastMsgSeqNum(SimbaDecoder::Channel::Incremental, header->lastIncrementalMsgSeqNum);
+		decoder.setLastMsgSeqNum(SimbaDecoder::Channel::Snapshot, header->lastSnapshotMsgSeqNum);
+	}
+
+	for (uint32_t i = 0; ok && i < header->fragmentCount; ++i) {
+		if (offset + sizeof(CheckpointFragment) > size) {
+			ok = false;
+			break;
+		}
+		const auto* fragment = reinterpret_cast<const CheckpointFragment*>(base + offset);
+		offset += sizeof(CheckpointFragment);
+		if (fragment->length > size - offset || fragment->kind > static_cast<uint8_t>(SimbaDecoder::FragmentKind::Snapshot)) {
+			ok = false;
+			break;
+		}
+		decoder.restorePendingFragment(static_cast<SimbaDecoder::FragmentKind>(fragment->kind),
+				fragment->securityId, base + offset, fragment->length);
+		offset += padded(fragment->length);
+	}
+
+	for (uint32_t i = 0; ok && i < header->bookCount; ++i) {
+		if (offset + sizeof(CheckpointBook) > size) {
+			ok = false;
+			break;
+		}
+		const auto* record = reinterpret_cast<const CheckpointBook*>(base + offset);
+		offset += sizeof(CheckpointBook);
+		if (record->orderCount > (size - offset) / sizeof(CheckpointOrder)) {
+			ok = false;
+			break;
+		}
+
+		OrderBook& book = books.restoreBook(record->securityId);
+		const auto* orders = reinterpret_cast<const CheckpointOrder*>(base + offset);
+		for (uint64_t j = 0; j < record->orderCount; ++j) {
+			book.restoreOrder(orders[j].id, orders[j].price, orders[j].size, static_cast<MDEntryType>(orders[j].side));
+		}
+		book.setRptSeq(record->rptSeq);
+		offset += record->orderCount * sizeof(CheckpointOrder);
+	}
+
+	if (ok) {
+		info.pcapFile.assign(header->pcapFile, strnlen(header->pcapFile, sizeof(header->pcapFile)));
+		info.pcapOffset = header->pcapOffset;
+		info.pcapFileSize = header->pcapFileSize;
+		info.lastIncrementalMsgSeqNum = header->lastIncrementalMsgSeqNum;
+		info.lastSnapshotMsgSeqNum = header->lastSnapshotMsgSeqNum;
+		LOG_INFO("Restored checkpoint " << path << ": " << header->fragmentCount << " pending fragments, "
+				<< header->bookCount << " books, pcap offset " << info.pcapOffset
+				<< ", incremental MsgSeqNum " << info.lastIncrementalMsgSeqNum
+				<< ", snapshot MsgSeqNum " << info.lastSnapshotMsgSeqNum);
+	} else {
+		LOG_ERROR("Checkpoint " << path << " is corrupt or has an unsupported version, ignoring it");
+	}
+
+	munmap(region, size);
+	return ok;
+}
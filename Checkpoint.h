@@ -0,0 +1,82 @@
+// Checkpoint.h
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+
+#include "OrderBook.h"
+#include "SimbaDecoder.h"
+
+// On-disk checkpoint of decoder and book state, so a restarted process can
+// resume mid-session instead of waiting for a snapshot cycle. The file is a
+// flat sequence of 8-byte aligned POD records that is mmap'ed and walked in
+// place on restore:
+//
+//   CheckpointHeader
+//   CheckpointFragment + data (padded to 8) ... (fragmentCount times)
+//   CheckpointBook + CheckpointOrder[orderCount] ... (bookCount times)
+//
+// Files are written to "<path>.tmp", synced and renamed, so a crash while
+// writing never leaves a torn checkpoint behind.
+
+static constexpr uint64_t CHECKPOINT_MAGIC = 0x54504B4341424D53; // "SMBACKPT"
+static constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+struct CheckpointHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t lastIncrementalMsgSeqNum;
+	uint64_t pcapOffset;           // Offset of the first packet not covered by the checkpoint
+	uint64_t pcapFileSize;         // Size of the capture when the checkpoint was taken
+	uint64_t createdAt;            // Wall clock, ns since epoch
+	uint32_t fragmentCount;
+	uint32_t bookCount;
+	uint32_t lastSnapshotMsgSeqNum;   // Numbered independently of the incremental feed
+	uint32_t reserved;
+	char pcapFile[256];            // Capture the offset refers to
+};
+
+struct CheckpointFragment {
+	uint8_t kind;                  // SimbaDecoder::FragmentKind
+	uint8_t reserved[3];
+	int32_t securityId;
+	uint64_t length;
+};
+
+struct CheckpointBook {
+	int32_t securityId;
+	uint32_t rptSeq;
+	uint64_t orderCount;
+};
+
+struct CheckpointOrder {
+	int64_t id;
+	int64_t price;
+	int64_t size;
+	char side;
+	uint8_t reserved[7];
+};
+
+struct CheckpointInfo {
+	std::string pcapFile;
+	uint64_t pcapOffset = 0;
+	uint64_t pcapFileSize = 0;
+	uint32_t lastIncrementalMsgSeqNum = 0;
+	uint32_t lastSnapshotMsgSeqNum = 0;
+};
+
+class Checkpoint {
+	public:
+		static bool save(const std::string& path, const SimbaDecoder& decoder, const OrderBookManager& books,
+				const std::string& pcapFile, uint64_t pcapOffset, uint64_t pcapFileSize);
+
+		// Restores decoder and book state; returns false if the file is missing or invalid
+		static bool restore(const std::string& path, SimbaDecoder& decoder, OrderBookManager& books, CheckpointInfo& info);
+
+	private:
+		static constexpr size_t padded(size_t length) { return (length + 7) & ~size_t{7}; }
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,109 @@
+// DecodedEvent.h
+
+#ifndef DECODED_EVENT_H
+#define DECODED_EVENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#include "SimbaDecoder.h"
+
+enum class DecodedEventType : uint8_t {
+	OrderUpdate = 0,
+	OrderExecution,
+	SnapshotBegin,
+	SnapshotEntry
+};
+
+struct SnapshotBeginEvent {
+	int32_t SecurityID;
+	uint32_t LastMsgSeqNumProcessed;
+	uint32_t RptSeq;
+	uint32_t ExchangeTradingSessionID;
+	uint32_t entryCount;
+	// False for further messages of a snapshot that was already started in the same packet
+	bool resetBook;
+};
+
+struct SnapshotEntryEvent {
+	int32_t SecurityID;
+	uint32_t RptSeq;
+	OrderBookEntry entry;
+};
+
+// Fixed-size, trivially copyable form of one decoded item. A DecodedMessage
+// (vector per packet) is flattened into a sequence of these, so events can be
+// stored in preallocated rings and copied between threads.
+struct DecodedEvent {
+	DecodedEventType type;
+	// Set on the last event produced from one DecodedMessage
+	bool endOfMessage;
+	// TransactTime of the incremental packet; 0 for snapshots and events of a DecodedMessage
+	uint64_t transactTime;
+	union {
+		OrderUpdate update;
+		OrderExecution execution;
+		SnapshotBeginEvent snapshotBegin;
+		SnapshotEntryEvent snapshotEntry;
+	};
+
+	[[nodiscard]] int32_t securityId() const noexcept {
+		switch (type) {
+			case DecodedEventType::OrderUpdate: return update.SecurityID;
+			case DecodedEventType::OrderExecution: return execution.SecurityID;
+			case DecodedEventType::SnapshotBegin: return snapshotBegin.SecurityID;
+			case DecodedEventType::SnapshotEntry: return snapshotEntry.SecurityID;
+		}
+		return 0;
+	}
+};
+
+static_assert(std::is_trivially_copyable_v<DecodedEvent>, "DecodedEvent must be trivially copyable");
+
+// Calls fn(const DecodedEvent&) for every event of a decoded message, in order
+template<typename Fn>
+void forEachEvent(const DecodedMessage& message, Fn&& fn) {
+	DecodedEvent event;
+	event.endOfMessage = false;
+	event.transactTime = 0;
+
+	if (const auto* updates = std::get_if<std::vector<OrderUpdate>>(&message)) {
+		event.type = DecodedEventType::OrderUpdate;
+		for (size_t i = 0; i < updates->size(); ++i) {
+			event.update = (*updates)[i];
+			event.endOfMessage = (i + 1 == updates->size());
+			fn(static_cast<const DecodedEvent&>(event));
+		}
+	} else if (const auto* executions = std::get_if<std::vector<OrderExecution>>(&message)) {
+		event.type = DecodedEventType::OrderExecution;
+		for (size_t i = 0; i < executions->size(); ++i) {
+			event.execution = (*executions)[i];
+			event.endOfMessage = (i + 1 == executions->size());
+			fn(static_cast<const DecodedEvent&>(event));
+		}
+	} else if (const auto* snapshots = std::get_if<std::vector<OrderBookSnapshot>>(&message)) {
+		for (size_t i = 0; i < snapshots->size(); ++i) {
+			const OrderBookSnapshot& snapshot = (*snapshots)[i];
+			bool lastSnapshot = (i + 1 == snapshots->size());
+
+			event.type = DecodedEventType::SnapshotBegin;
+			event.snapshotBegin = SnapshotBeginEvent{snapshot.SecurityID, snapshot.LastMsgSeqNumProcessed,
+				snapshot.RptSeq, snapshot.ExchangeTradingSessionID,
+				static_cast<uint32_t>(snapshot.entries.size()),
+				std::none_of(snapshots->begin(), snapshots->begin() + i,
+						[&](const OrderBookSnapshot& s) { return s.SecurityID == snapshot.SecurityID; })};
+			event.endOfMessage = lastSnapshot && snapshot.entries.empty();
+			fn(static_cast<const DecodedEvent&>(event));
+
+			event.type = DecodedEventType::SnapshotEntry;
+			for (size_t j = 0; j < snapshot.entries.size(); ++j) {
+				event.snapshotEntry = SnapshotEntryEvent{snapshot.SecurityID, snapshot.RptSeq, snapshot.entries[j]};
+				event.endOfMessage = lastSnapshot && (j + 1 == snapshot.entries.size());
+				fn(static_cast<const DecodedEvent&>(event));
+			}
+		}
+	}
+}
+
+#endif // DECODED_EVENT_H
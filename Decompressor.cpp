@@ -0,0 +1,222 @@
+#include "Decompressor.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef SIMBA_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr uint8_t GZIP_MAGIC[] = {0x1f, 0x8b};
+constexpr uint8_t ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+constexpr size_t MAGIC_SIZE = 4;
+
+} // namespace
+
+Decompressor::Decompressor(int fd) : fd(fd), input(INPUT_BUFFER_SIZE) {}
+
+Decompressor::~Decompressor() {
+#ifdef SIMBA_HAVE_ZLIB
+	if (zlibInitialised) {
+		inflateEnd(&zlib);
+	}
+#endif
+#ifdef SIMBA_HAVE_ZSTD
+	ZSTD_freeDStream(zstd);
+#endif
+}
+
+const char* Decompressor::formatName(Format format) noexcept {
+	switch (format) {
+		case Format::None: return "uncompressed";
+		case Format::Gzip: return "gzip";
+		case Format::Zstd: return "zstd";
+	}
+	return "unknown";
+}
+
+bool Decompressor::isSupported(Format format) noexcept {
+	switch (format) {
+		case Format::None: return true;
+#ifdef SIMBA_HAVE_ZLIB
+		case Format::Gzip: return true;
+#endif
+#ifdef SIMBA_HAVE_ZSTD
+		case Format::Zstd: return true;
+#endif
+		default: return false;
+	}
+}
+
+Decompressor::Format Decompressor::detect(const uint8_t* data, size_t length) noexcept {
+	if (length >= sizeof(GZIP_MAGIC) && std::memcmp(data, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0) {
+		return Format::Gzip;
+	}
+	if (length >= sizeof(ZSTD_MAGIC) && std::memcmp(data, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) {
+		return Format::Zstd;
+	}
+	return Format::None;
+}
+
+Decompressor::Format Decompressor::detectFile(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return Format::None;
+	}
+	uint8_t magic[MAGIC_SIZE];
+	ssize_t n = ::read(fd, magic, sizeof(magic));
+	::close(fd);
+	return n > 0 ? detect(magic, static_cast<size_t>(n)) : Format::None;
+}
+
+bool Decompressor::fillInput() {
+	if (inputPos == inputEnd) {
+		inputPos = inputEnd = 0;
+	}
+	for (;;) {
+		ssize_t n = ::read(fd, input.data() + inputEnd, input.size() - inputEnd);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			error = std::strerror(errno);
+			return false;
+		}
+		if (n == 0) {
+			inputEof = true;
+		}
+		inputEnd += static_cast<size_t>(n);
+		return true;
+	}
+}
+
+bool Decompressor::open() {
+	while (inputEnd < MAGIC_SIZE && !inputEof) {
+		if (!fillInput()) {
+			return false;
+		}
+	}
+	format = detect(input.data(), inputEnd);
+	if (!isSupported(format)) {
+		error = std::string("built without ") + formatName(format) + " support";
+		return false;
+	}
+
+#ifdef SIMBA_HAVE_ZLIB
+	if (format == Format::Gzip) {
+		// 16 + MAX_WBITS: gzip wrapper only
+		if (inflateInit2(&zlib, 16 + MAX_WBITS) != Z_OK) {
+			error = "cannot initialise zlib";
+			return false;
+		}
+		zlibInitialised = true;
+	}
+#endif
+#ifdef SIMBA_HAVE_ZSTD
+	if (format == Format::Zstd) {
+		zstd = ZSTD_createDStream();
+		if (!zstd || ZSTD_isError(ZSTD_initDStream(zstd))) {
+			error = "cannot initialise zstd";
+			return false;
+		}
+	}
+#endif
+	return true;
+}
+
+ssize_t Decompressor::read(uint8_t* out, size_t length) {
+	if (finished) {
+		return 0;
+	}
+
+	if (format == Format::None) {
+		// The magic bytes read by open() come first, then straight from the descriptor
+		if (inputPos < inputEnd) {
+			size_t n = std::min(length, inputEnd - inputPos);
+			std::memcpy(out, input.data() + inputPos, n);
+			inputPos += n;
+			return static_cast<ssize_t>(n);
+		}
+		if (inputEof) {
+			finished = true;
+			return 0;
+		}
+		ssize_t n;
+		do {
+			n = ::read(fd, out, length);
+		} while (n < 0 && errno == EINTR);
+		if (n < 0) {
+			error = std::strerror(errno);
+		} else if (n == 0) {
+			finished = true;
+		}
+		return n;
+	}
+
+	if (inputPos == inputEnd && !outputPending) {
+		if (!inputEof && !fillInput()) {
+			return -1;
+		}
+		if (inputPos == inputEnd) {
+			if (midStream) {
+				error = std::string("truncated ") + formatName(format) + " stream";
+				return -1;
+			}
+			finished = true;
+			return 0;
+		}
+	}
+	return format == Format::Gzip ? readGzip(out, length) : readZstd(out, length);
+}
+
+ssize_t Decompressor::readGzip([[maybe_unused]] uint8_t* out, [[maybe_unused]] size_t length) {
+#ifdef SIMBA_HAVE_ZLIB
+	zlib.next_in = input.data() + inputPos;
+	zlib.avail_in = static_cast<uInt>(inputEnd - inputPos);
+	zlib.next_out = out;
+	zlib.avail_out = static_cast<uInt>(std::min<size_t>(length, UINT32_MAX));
+	uInt requested = zlib.avail_out;
+
+	int rc = inflate(&zlib, Z_NO_FLUSH);
+	inputPos = inputEnd - zlib.avail_in;
+	size_t produced = requested - zlib.avail_out;
+	outputPending = zlib.avail_out == 0;
+
+	if (rc == Z_STREAM_END) {
+		// Another gzip member may follow
+		midStream = false;
+		inflateReset(&zlib);
+	} else if (rc == Z_OK) {
+		midStream = true;
+	} else if (rc != Z_BUF_ERROR) {   // Z_BUF_ERROR: no progress possible until more input arrives
+		error = zlib.msg ? zlib.msg : "corrupt gzip stream";
+		return -1;
+	}
+	return static_cast<ssize_t>(produced);
+#else
+	return -1;
+#endif
+}
+
+ssize_t Decompressor::readZstd([[maybe_unused]] uint8_t* out, [[maybe_unused]] size_t length) {
+#ifdef SIMBA_HAVE_ZSTD
+	ZSTD_inBuffer in{input.data() + inputPos, inputEnd - inputPos, 0};
+	ZSTD_outBuffer output{out, length, 0};
+	size_t rc = ZSTD_decompressStream(zstd, &output, &in);
+	if (ZSTD_isError(rc)) {
+		error = ZSTD_getErrorName(rc);
+		return -1;
+	}
+	inputPos += in.pos;
+	outputPending = output.pos == length;
+	// 0: a frame is complete and fully flushed; the next one may follow
+	midStream = rc != 0;
+	return static_cast<ssize_t>(output.pos);
+#else
+	return -1;
+#endif
+}
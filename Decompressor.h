@@ -0,0 +1,86 @@
+// Decompressor.h
+
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#ifdef SIMBA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef SIMBA_HAVE_ZSTD
+struct ZSTD_DCtx_s;
+#endif
+
+// Byte stream over a file descriptor that undoes gzip or zstd compression,
+// recognised by the magic bytes at the start of the stream, and passes
+// anything else through unchanged. Concatenated gzip members and zstd frames
+// are decoded back to back. Each read() issues at most one read(2), so the
+// caller can poll the descriptor between calls. Does not log: it runs on
+// reader threads.
+class Decompressor {
+	public:
+		enum class Format {
+			None,
+			Gzip,
+			Zstd
+		};
+
+		static constexpr size_t INPUT_BUFFER_SIZE = 1024 * 1024;
+
+		// Does not take ownership of fd
+		explicit Decompressor(int fd);
+		~Decompressor();
+
+		Decompressor(const Decompressor&) = delete;
+		Decompressor& operator=(const Decompressor&) = delete;
+
+		// Reads the magic bytes; false if reading failed or the format support is not built in
+		bool open();
+
+		// Up to length bytes of output; may produce 0 bytes without being at the end. -1 on error.
+		ssize_t read(uint8_t* out, size_t length);
+
+		// Output available without another read(2): buffered input or an unfinished output flush
+		[[nodiscard]] bool hasPendingInput() const noexcept { return inputPos < inputEnd || outputPending; }
+		[[nodiscard]] bool atEnd() const noexcept { return finished; }
+		[[nodiscard]] Format getFormat() const noexcept { return format; }
+		[[nodiscard]] const std::string& getError() const noexcept { return error; }
+
+		static const char* formatName(Format format) noexcept;
+		static bool isSupported(Format format) noexcept;
+		// Format of a file from its magic bytes; None if unreadable
+		static Format detectFile(const std::string& path);
+
+	private:
+		static Format detect(const uint8_t* data, size_t length) noexcept;
+		bool fillInput();
+		ssize_t readGzip(uint8_t* out, size_t length);
+		ssize_t readZstd(uint8_t* out, size_t length);
+
+		int fd;
+		Format format = Format::None;
+		std::vector<uint8_t> input;
+		size_t inputPos = 0;
+		size_t inputEnd = 0;
+		bool inputEof = false;
+		bool outputPending = false;
+		bool midStream = false;          // Inside a gzip member or zstd frame
+		bool finished = false;
+		std::string error;
+
+#ifdef SIMBA_HAVE_ZLIB
+		z_stream zlib{};
+		bool zlibInitialised = false;
+#endif
+#ifdef SIMBA_HAVE_ZSTD
+		ZSTD_DCtx_s* zstd = nullptr;
+#endif
+};
+
+#endif // DECOMPRESSOR_H
@@ -0,0 +1,103 @@
+#include "EventFanout.h"
+#include <algorithm>
+
+#include "Placement.h"
+#include "log.h"
+
+EventFanout::EventFanout(bool lossy) : ring(std::make_unique<EventRing>()), lossy(lossy) {}
+
+EventFanout::~EventFanout() {
+	stop();
+}
+
+void EventFanout::addConsumer(const std::string& name, EventConsumer consumer) {
+	EventRing::Subscriber subscriber = ring->subscribe();
+	uint64_t position = subscriber.getCursor();
+	// Built in place: the atomic position cannot be moved
+	consumers.emplace_back(new Consumer{name, std::move(consumer), subscriber, 0, 0, {}, {position}});
+}
+
+void EventFanout::start() {
+	running = true;
+	for (size_t i = 0; i < consumers.size(); ++i) {
+		consumers[i]->thread = std::thread(&EventFanout::run, std::ref(*consumers[i]));
+		Placement::pinThread(consumers[i]->thread, ThreadRole::Consumer, i);
+	}
+	LOG_INFO("Event fan-out started with " << consumers.size() << " consumers, ring capacity " << RING_CAPACITY
+			<< (lossy ? ", slow consumers skip events" : ", decoding waits for slow consumers"));
+}
+
+void EventFanout::run(Consumer& consumer) {
+	DecodedEvent event;
+	for (;;) {
+		switch (consumer.subscriber.poll(event)) {
+			case EventRing::Subscriber::PollResult::Event:
+				// The event is copied out, so its slot may be reused
+				consumer.position.store(consumer.subscriber.getCursor(), std::memory_order_release);
+				consumer.onEvent(event);
+				// Sampled rather than per event: lag() touches the producer's cache line
+				if ((++consumer.consumed & 1023) == 0) {
+					consumer.maxLag = std::max(consumer.maxLag, consumer.subscriber.lag());
+				}
+				break;
+			case EventRing::Subscriber::PollResult::Empty:
+				std::this_thread::yield();
+				break;
+			case EventRing::Subscriber::PollResult::Closed:
+				return;
+		}
+	}
+}
+
+void EventFanout::publish(const std::vector<DecodedEvent>& events) {
+	for (const DecodedEvent& event : events) {
+		if (!lossy) {
+			waitForSlowestConsumer();
+		}
+		ring->publish(event);
+	}
+}
+
+void EventFanout::waitForSlowestConsumer() {
+	uint64_t next = ring->getPublished();
+	if (next - slowestPosition < RING_CAPACITY) {
+		return;
+	}
+	for (;;) {
+		uint64_t slowest = next;
+		for (const auto& consumer : consumers) {
+			slowest = std::min(slowest, consumer->position.load(std::memory_order_acquire));
+		}
+		slowestPosition = slowest;
+		if (next - slowestPosition < RING_CAPACITY) {
+			return;
+		}
+		publisherWaits++;
+		std::this_thread::yield();
+	}
+}
+
+void EventFanout::stop() {
+	if (!running) {
+		return;
+	}
+	ring->close();
+	for (auto& consumer : consumers) {
+		consumer->thread.join();
+	}
+	running = false;
+}
+
+void EventFanout::printStatistics() const {
+	LOG_INFO("Events published: " << ring->getPublished()
+			<< (lossy ? "" : ", publisher waited " + std::to_string(publisherWaits) + " times for slow consumers"));
+	for (const auto& consumer : consumers) {
+		const EventRing::Subscriber& subscriber = consumer->subscriber;
+		LOG_INFO("Consumer " << consumer->name << ": consumed " << consumer->consumed
+				<< ", max lag " << consumer->maxLag
+				<< ", lost " << subscriber.getLost() << " events in " << subscriber.getOverruns() << " overruns");
+		if (subscriber.getLost() > 0) {
+			LOG_WARNING("Consumer " << consumer->name << " was too slow and skipped events");
+		}
+	}
+}
@@ -0,0 +1,74 @@
+// EventFanout.h
+
+#ifndef EVENT_FANOUT_H
+#define EVENT_FANOUT_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BroadcastRing.h"
+#include "DecodedEvent.h"
+
+// Decodes once, consumes many times: the DecodedEvents of each payload are
+// published to a BroadcastRing, and every registered
+// consumer drains the ring on its own thread at its own pace. By default the
+// publisher waits while the slowest consumer is a full ring behind, so a
+// replay delivers every event. A lossy fan-out never stalls decoding: a
+// consumer that falls a full ring behind loses events instead, and the
+// losses are reported by printStatistics().
+class EventFanout {
+	public:
+		static constexpr size_t RING_CAPACITY = 64 * 1024;
+
+		using EventRing = BroadcastRing<DecodedEvent, RING_CAPACITY>;
+		using EventConsumer = std::function<void(const DecodedEvent&)>;
+
+		explicit EventFanout(bool lossy = false);
+		~EventFanout();
+
+		EventFanout(const EventFanout&) = delete;
+		EventFanout& operator=(const EventFanout&) = delete;
+
+		// Consumers must be added before start(). Their threads are pinned to the
+		// configured consumer cores (see Placement), in the order they were added.
+		void addConsumer(const std::string& name, EventConsumer consumer);
+
+		void start();
+		// Publishes the events of one payload, as produced by SimbaDecoder::decodeEvents()
+		void publish(const std::vector<DecodedEvent>& events);
+
+		// Closes the ring and waits until every consumer has drained it
+		void stop();
+
+		void printStatistics() const;
+
+	private:
+		struct Consumer {
+			std::string name;
+			EventConsumer onEvent;
+			EventRing::Subscriber subscriber;
+			uint64_t consumed = 0;
+			uint64_t maxLag = 0;
+			std::thread thread;
+			// Ring position of the next event to consume, read by a blocking publisher
+			alignas(64) std::atomic<uint64_t> position{0};
+		};
+
+		static void run(Consumer& consumer);
+
+		// Waits until publishing the next event cannot overwrite one a consumer has not read
+		void waitForSlowestConsumer();
+
+		std::unique_ptr<EventRing> ring;
+		std::vector<std::unique_ptr<Consumer>> consumers;
+		bool lossy;
+		bool running = false;
+		uint64_t slowestPosition = 0;   // Cached minimum of the consumer positions
+		uint64_t publisherWaits = 0;
+};
+
+#endif // EVENT_FANOUT_H
@@ -0,0 +1,64 @@
+// FlatMap.h
+
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include <utility>
+#include <vector>
+
+// Unordered map over one contiguous vector with linear lookup, for maps that
+// hold a handful of entries: a scan of a few adjacent pairs beats hashing and
+// a node dereference. Inserting may move existing values, and erase() moves
+// the last entry into the gap, so references and iterators do not survive
+// either.
+template<typename Key, typename Value>
+class FlatMap {
+	public:
+		using value_type = std::pair<Key, Value>;
+		using iterator = typename std::vector<value_type>::iterator;
+		using const_iterator = typename std::vector<value_type>::const_iterator;
+
+		iterator begin() noexcept { return entries.begin(); }
+		iterator end() noexcept { return entries.end(); }
+		const_iterator begin() const noexcept { return entries.begin(); }
+		const_iterator end() const noexcept { return entries.end(); }
+
+		[[nodiscard]] size_t size() const noexcept { return entries.size(); }
+		[[nodiscard]] bool empty() const noexcept { return entries.empty(); }
+
+		iterator find(const Key& key) noexcept {
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				if (it->first == key) {
+					return it;
+				}
+			}
+			return entries.end();
+		}
+
+		const_iterator find(const Key& key) const noexcept {
+			return const_cast<FlatMap*>(this)->find(key);
+		}
+
+		Value& operator[](const Key& key) {
+			auto it = find(key);
+			if (it != entries.end()) {
+				return it->second;
+			}
+			return entries.emplace_back(key, Value{}).second;
+		}
+
+		// Returns the iterator to continue a scan from (the moved-in entry or end())
+		iterator erase(iterator it) {
+			auto offset = it - entries.begin();
+			if (it + 1 != entries.end()) {
+				*it = std::move(entries.back());
+			}
+			entries.pop_back();
+			return entries.begin() + offset;
+		}
+
+	private:
+		std::vector<value_type> entries;
+};
+
+#endif // FLAT_MAP_H
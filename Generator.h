@@ -0,0 +1,109 @@
+// Generator.h
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <utility>
+
+// Minimal lazy C++20 coroutine generator (std::generator is C++23).
+// Values are yielded by reference: the iterator points at the object the
+// coroutine passed to co_yield, so nothing is copied and the reference is
+// valid until the iterator is advanced. The generator is a move-only input
+// view and composes with std::views (filter, take_while, ...). Destroying it
+// destroys the suspended coroutine frame, so breaking out of a loop stops
+// all further work immediately.
+template<typename T>
+class Generator : public std::ranges::view_base {
+	public:
+		struct promise_type {
+			const T* current = nullptr;
+			std::exception_ptr exception;
+
+			Generator get_return_object() noexcept {
+				return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			std::suspend_always final_suspend() const noexcept { return {}; }
+			std::suspend_always yield_value(const T& value) noexcept {
+				current = std::addressof(value);
+				return {};
+			}
+			void return_void() const noexcept {}
+			void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+			// co_await is not supported inside a generator
+			template<typename U>
+			std::suspend_never await_transform(U&&) = delete;
+		};
+
+		using Handle = std::coroutine_handle<promise_type>;
+
+		class Iterator {
+			public:
+				using iterator_concept = std::input_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = T;
+
+				Iterator() = default;
+				explicit Iterator(Handle handle) : handle(handle) {}
+
+				const T& operator*() const { return *handle.promise().current; }
+				const T* operator->() const { return handle.promise().current; }
+
+				Iterator& operator++() {
+					advance(handle);
+					return *this;
+				}
+				void operator++(int) { ++*this; }
+
+				friend bool operator==(const Iterator& it, std::default_sentinel_t) noexcept {
+					return !it.handle || it.handle.done();
+				}
+
+			private:
+				Handle handle = nullptr;
+		};
+
+		Generator(Generator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		Generator& operator=(Generator&& other) noexcept {
+			if (this != &other) {
+				if (handle) {
+					handle.destroy();
+				}
+				handle = std::exchange(other.handle, nullptr);
+			}
+			return *this;
+		}
+		~Generator() {
+			if (handle) {
+				handle.destroy();
+			}
+		}
+
+		// Starts the coroutine; must be called once
+		Iterator begin() {
+			advance(handle);
+			return Iterator(handle);
+		}
+		std::default_sentinel_t end() const noexcept { return {}; }
+
+	private:
+		explicit Generator(Handle handle) : handle(handle) {}
+
+		static void advance(Handle handle) {
+			handle.resume();
+			if (handle.promise().exception) {
+				std::rethrow_exception(std::exchange(handle.promise().exception, nullptr));
+			}
+		}
+
+		Handle handle;
+};
+
+#endif // GENERATOR_H
@@ -0,0 +1,85 @@
+#include "InstrumentIndex.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <fstream>
+#include <string_view>
+
+#include "log.h"
+
+InstrumentIndex::InstrumentIndex(size_t expectedInstruments) {
+	securityIds.reserve(expectedInstruments);
+	rehash(std::bit_ceil(std::max<size_t>(expectedInstruments * 2, 16)));
+}
+
+uint32_t InstrumentIndex::assign(int32_t securityId) {
+	size_t slot = hash(securityId);
+	for (; table[slot].index != NOT_FOUND; slot = (slot + 1) & mask) {
+		if (table[slot].securityId == securityId) {
+			return table[slot].index;
+		}
+	}
+
+	uint32_t index = static_cast<uint32_t>(securityIds.size());
+	securityIds.push_back(securityId);
+	table[slot] = Entry{securityId, index};
+
+	// Keep the table at most half full so probe sequences stay short
+	if (securityIds.size() * 2 > table.size()) {
+		rehash(table.size() * 2);
+	}
+	return index;
+}
+
+void InstrumentIndex::reserve(size_t expectedInstruments) {
+	securityIds.reserve(expectedInstruments);
+	if (expectedInstruments * 2 > table.size()) {
+		rehash(std::bit_ceil(expectedInstruments * 2));
+	}
+}
+
+void InstrumentIndex::rehash(size_t capacity) {
+	table.assign(capacity, Entry{});
+	mask = capacity - 1;
+	shift = 32 - static_cast<unsigned>(std::countr_zero(capacity));
+
+	for (uint32_t index = 0; index < securityIds.size(); ++index) {
+		size_t slot = hash(securityIds[index]);
+		while (table[slot].index != NOT_FOUND) {
+			slot = (slot + 1) & mask;
+		}
+		table[slot] = Entry{securityIds[index], index};
+	}
+}
+
+bool InstrumentIndex::loadFile(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		LOG_ERROR("Cannot open instrument file " << path);
+		return false;
+	}
+
+	size_t before = size();
+	size_t lineNumber = 0;
+	std::string line;
+	while (std::getline(file, line)) {
+		++lineNumber;
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line[start] == '#') {
+			continue;
+		}
+		// The SecurityID, optionally followed by more columns; from_chars fails on int32 overflow
+		std::string_view field(line.data() + start, std::min(line.find(',', start), line.size()) - start);
+		field = field.substr(0, field.find_last_not_of(" \t\r") + 1);
+		int32_t securityId = 0;
+		auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), securityId);
+		if (field.empty() || error != std::errc() || end != field.data() + field.size()) {
+			LOG_WARNING("Ignoring line " << lineNumber << " of " << path << ": no valid SecurityID");
+			continue;
+		}
+		assign(securityId);
+	}
+
+	LOG_INFO("Loaded " << size() - before << " instruments from " << path);
+	return true;
+}
@@ -0,0 +1,64 @@
+// InstrumentIndex.h
+
+#ifndef INSTRUMENT_INDEX_H
+#define INSTRUMENT_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Assigns every SecurityID a dense index (0, 1, 2, ... in order of first
+// sight), so per-instrument state can live in flat arrays indexed by it.
+// The SecurityID -> index table is open-addressed with linear probing over
+// 8-byte entries kept at most half full: a lookup is one multiplicative hash
+// and usually a single cache line, instead of the bucket and node chase of
+// std::unordered_map.
+class InstrumentIndex {
+	public:
+		static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+		explicit InstrumentIndex(size_t expectedInstruments = 1024);
+
+		// Index of securityId, or NOT_FOUND
+		[[nodiscard]] uint32_t find(int32_t securityId) const noexcept {
+			for (size_t slot = hash(securityId); ; slot = (slot + 1) & mask) {
+				const Entry& entry = table[slot];
+				if (entry.index == NOT_FOUND || entry.securityId == securityId) {
+					return entry.index;
+				}
+			}
+		}
+
+		// Index of securityId, assigning the next free one on first sight
+		uint32_t assign(int32_t securityId);
+
+		// Sizes the table for expectedInstruments without rehashing on the way
+		void reserve(size_t expectedInstruments);
+
+		[[nodiscard]] int32_t securityIdAt(uint32_t index) const noexcept { return securityIds[index]; }
+		[[nodiscard]] size_t size() const noexcept { return securityIds.size(); }
+
+		// Preloads instruments from a text file: one SecurityID per line, optionally followed
+		// by a comma and further fields (e.g. the symbol); empty lines and '#' comments are skipped
+		bool loadFile(const std::string& path);
+
+	private:
+		struct Entry {
+			int32_t securityId = 0;
+			uint32_t index = NOT_FOUND;
+		};
+
+		// Fibonacci hashing: SecurityIDs are often sequential, the multiply spreads them
+		[[nodiscard]] size_t hash(int32_t securityId) const noexcept {
+			return (static_cast<uint32_t>(securityId) * 0x9E3779B1u) >> shift;
+		}
+
+		void rehash(size_t capacity);
+
+		std::vector<Entry> table;
+		size_t mask = 0;
+		unsigned shift = 0;
+		std::vector<int32_t> securityIds;
+};
+
+#endif // INSTRUMENT_INDEX_H
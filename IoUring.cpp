@@ -0,0 +1,162 @@
+#include "IoUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+// IORING_OP_READ and IORING_REGISTER_PROBE both arrived in Linux 5.6. On 5.1-5.5 the
+// ring sets up fine but every read completes with -EINVAL, so the probe failing counts as no.
+bool readOpSupported(int fd) {
+	constexpr unsigned OP_COUNT = 256;
+	alignas(io_uring_probe) unsigned char buffer[sizeof(io_uring_probe) + OP_COUNT * sizeof(io_uring_probe_op)] = {};
+	auto* probe = reinterpret_cast<io_uring_probe*>(buffer);
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, OP_COUNT) < 0) {
+		return false;
+	}
+	return probe->ops_len > IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+template<typename T>
+T* ringField(void* ring, uint32_t offset) {
+	return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	ringFd = ioUringSetup(entries, &params);
+	if (ringFd < 0) {
+		error = std::string("io_uring_setup: ") + std::strerror(errno);
+		return;
+	}
+	if (!readOpSupported(ringFd)) {
+		error = "the kernel does not support IORING_OP_READ (Linux 5.6 or later)";
+		::close(ringFd);
+		ringFd = -1;
+		return;
+	}
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMmap) {
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	}
+
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		sqRing = nullptr;
+	} else if (singleMmap) {
+		cqRing = sqRing;
+	} else {
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			cqRing = nullptr;
+		}
+	}
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void* sqeRegion = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (!sqRing || !cqRing || sqeRegion == MAP_FAILED) {
+		error = std::string("mmap of the io_uring rings: ") + std::strerror(errno);
+		if (sqeRegion != MAP_FAILED) {
+			munmap(sqeRegion, sqesSize);
+		}
+		if (cqRing && cqRing != sqRing) {
+			munmap(cqRing, cqRingSize);
+		}
+		if (sqRing) {
+			munmap(sqRing, sqRingSize);
+		}
+		sqRing = cqRing = nullptr;
+		::close(ringFd);
+		ringFd = -1;
+		return;
+	}
+	sqes = static_cast<io_uring_sqe*>(sqeRegion);
+
+	// The kernel updates the heads and tails concurrently; they are plain uint32_t in the ABI
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free);
+	sqHead = ringField<std::atomic<uint32_t>>(sqRing, params.sq_off.head);
+	sqTail = ringField<std::atomic<uint32_t>>(sqRing, params.sq_off.tail);
+	sqMask = *ringField<uint32_t>(sqRing, params.sq_off.ring_mask);
+	sqEntries = *ringField<uint32_t>(sqRing, params.sq_off.ring_entries);
+	sqArray = ringField<uint32_t>(sqRing, params.sq_off.array);
+
+	cqHead = ringField<std::atomic<uint32_t>>(cqRing, params.cq_off.head);
+	cqTail = ringField<std::atomic<uint32_t>>(cqRing, params.cq_off.tail);
+	cqMask = *ringField<uint32_t>(cqRing, params.cq_off.ring_mask);
+	cqes = ringField<io_uring_cqe>(cqRing, params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+	if (ringFd < 0) {
+		return;
+	}
+	munmap(sqes, sqesSize);
+	if (cqRing != sqRing) {
+		munmap(cqRing, cqRingSize);
+	}
+	munmap(sqRing, sqRingSize);
+	::close(ringFd);
+}
+
+bool IoUring::queueRead(int fd, void* buffer, uint32_t length, uint64_t offset, uint64_t userData) {
+	uint32_t tail = sqTail->load(std::memory_order_relaxed);
+	if (tail - sqHead->load(std::memory_order_acquire) >= sqEntries) {
+		return false;
+	}
+	uint32_t index = tail & sqMask;
+	io_uring_sqe& sqe = sqes[index];
+	std::memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_READ;
+	sqe.fd = fd;
+	sqe.addr = reinterpret_cast<uint64_t>(buffer);
+	sqe.len = length;
+	sqe.off = offset;
+	sqe.user_data = userData;
+	sqArray[index] = index;
+	// The entry must be visible to the kernel before the new tail
+	sqTail->store(tail + 1, std::memory_order_release);
+	++toSubmit;
+	return true;
+}
+
+bool IoUring::submit(bool wait) {
+	for (;;) {
+		int submitted = ioUringEnter(ringFd, toSubmit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+		if (submitted >= 0) {
+			toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(submitted));
+			return true;
+		}
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+}
+
+bool IoUring::popCompletion(uint64_t& userData, int32_t& result) {
+	uint32_t head = cqHead->load(std::memory_order_relaxed);
+	if (head == cqTail->load(std::memory_order_acquire)) {
+		return false;
+	}
+	const io_uring_cqe& cqe = cqes[head & cqMask];
+	userData = cqe.user_data;
+	result = cqe.res;
+	cqHead->store(head + 1, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,65 @@
+// IoUring.h
+
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Minimal io_uring instance for file reads, set up with the raw system calls
+// (no liburing dependency). Reads are queued into the submission ring and
+// handed to the kernel by submit(); completions are popped in the order the
+// kernel finishes them, tagged with the caller's userData. Not thread-safe.
+class IoUring {
+	public:
+		explicit IoUring(unsigned entries);
+		~IoUring();
+
+		IoUring(const IoUring&) = delete;
+		IoUring& operator=(const IoUring&) = delete;
+
+		// False if the kernel lacks io_uring or its read opcode (before 5.6), or io_uring is
+		// blocked (seccomp, sysctl); see getError()
+		bool isValid() const { return ringFd >= 0; }
+		const std::string& getError() const { return error; }
+
+		// Queues a read of length bytes at offset into buffer; false if the submission ring is full
+		bool queueRead(int fd, void* buffer, uint32_t length, uint64_t offset, uint64_t userData);
+
+		// Hands the queued reads to the kernel and, if wait is set, blocks until at least one
+		// completion is available. Returns false with errno set on failure.
+		bool submit(bool wait);
+
+		// Pops one completion: result is the byte count or -errno of the read
+		bool popCompletion(uint64_t& userData, int32_t& result);
+
+	private:
+		int ringFd = -1;
+		std::string error;
+		unsigned toSubmit = 0;
+
+		void* sqRing = nullptr;
+		size_t sqRingSize = 0;
+		void* cqRing = nullptr;          // Same mapping as sqRing with IORING_FEAT_SINGLE_MMAP
+		size_t cqRingSize = 0;
+		io_uring_sqe* sqes = nullptr;
+		size_t sqesSize = 0;
+
+		std::atomic<uint32_t>* sqHead = nullptr;
+		std::atomic<uint32_t>* sqTail = nullptr;
+		uint32_t sqMask = 0;
+		uint32_t sqEntries = 0;
+		uint32_t* sqArray = nullptr;
+
+		std::atomic<uint32_t>* cqHead = nullptr;
+		std::atomic<uint32_t>* cqTail = nullptr;
+		uint32_t cqMask = 0;
+		io_uring_cqe* cqes = nullptr;
+};
+
+#endif // IO_URING_H
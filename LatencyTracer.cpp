@@ -0,0 +1,135 @@
+#include "LatencyTracer.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <map>
+
+#include "log.h"
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) noexcept {
+	if (value < SUB_BUCKETS) {
+		return static_cast<size_t>(value);
+	}
+	unsigned msb = static_cast<unsigned>(std::bit_width(value)) - 1;
+	unsigned shift = msb - SUB_BUCKET_BITS;
+	return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) noexcept {
+	if (index < SUB_BUCKETS) {
+		return index;
+	}
+	unsigned shift = static_cast<unsigned>(index / SUB_BUCKETS) - 1;
+	uint64_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+	return lower + ((uint64_t{1} << shift) - 1);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const noexcept {
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(count));
+	if (rank >= count) {
+		rank = count - 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+		seen += buckets[i];
+		if (seen > rank) {
+			return std::min(bucketUpperBound(i), maxValue);
+		}
+	}
+	return maxValue;
+}
+
+uint64_t LatencyTracer::wallClockNs() noexcept {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+void LatencyTracer::recordStage(StageHistograms& histograms, LatencyStage stage, uint64_t from, uint64_t to) {
+	if (from == 0 || to == 0) {
+		return;
+	}
+	if (to < from) [[unlikely]] {
+		++negativeDeltas;
+		histograms[static_cast<size_t>(stage)].record(0);
+		return;
+	}
+	histograms[static_cast<size_t>(stage)].record(to - from);
+}
+
+void LatencyTracer::recordMessage(int32_t securityId, uint16_t templateId, const LatencySample& sample) {
+	uint32_t index = instruments.assign(securityId);
+	if (index == perInstrument.size()) [[unlikely]] {
+		perInstrument.emplace_back();
+	}
+	StageHistograms* targets[] = { &total, &perInstrument[index],
+		templateId <= MAX_TEMPLATE_ID ? &perTemplate[templateId] : nullptr };
+
+	for (StageHistograms* histograms : targets) {
+		if (!histograms) {
+			continue;
+		}
+		recordStage(*histograms, LatencyStage::ExchangeSend, sample.transactTime, sample.sendingTime);
+		recordStage(*histograms, LatencyStage::Wire, sample.sendingTime, sample.captureTime);
+		recordStage(*histograms, LatencyStage::CaptureToDecode, sample.captureTime, sample.decodeCompleteTime);
+		recordStage(*histograms, LatencyStage::Decode, sample.decodeStartTime, sample.decodeCompleteTime);
+	}
+}
+
+const char* LatencyTracer::stageName(LatencyStage stage) noexcept {
+	switch (stage) {
+		case LatencyStage::ExchangeSend: return "transact->send";
+		case LatencyStage::Wire: return "send->capture";
+		case LatencyStage::CaptureToDecode: return "capture->decoded";
+		case LatencyStage::Decode: return "decode";
+		default: return "unknown";
+	}
+}
+
+void LatencyTracer::printHistograms(const std::string& title, const StageHistograms& histograms) {
+	LOG_INFO(title);
+	for (size_t i = 0; i < STAGE_COUNT; ++i) {
+		const LatencyHistogram& h = histograms[i];
+		if (h.getCount() == 0) {
+			continue;
+		}
+		LOG_INFO("  " << stageName(static_cast<LatencyStage>(i))
+				<< ": count=" << h.getCount()
+				<< " min=" << h.getMin()
+				<< " mean=" << h.getMean()
+				<< " p50=" << h.percentile(50.0)
+				<< " p99=" << h.percentile(99.0)
+				<< " p99.9=" << h.percentile(99.9)
+				<< " max=" << h.getMax() << " ns");
+	}
+}
+
+void LatencyTracer::reserve(size_t instrumentCount) {
+	instruments.reserve(instrumentCount);
+	perInstrument.reserve(instrumentCount);
+}
+
+void LatencyTracer::printReport() const {
+	LOG_INFO("Latency report (negative deltas clamped to 0: " << negativeDeltas << ")");
+	printHistograms("All messages:", total);
+
+	for (size_t templateId = 0; templateId < perTemplate.size(); ++templateId) {
+		const StageHistograms& histograms = perTemplate[templateId];
+		bool recorded = std::any_of(histograms.begin(), histograms.end(),
+				[](const LatencyHistogram& h) { return h.getCount() > 0; });
+		if (recorded) {
+			printHistograms("TemplateID " + std::to_string(templateId) + ":", histograms);
+		}
+	}
+
+	// Sorted by SecurityID for stable, diffable output
+	std::map<int32_t, const StageHistograms*> sorted;
+	for (uint32_t index = 0; index < perInstrument.size(); ++index) {
+		sorted.emplace(instruments.securityIdAt(index), &perInstrument[index]);
+	}
+	for (const auto& [securityId, histograms] : sorted) {
+		printHistograms("SecurityID " + std::to_string(securityId) + ":", *histograms);
+	}
+}
@@ -0,0 +1,108 @@
+// LatencyTracer.h
+
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "InstrumentIndex.h"
+
+// Pipeline stages traced for every decoded message:
+//   ExchangeSend    - TransactTime -> SendingTime (inside the exchange)
+//   Wire            - SendingTime  -> pcap capture timestamp
+//   CaptureToDecode - pcap capture timestamp -> decode complete (local wall clock)
+//   Decode          - decodeMessage entry -> decode complete
+enum class LatencyStage : uint8_t {
+	ExchangeSend = 0,
+	Wire,
+	CaptureToDecode,
+	Decode,
+	Count
+};
+
+// Timestamps (nanoseconds since epoch) collected for one decoded packet.
+// A zero timestamp means "not available" and the stages depending on it are skipped.
+struct LatencySample {
+	uint64_t transactTime = 0;
+	uint64_t sendingTime = 0;
+	uint64_t captureTime = 0;
+	uint64_t decodeStartTime = 0;
+	uint64_t decodeCompleteTime = 0;
+};
+
+// Log-linear histogram: every power-of-two range is split into SUB_BUCKETS
+// linear buckets, giving <25% relative error with a fixed 1KB footprint and
+// an O(1), branch-light record().
+class LatencyHistogram {
+	public:
+		void record(uint64_t valueNs) noexcept {
+			++buckets[bucketIndex(valueNs)];
+			++count;
+			sum += static_cast<double>(valueNs);
+			if (valueNs < minValue) minValue = valueNs;
+			if (valueNs > maxValue) maxValue = valueNs;
+		}
+
+		[[nodiscard]] uint64_t percentile(double p) const noexcept;
+		[[nodiscard]] uint64_t getCount() const noexcept { return count; }
+		[[nodiscard]] uint64_t getMin() const noexcept { return count ? minValue : 0; }
+		[[nodiscard]] uint64_t getMax() const noexcept { return maxValue; }
+		[[nodiscard]] uint64_t getMean() const noexcept { return count ? static_cast<uint64_t>(sum / static_cast<double>(count)) : 0; }
+
+	private:
+		static constexpr unsigned SUB_BUCKET_BITS = 2;
+		static constexpr unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+		static constexpr size_t BUCKET_COUNT = 64 * SUB_BUCKETS;
+
+		static size_t bucketIndex(uint64_t value) noexcept;
+		static uint64_t bucketUpperBound(size_t index) noexcept;
+
+		std::array<uint32_t, BUCKET_COUNT> buckets{};
+		uint64_t count = 0;
+		double sum = 0.0; // double: capture->decode deltas on replays would overflow uint64_t
+		uint64_t minValue = UINT64_MAX;
+		uint64_t maxValue = 0;
+};
+
+// Histograms per stage, in total, per template and per instrument. Templates
+// up to MAX_TEMPLATE_ID have a fixed slot; instruments are numbered by an
+// InstrumentIndex and their histograms kept in a flat array, so recording a
+// message neither hashes into a node map nor allocates once reserve() has
+// sized it for the instrument universe.
+class LatencyTracer {
+	public:
+		static constexpr size_t STAGE_COUNT = static_cast<size_t>(LatencyStage::Count);
+		// SIMBA market data templates are numbered below this; higher ones go to the total only
+		static constexpr uint16_t MAX_TEMPLATE_ID = 31;
+
+		using StageHistograms = std::array<LatencyHistogram, STAGE_COUNT>;
+
+		// Records all stages of one decoded message
+		void recordMessage(int32_t securityId, uint16_t templateId, const LatencySample& sample);
+
+		// Sizes the per-instrument storage (e.g. SimbaDecoder::getInstruments().size())
+		void reserve(size_t instrumentCount);
+
+		void printReport() const;
+
+		[[nodiscard]] static uint64_t wallClockNs() noexcept;
+
+	private:
+		void recordStage(StageHistograms& histograms, LatencyStage stage, uint64_t from, uint64_t to);
+
+		static const char* stageName(LatencyStage stage) noexcept;
+		static void printHistograms(const std::string& title, const StageHistograms& histograms);
+
+		StageHistograms total;
+		std::array<StageHistograms, MAX_TEMPLATE_ID + 1> perTemplate;
+		InstrumentIndex instruments;
+		std::vector<StageHistograms> perInstrument;   // perInstrument[i] belongs to instruments.securityIdAt(i)
+
+		// Deltas where the later timestamp precedes the earlier one (clock skew between hosts)
+		uint64_t negativeDeltas = 0;
+};
+
+#endif // LATENCY_TRACER_H
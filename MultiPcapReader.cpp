@@ -0,0 +1,303 @@
+#include "MultiPcapReader.h"
+#include "Decompressor.h"
+#include "PcapStreamReader.h"
+#include "PcapngReader.h"
+#include "Placement.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+
+namespace {
+
+// Decompressed start of a capture, read on demand
+class CaptureHead {
+	public:
+		explicit CaptureHead(int fd) : decompressor(fd) {
+			valid = decompressor.open();
+		}
+
+		bool isCompressed() const { return decompressor.getFormat() != Decompressor::Format::None; }
+
+		// Makes the first length bytes available; false if the capture is shorter or unreadable
+		bool fill(size_t length) {
+			if (!valid || length > MAX_SCAN) {
+				return false;
+			}
+			if (bytes.size() < length) {
+				size_t filled = bytes.size();
+				bytes.resize(length);
+				while (filled < length && !decompressor.atEnd()) {
+					ssize_t n = decompressor.read(bytes.data() + filled, length - filled);
+					if (n < 0) {
+						break;
+					}
+					filled += static_cast<size_t>(n);
+				}
+				bytes.resize(filled);
+			}
+			return bytes.size() >= length;
+		}
+
+		const uint8_t* data() const { return bytes.data(); }
+
+	private:
+		// pcapng metadata ahead of the first packet is small; give up beyond this
+		static constexpr size_t MAX_SCAN = 16 * 1024 * 1024;
+
+		Decompressor decompressor;
+		std::vector<uint8_t> bytes;
+		bool valid = false;
+};
+
+bool readFirstPcapngTimestamp(CaptureHead& head, uint64_t& timestamp) {
+	PcapngSection section;
+	size_t offset = 0;
+	while (head.fill(offset + PcapngSection::BLOCK_PEEK_SIZE)) {
+		uint32_t type;
+		uint32_t length;
+		if (!section.peekBlock(head.data() + offset, type, length) || !head.fill(offset + length)) {
+			return false;
+		}
+		PcapngPacket packet;
+		PcapngSection::BlockResult result = section.processBlock(head.data() + offset, type, length, packet);
+		if (result == PcapngSection::BlockResult::Invalid) {
+			return false;
+		}
+		if (result == PcapngSection::BlockResult::Packet) {
+			timestamp = packet.captureTime;
+			return true;
+		}
+		offset += length;
+	}
+	return false;
+}
+
+// Timestamp of the first record of a capture, without opening a full parser.
+// Compressed captures are decompressed just far enough.
+bool readFirstTimestamp(const std::string& filename, uint64_t& timestamp, bool& compressed, bool& pcapng) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	CaptureHead head(fd);
+	bool found = false;
+	if (head.fill(sizeof(PCAPFileHeader) + sizeof(PCAPPacketHeader))) {
+		compressed = head.isCompressed();
+		pcapng = PcapngSection::isPcapng(head.data(), sizeof(PCAPFileHeader));
+		if (pcapng) {
+			found = readFirstPcapngTimestamp(head, timestamp);
+		} else {
+			PCAPFileHeader fileHeader;
+			PCAPPacketHeader packetHeader;
+			std::memcpy(&fileHeader, head.data(), sizeof(fileHeader));
+			std::memcpy(&packetHeader, head.data() + sizeof(fileHeader), sizeof(packetHeader));
+			uint32_t magic = le32toh(fileHeader.magic_number);
+			if (magic == PCAP_MAGIC_MICROSECONDS || magic == PCAP_MAGIC_NANOSECONDS) {
+				packetHeader.ts_sec = le32toh(packetHeader.ts_sec);
+				packetHeader.ts_usec = le32toh(packetHeader.ts_usec);
+				timestamp = pcapCaptureTimeNs(packetHeader, magic == PCAP_MAGIC_NANOSECONDS);
+				found = true;
+			}
+		}
+	}
+	close(fd);
+	return found;
+}
+
+bool isCaptureName(const std::string& name) {
+	for (const char* extension : {".pcap", ".pcapng"}) {
+		for (const char* compression : {"", ".gz", ".zst"}) {
+			if (name.ends_with(std::string(extension) + compression)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+MultiPcapReader::MultiPcapReader(const std::vector<std::string>& filenames) {
+	for (const std::string& filename : filenames) {
+		Input input;
+		input.filename = filename;
+		if (!readFirstTimestamp(filename, input.firstTimestamp, input.compressed, input.pcapng)) {
+			LOG_WARNING("Skipping " << filename << ": not a readable pcap capture or no packets");
+			continue;
+		}
+		inputs.push_back(std::move(input));
+	}
+	// Stable, so captures starting at the same time keep their command-line order
+	std::stable_sort(inputs.begin(), inputs.end(), [](const Input& a, const Input& b) {
+			return a.firstTimestamp < b.firstTimestamp;
+		});
+	LOG_INFO("Merging " << inputs.size() << " captures by capture time");
+
+	if (!inputs.empty()) {
+		prefetchThread = std::thread(&MultiPcapReader::prefetchLoop, this);
+		Placement::pinThread(prefetchThread, ThreadRole::Prefetch);
+		schedulePrefetch();
+	}
+}
+
+MultiPcapReader::~MultiPcapReader() {
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		stopping = true;
+	}
+	prefetchReady.notify_one();
+	if (prefetchThread.joinable()) {
+		prefetchThread.join();
+	}
+}
+
+bool MultiPcapReader::nextPacket(CapturedPacket& packet) {
+	// The previous packet is consumed now, so its input's buffer may be reused
+	if (current != SIZE_MAX) {
+		if (advance(current)) {
+			pushHeap(current);
+		} else {
+			LOG_INFO("Finished " << inputs[current].filename);
+			inputs[current].parser.reset();
+		}
+		current = SIZE_MAX;
+	}
+
+	// Open every capture whose first packet may precede the earliest pending one
+	while (nextInactive < inputs.size()
+			&& (heap.empty() || inputs[nextInactive].firstTimestamp <= inputs[heap.front()].head.captureTime)) {
+		activateNext();
+	}
+	if (heap.empty()) {
+		return false;
+	}
+
+	current = popHeap();
+	packet = inputs[current].head;
+	return true;
+}
+
+bool MultiPcapReader::activateNext() {
+	size_t index = nextInactive++;
+	Input& input = inputs[index];
+	bool valid;
+	if (input.compressed) {
+		auto reader = std::make_unique<PcapStreamReader>(input.filename);
+		valid = reader->isValid();
+		input.parser = std::move(reader);
+	} else if (input.pcapng) {
+		auto reader = std::make_unique<PcapngReader>(input.filename);
+		reader->setPerfCounters(perfCounters);
+		valid = reader->isValid();
+		input.parser = std::move(reader);
+	} else {
+		auto parser = std::make_unique<PCAPParser>(input.filename);
+		parser->setPerfCounters(perfCounters);
+		valid = parser->isValid();
+		input.parser = std::move(parser);
+	}
+	schedulePrefetch();
+	if (!valid || !advance(index)) {
+		input.parser.reset();
+		return false;
+	}
+	pushHeap(index);
+	return true;
+}
+
+bool MultiPcapReader::advance(size_t index) {
+	Input& input = inputs[index];
+	return input.parser->nextPacket(input.head);
+}
+
+bool MultiPcapReader::later(size_t a, size_t b) const {
+	uint64_t timeA = inputs[a].head.captureTime;
+	uint64_t timeB = inputs[b].head.captureTime;
+	return timeA > timeB || (timeA == timeB && a > b);
+}
+
+void MultiPcapReader::pushHeap(size_t index) {
+	heap.push_back(index);
+	std::push_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+}
+
+size_t MultiPcapReader::popHeap() {
+	std::pop_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+	size_t index = heap.back();
+	heap.pop_back();
+	return index;
+}
+
+void MultiPcapReader::schedulePrefetch() {
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		while (nextPrefetch < inputs.size() && nextPrefetch < nextInactive + PREFETCH_FILES) {
+			prefetchQueue.push_back(inputs[nextPrefetch++].filename);
+		}
+	}
+	prefetchReady.notify_one();
+}
+
+// Runs on the prefetch thread; must not log (the logger is not thread-safe)
+void MultiPcapReader::prefetchLoop() {
+	for (;;) {
+		std::string filename;
+		{
+			std::unique_lock<std::mutex> lock(prefetchMutex);
+			prefetchReady.wait(lock, [this] { return stopping || !prefetchQueue.empty(); });
+			if (stopping) {
+				return;
+			}
+			filename = std::move(prefetchQueue.front());
+			prefetchQueue.pop_front();
+		}
+
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			continue;
+		}
+		struct stat st;
+		if (fstat(fd, &st) == 0) {
+			// readahead() blocks until the chunk is queued, so go chunk by chunk and stay interruptible
+			for (off_t offset = 0; offset < st.st_size; offset += PREFETCH_CHUNK) {
+				{
+					std::lock_guard<std::mutex> lock(prefetchMutex);
+					if (stopping) {
+						break;
+					}
+				}
+				readahead(fd, offset, PREFETCH_CHUNK);
+			}
+		}
+		close(fd);
+	}
+}
+
+std::vector<std::string> MultiPcapReader::expandInputs(const std::string& spec) {
+	std::vector<std::string> filenames;
+	std::error_code error;
+	if (std::filesystem::is_directory(spec, error)) {
+		for (const auto& entry : std::filesystem::directory_iterator(spec, error)) {
+			std::string name = entry.path().filename().string();
+			if (entry.is_regular_file(error) && isCaptureName(name)) {
+				filenames.push_back(entry.path().string());
+			}
+		}
+		std::sort(filenames.begin(), filenames.end());
+	} else if (spec.find_first_of("*?[") != std::string::npos) {
+		glob_t matches;
+		if (glob(spec.c_str(), 0, nullptr, &matches) == 0) {
+			filenames.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+		}
+		globfree(&matches);
+	} else {
+		filenames.push_back(spec);
+	}
+	return filenames;
+}
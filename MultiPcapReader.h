@@ -0,0 +1,80 @@
+// MultiPcapReader.h
+
+#ifndef MULTI_PCAP_READER_H
+#define MULTI_PCAP_READER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PCAPParser.h"
+
+// Presents several captures as one packet stream ordered by capture time.
+// Inputs are k-way merged on their pcap timestamps (ties go to the earlier
+// input), which covers both rotated files, whose time ranges follow each
+// other, and captures of parallel ports, whose ranges overlap. An input is
+// only opened once the merge reaches its first timestamp and is closed when
+// it runs out, so a long rotation keeps few files open. A background thread
+// pulls the next files into the page cache ahead of the merge. Compressed
+// inputs are decompressed on the fly by a PcapStreamReader each; pcapng
+// and pcap inputs can be mixed.
+class MultiPcapReader : public PacketSource {
+	public:
+		static constexpr size_t PREFETCH_FILES = 2;
+		static constexpr uint64_t PREFETCH_CHUNK = 8 * 1024 * 1024;
+
+		explicit MultiPcapReader(const std::vector<std::string>& filenames);
+		~MultiPcapReader();
+
+		MultiPcapReader(const MultiPcapReader&) = delete;
+		MultiPcapReader& operator=(const MultiPcapReader&) = delete;
+
+		// Valid if at least one input is a readable capture
+		bool isValid() const { return !inputs.empty(); }
+
+		bool nextPacket(CapturedPacket& packet) override;
+
+		// Passed on to the parser of every input; must outlive the reader
+		void setPerfCounters(PerfCounters* counters) noexcept { perfCounters = counters; }
+
+		// Expands a directory (its *.pcap and *.pcapng files, also with .gz or .zst appended),
+		// a glob pattern or a plain file name into sorted file names
+		static std::vector<std::string> expandInputs(const std::string& spec);
+
+	private:
+		struct Input {
+			std::string filename;
+			uint64_t firstTimestamp = 0;     // Of the first record, ns since epoch
+			bool compressed = false;
+			bool pcapng = false;
+			std::unique_ptr<PacketSource> parser;
+			CapturedPacket head;             // Next packet of this input, valid while it is in the heap
+		};
+
+		bool activateNext();
+		bool advance(size_t index);
+		bool later(size_t a, size_t b) const;   // Heap order: a's head comes after b's
+		void pushHeap(size_t index);
+		size_t popHeap();
+		void schedulePrefetch();
+		void prefetchLoop();
+
+		std::vector<Input> inputs;           // Ordered by first timestamp
+		size_t nextInactive = 0;             // First input not opened yet
+		std::vector<size_t> heap;            // Min-heap of active inputs by head capture time
+		size_t current = SIZE_MAX;           // Input whose head was returned last
+		PerfCounters* perfCounters = nullptr;
+
+		std::thread prefetchThread;
+		std::mutex prefetchMutex;
+		std::condition_variable prefetchReady;
+		std::deque<std::string> prefetchQueue;
+		size_t nextPrefetch = 0;
+		bool stopping = false;
+};
+
+#endif // MULTI_PCAP_READER_H
@@ -0,0 +1,200 @@
+#include "OrderBook.h"
+#include <algorithm>
+
+#include "log.h"
+
+void OrderBook::addToLevel(const Order& order) {
+	if (order.side == MDEntryType::Bid) {
+		Level& level = bids[order.price];
+		level.size += order.size;
+		level.orders++;
+	} else if (order.side == MDEntryType::Offer) {
+		Level& level = asks[order.price];
+		level.size += order.size;
+		level.orders++;
+	}
+}
+
+void OrderBook::removeFromLevel(const Order& order) {
+	auto update = [&](auto& levels) {
+		auto it = levels.find(order.price);
+		if (it == levels.end()) {
+			return;
+		}
+		it->second.size -= order.size;
+		if (--it->second.orders == 0) {
+			levels.erase(it);
+		}
+	};
+
+	if (order.side == MDEntryType::Bid) {
+		update(bids);
+	} else if (order.side == MDEntryType::Offer) {
+		update(asks);
+	}
+}
+
+void OrderBook::addOrder(int64_t id, int64_t price, int64_t size, MDEntryType side) {
+	auto [it, inserted] = orders.try_emplace(id, Order{price, size, side});
+	if (!inserted) {
+		LOG_DEBUG("Duplicate MDEntryID " << id << " on New, replacing");
+		removeFromLevel(it->second);
+		it->second = Order{price, size, side};
+	}
+	addToLevel(it->second);
+}
+
+void OrderBook::changeOrder(int64_t id, int64_t price, int64_t size, MDEntryType side) {
+	auto it = orders.find(id);
+	if (it == orders.end()) {
+		LOG_DEBUG("Change for unknown MDEntryID " << id);
+		return;
+	}
+	removeFromLevel(it->second);
+	it->second = Order{price, size, side};
+	addToLevel(it->second);
+}
+
+void OrderBook::deleteOrder(int64_t id) {
+	auto it = orders.find(id);
+	if (it == orders.end()) {
+		return;
+	}
+	removeFromLevel(it->second);
+	orders.erase(it);
+}
+
+void OrderBook::apply(const OrderUpdate& update) {
+	if (update.RptSeq <= rptSeq) {
+		return;
+	}
+	rptSeq = update.RptSeq;
+	synchronized = true;
+
+	switch (update.UpdateAction) {
+		case MDUpdateAction::New:
+			addOrder(update.MDEntryID, update.MDEntryPx.mantissa, update.MDEntrySize, update.EntryType);
+			break;
+		case MDUpdateAction::Change:
+			changeOrder(update.MDEntryID, update.MDEntryPx.mantissa, update.MDEntrySize, update.EntryType);
+			break;
+		case MDUpdateAction::Delete:
+			deleteOrder(update.MDEntryID);
+			break;
+	}
+}
+
+void OrderBook::apply(const OrderExecution& execution) {
+	if (execution.RptSeq <= rptSeq) {
+		return;
+	}
+	rptSeq = execution.RptSeq;
+	synchronized = true;
+
+	// MDEntrySize carries the remaining quantity of the executed order
+	if (execution.UpdateAction == MDUpdateAction::Delete || execution.MDEntrySize <= 0) {
+		deleteOrder(execution.MDEntryID);
+	} else {
+		changeOrder(execution.MDEntryID, execution.MDEntryPx.mantissa, execution.MDEntrySize, execution.EntryType);
+	}
+}
+
+void OrderBook::clear() {
+	orders.clear();
+	bids.clear();
+	asks.clear();
+}
+
+void OrderBook::beginSnapshot(uint32_t snapshotRptSeq, bool reset) {
+	if (reset) {
+		// A lagging snapshot would roll back the updates applied since
+		loadingSnapshot = !synchronized || snapshotRptSeq > rptSeq;
+		if (!loadingSnapshot) {
+			LOG_DEBUG("Ignoring snapshot with RptSeq " << snapshotRptSeq << ", book is at " << rptSeq);
+			return;
+		}
+		clear();
+		synchronized = true;
+	} else if (!loadingSnapshot) {
+		// Continues an image that was ignored
+		return;
+	}
+	rptSeq = snapshotRptSeq;
+}
+
+void OrderBook::addSnapshotEntry(const OrderBookEntry& entry) {
+	if (!loadingSnapshot) {
+		return;
+	}
+	if (entry.EntryType == MDEntryType::EmptyBook) {
+		clear();
+		return;
+	}
+	addOrder(entry.MDEntryID, entry.MDEntryPx.mantissa, entry.MDEntrySize, entry.EntryType);
+}
+
+size_t OrderBook::topLevels(MDEntryType side, PriceLevel* out, size_t maxLevels) const {
+	auto copy = [&](const auto& levels) {
+		size_t n = 0;
+		for (auto it = levels.begin(); it != levels.end() && n < maxLevels; ++it, ++n) {
+			out[n] = PriceLevel{it->first, it->second.size, it->second.orders};
+		}
+		return n;
+	};
+
+	return side == MDEntryType::Bid ? copy(bids) : copy(asks);
+}
+
+const OrderBook& OrderBookManager::apply(const DecodedEvent& event) {
+	OrderBook& book = bookFor(event.securityId());
+	switch (event.type) {
+		case DecodedEventType::OrderUpdate:
+			book.apply(event.update);
+			break;
+		case DecodedEventType::OrderExecution:
+			book.apply(event.execution);
+			break;
+		case DecodedEventType::SnapshotBegin:
+			book.beginSnapshot(event.snapshotBegin.RptSeq, event.snapshotBegin.resetBook);
+			break;
+		case DecodedEventType::SnapshotEntry:
+			book.addSnapshotEntry(event.snapshotEntry.entry);
+			break;
+	}
+	return book;
+}
+
+void OrderBookManager::apply(const std::vector<DecodedEvent>& events, std::vector<int32_t>& changed) {
+	changed.clear();
+	for (const DecodedEvent& event : events) {
+		apply(event);
+		int32_t securityId = event.securityId();
+		if (std::find(changed.begin(), changed.end(), securityId) == changed.end()) {
+			changed.push_back(securityId);
+		}
+	}
+}
+
+const OrderBook* OrderBookManager::find(int32_t securityId) const {
+	uint32_t index = instruments.find(securityId);
+	return index != InstrumentIndex::NOT_FOUND ? &books[index] : nullptr;
+}
+
+OrderBook& OrderBookManager::restoreBook(int32_t securityId) {
+	OrderBook& book = bookFor(securityId);
+	book.clear();
+	return book;
+}
+
+void OrderBookManager::reserve(size_t instrumentCount) {
+	instruments.reserve(instrumentCount);
+	books.reserve(instrumentCount);
+}
+
+OrderBook& OrderBookManager::bookFor(int32_t securityId) {
+	uint32_t index = instruments.assign(securityId);
+	if (index == books.size()) [[unlikely]] {
+		books.emplace_back();
+	}
+	return books[index];
+}
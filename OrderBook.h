@@ -0,0 +1,123 @@
+// OrderBook.h
+
+#ifndef ORDER_BOOK_H
+#define ORDER_BOOK_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "DecodedEvent.h"
+#include "InstrumentIndex.h"
+#include "SimbaDecoder.h"
+
+struct PriceLevel {
+	int64_t price;   // Decimal5 mantissa
+	int64_t size;
+	uint32_t orders;
+};
+
+// Order-by-order book of a single instrument, aggregated into price levels.
+// Incrementals with RptSeq not newer than the last applied one are ignored,
+// so replaying a snapshot and then the incremental stream is idempotent.
+// Likewise, once the book is synchronized (by a snapshot, an incremental or a
+// restore) a snapshot no newer than it is ignored: the snapshot feed may lag
+// the incremental one, and loading it would roll the book back.
+class OrderBook {
+	public:
+		void apply(const OrderUpdate& update);
+		void apply(const OrderExecution& execution);
+
+		// Starts loading a snapshot image (clearing the book if reset is set);
+		// its entries follow through addSnapshotEntry(), and are dropped if the
+		// image is not newer than a synchronized book
+		void beginSnapshot(uint32_t snapshotRptSeq, bool reset);
+		void addSnapshotEntry(const OrderBookEntry& entry);
+
+		void clear();
+
+		// Copies up to maxLevels best levels of one side, best price first
+		size_t topLevels(MDEntryType side, PriceLevel* out, size_t maxLevels) const;
+
+		[[nodiscard]] uint32_t getRptSeq() const noexcept { return rptSeq; }
+		[[nodiscard]] bool isSynchronized() const noexcept { return synchronized; }
+		// Restores a saved book image, which counts as synchronized
+		void setRptSeq(uint32_t value) noexcept {
+			rptSeq = value;
+			synchronized = true;
+		}
+
+		// Checkpoint support: calls fn(int64_t id, int64_t price, int64_t size, MDEntryType side)
+		template<typename Fn>
+		void forEachOrder(Fn&& fn) const {
+			for (const auto& [id, order] : orders) {
+				fn(id, order.price, order.size, order.side);
+			}
+		}
+
+		void restoreOrder(int64_t id, int64_t price, int64_t size, MDEntryType side) { addOrder(id, price, size, side); }
+		[[nodiscard]] size_t orderCount() const noexcept { return orders.size(); }
+
+	private:
+		struct Order {
+			int64_t price;
+			int64_t size;
+			MDEntryType side;
+		};
+
+		struct Level {
+			int64_t size = 0;
+			uint32_t orders = 0;
+		};
+
+		void addOrder(int64_t id, int64_t price, int64_t size, MDEntryType side);
+		void changeOrder(int64_t id, int64_t price, int64_t size, MDEntryType side);
+		void deleteOrder(int64_t id);
+
+		void addToLevel(const Order& order);
+		void removeFromLevel(const Order& order);
+
+		std::unordered_map<int64_t, Order> orders;
+		std::map<int64_t, Level, std::greater<int64_t>> bids;
+		std::map<int64_t, Level> asks;
+		uint32_t rptSeq = 0;
+		bool synchronized = false;
+		bool loadingSnapshot = false;   // Entries of the current snapshot image are applied
+};
+
+// Books of all instruments seen on the feed
+class OrderBookManager {
+	public:
+		// Applies the events of one payload; changed is refilled with the SecurityIDs whose book changed
+		void apply(const std::vector<DecodedEvent>& events, std::vector<int32_t>& changed);
+
+		// Applies a single event and returns the book it changed
+		const OrderBook& apply(const DecodedEvent& event);
+
+		[[nodiscard]] const OrderBook* find(int32_t securityId) const;
+
+		template<typename Fn>
+		void forEachBook(Fn&& fn) const {
+			for (uint32_t index = 0; index < books.size(); ++index) {
+				fn(instruments.securityIdAt(index), books[index]);
+			}
+		}
+
+		// Returns an empty book for securityId to be filled from a checkpoint
+		OrderBook& restoreBook(int32_t securityId);
+		[[nodiscard]] size_t size() const noexcept { return books.size(); }
+
+		// Sizes storage for a known instrument universe (e.g. SimbaDecoder::getInstruments())
+		void reserve(size_t instrumentCount);
+
+	private:
+		OrderBook& bookFor(int32_t securityId);
+
+		// Books in order of first sight; books[i] belongs to instruments.securityIdAt(i)
+		InstrumentIndex instruments;
+		std::vector<OrderBook> books;
+};
+
+#endif // ORDER_BOOK_H
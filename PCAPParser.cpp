@@ -7,9 +7,15 @@
 #include <arpa/inet.h>
 #include <variant>
 
+#include "PerfCounters.h"
 #include "log.h"
 
-PCAPParser::PCAPParser(const std::string& filename) : file(filename, std::ios::binary) {
+PCAPParser::PCAPParser(const std::string& filename) : readBuffer(READ_BUFFER_SIZE, "pcap read buffer") {
+	// libstdc++ only accepts a stream buffer before the file is opened
+	if (readBuffer.data()) {
+		file.rdbuf()->pubsetbuf(static_cast<char*>(readBuffer.data()), static_cast<std::streamsize>(readBuffer.size()));
+	}
+	file.open(filename, std::ios::binary);
 	if (!file.is_open()) {
 		LOG_ERROR("Cannot open file: " << filename);
 		return;
@@ -18,19 +24,21 @@ PCAPParser::PCAPParser(const std::string& filename) : file(filename, std::ios::b
 
 	// Get file size
 	file.seekg(0, std::ios::end);
-	std::streampos fileSize = file.tellg();
+	fileSize = static_cast<uint64_t>(file.tellg());
 	file.seekg(0, std::ios::beg);
 	LOG_INFO("File size: " << fileSize << " bytes");
 
 	readFileHeader();
 }
 
-void PCAPParser::parsePackets(SimbaDecoder& decoder) {
-	PCAPPacketHeader packetHeader;
-	std::vector<uint8_t> packetData;
-	int packetCount [[maybe_unused]] = 0;
-
-	while (file.read(reinterpret_cast<char*>(&packetHeader), sizeof(PCAPPacketHeader))) {
+bool PCAPParser::nextPacket(CapturedPacket& packet) {
+	for (;;) {
+		if (perfCounters) {
+			perfCounters->begin();
+		}
+		if (!file.read(reinterpret_cast<char*>(&packetHeader), sizeof(PCAPPacketHeader))) {
+			break;
+		}
 		packetHeader.ts_sec = le32toh(packetHeader.ts_sec);
 		packetHeader.ts_usec = le32toh(packetHeader.ts_usec);
 		packetHeader.incl_len = le32toh(packetHeader.incl_len);
@@ -39,7 +47,12 @@ void PCAPParser::parsePackets(SimbaDecoder& decoder) {
 		packetData.resize(packetHeader.incl_len);
 		if (!file.read(reinterpret_cast<char*>(packetData.data()), packetHeader.incl_len)) {
 			LOG_ERROR("Failed to read packet data");
-			return;
+			return false;
+		}
+		nextPacketOffset += sizeof(PCAPPacketHeader) + packetHeader.incl_len;
+		if (perfCounters) {
+			perfCounters->end(PerfStage::PcapRead);
+			perfCounters->begin();
 		}
 
 		LOG_DEBUG("Packet " << ++packetCount << ":");
@@ -47,55 +60,84 @@ void PCAPParser::parsePackets(SimbaDecoder& decoder) {
 		LOG_DEBUG("  Captured Length: " << packetHeader.incl_len);
 		LOG_DEBUG("  Actual Length: " << packetHeader.orig_len);
 
-		// Parse Ethernet header
-		if (packetData.size() < sizeof(EthernetHeader)) {
-			LOG_DEBUG("  Packet too short for Ethernet header");
-			continue;
-		}
-		const EthernetHeader* ethHeader = reinterpret_cast<const EthernetHeader*>(packetData.data());
-		uint16_t etherType = ntohs(ethHeader->etherType);
-		LOG_DEBUG("  Ether Type: 0x" << std::hex << etherType << std::dec);
-
-		// Parse IP header
-		if (etherType != 0x0800 || packetData.size() < sizeof(EthernetHeader) + sizeof(IPHeader)) {
-			LOG_DEBUG("  Not an IPv4 packet or too short for IP header");
-			continue;
+		// Skipped frames end their stage too, so their cycles are not lost
+		bool parsed = parseLinkLayer(packetData.data(), packetData.size(), packet);
+		if (perfCounters) {
+			perfCounters->end(PerfStage::LinkParse);
 		}
-		const IPHeader* ipHeader = reinterpret_cast<const IPHeader*>(packetData.data() + sizeof(EthernetHeader));
-		uint8_t ipHeaderLength = (ipHeader->versionIHL & 0x0F) * 4;
-		char srcIP[INET_ADDRSTRLEN], destIP[INET_ADDRSTRLEN];
-		inet_ntop(AF_INET, &ipHeader->srcIP, srcIP, INET_ADDRSTRLEN);
-		inet_ntop(AF_INET, &ipHeader->destIP, destIP, INET_ADDRSTRLEN);
-		LOG_DEBUG("  IP: " << srcIP << " -> " << destIP);
-		LOG_DEBUG("  Protocol: " << static_cast<int>(ipHeader->protocol));
-
-		// Parse UDP header
-		if (ipHeader->protocol != 17 || packetData.size() < sizeof(EthernetHeader) + ipHeaderLength + sizeof(UDPHeader)) {
-			LOG_INFO("  Not a UDP packet or too short for UDP header");
-			continue;
+		if (parsed) {
+			packet.captureTime = captureTimeNs(packetHeader);
+			return true;
 		}
-		const UDPHeader* udpHeader = reinterpret_cast<const UDPHeader*>(packetData.data() + sizeof(EthernetHeader) + ipHeaderLength);
-		uint16_t srcPort [[maybe_unused]] = ntohs(udpHeader->srcPort);
-		uint16_t destPort [[maybe_unused]] = ntohs(udpHeader->destPort);
-		LOG_DEBUG("  UDP: " << srcPort << " -> " << destPort);
-
-		// Calculate offset to SIMBA data
-		size_t simbaOffset = sizeof(EthernetHeader) + ipHeaderLength + sizeof(UDPHeader);
-		size_t simbaLength = packetData.size() - simbaOffset;
-
-		LOG_DEBUG("  SIMBA data offset: " << simbaOffset);
-		LOG_DEBUG("  SIMBA data length: " << simbaLength);
-
-		// Print first few bytes of the SIMBA data
-		//LOG_DEBUG("  First 32 bytes of SIMBA data: ");
-		//for (size_t i = 0; i < std::min(size_t(32), simbaLength); ++i) {
-		//    LOG_DEBUG(std::hex << std::setw(2) << std::setfill('0') 
-		//              << static_cast<int>(packetData[simbaOffset + i]) << " ");
-		//}
-		//LOG_DEBUG(std::dec);
+	}
+	return false;
+}
+
+bool parseLinkLayer(const uint8_t* frame, size_t length, CapturedPacket& packet) {
+	// Parse Ethernet header
+	if (length < sizeof(EthernetHeader)) {
+		LOG_DEBUG("  Packet too short for Ethernet header");
+		return false;
+	}
+	const EthernetHeader* ethHeader = reinterpret_cast<const EthernetHeader*>(frame);
+	uint16_t etherType = ntohs(ethHeader->etherType);
+	LOG_DEBUG("  Ether Type: 0x" << std::hex << etherType << std::dec);
+
+	// Parse IP header
+	if (etherType != 0x0800 || length < sizeof(EthernetHeader) + sizeof(IPHeader)) {
+		LOG_DEBUG("  Not an IPv4 packet or too short for IP header");
+		return false;
+	}
+	const IPHeader* ipHeader = reinterpret_cast<const IPHeader*>(frame + sizeof(EthernetHeader));
+	uint8_t ipHeaderLength = (ipHeader->versionIHL & 0x0F) * 4;
+	char srcIP[INET_ADDRSTRLEN], destIP[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, &ipHeader->srcIP, srcIP, INET_ADDRSTRLEN);
+	inet_ntop(AF_INET, &ipHeader->destIP, destIP, INET_ADDRSTRLEN);
+	LOG_DEBUG("  IP: " << srcIP << " -> " << destIP);
+	LOG_DEBUG("  Protocol: " << static_cast<int>(ipHeader->protocol));
+
+	// Parse UDP header
+	if (ipHeader->protocol != 17 || length < sizeof(EthernetHeader) + ipHeaderLength + sizeof(UDPHeader)) {
+		LOG_INFO("  Not a UDP packet or too short for UDP header");
+		return false;
+	}
+	const UDPHeader* udpHeader = reinterpret_cast<const UDPHeader*>(frame + sizeof(EthernetHeader) + ipHeaderLength);
+	uint16_t srcPort [[maybe_unused]] = ntohs(udpHeader->srcPort);
+	uint16_t destPort = ntohs(udpHeader->destPort);
+	LOG_DEBUG("  UDP: " << srcPort << " -> " << destPort);
+
+	// Calculate offset to SIMBA data
+	size_t simbaOffset = sizeof(EthernetHeader) + ipHeaderLength + sizeof(UDPHeader);
+	size_t simbaLength = length - simbaOffset;
+
+	LOG_DEBUG("  SIMBA data offset: " << simbaOffset);
+	LOG_DEBUG("  SIMBA data length: " << simbaLength);
+
+	// Print first few bytes of the SIMBA data
+	//LOG_DEBUG("  First 32 bytes of SIMBA data: ");
+	//for (size_t i = 0; i < std::min(size_t(32), simbaLength); ++i) {
+	//    LOG_DEBUG(std::hex << std::setw(2) << std::setfill('0') 
+	//              << static_cast<int>(packetData[simbaOffset + i]) << " ");
+	//}
+	//LOG_DEBUG(std::dec);
+
+	packet.data = frame + simbaOffset;
+	packet.length = simbaLength;
+	packet.destIP = ntohl(ipHeader->destIP);
+	packet.destPort = destPort;
+	return true;
+}
+
+void PCAPParser::parsePackets(SimbaDecoder& decoder, const MessageHandler& handler) {
+	decodePackets(*this, decoder, handler);
+}
+
+void decodePackets(PacketSource& source, SimbaDecoder& decoder, const MessageHandler& handler) {
+	CapturedPacket packet;
 
+	while (source.nextPacket(packet)) {
 		// Try to decode SIMBA message
-		auto result = decoder.decodeMessage(packetData.data() + simbaOffset, simbaLength);
+		auto result = decoder.decodeMessage(packet.data, packet.length, packet.captureTime);
 		if (result) {
 			std::visit([](auto&& msg) {
 					using T = std::decay_t<decltype(msg)>;
@@ -107,12 +149,39 @@ void PCAPParser::parsePackets(SimbaDecoder& decoder) {
 					LOG_DEBUG("  Received OrderBookSnapshot");
 					}
 					}, *result);
+			if (handler) {
+				handler(*result);
+			}
 		} else {
 			LOG_DEBUG("  Failed to decode message");
 		}
 	}
 }    
 
+void decodePacketEvents(PacketSource& source, SimbaDecoder& decoder, const EventHandler& handler) {
+	CapturedPacket packet;
+	std::vector<DecodedEvent> events;
+
+	while (source.nextPacket(packet)) {
+		if (decoder.decodeEvents(packet.data, packet.length, packet.captureTime, events) && handler) {
+			handler(events);
+		}
+	}
+}
+
+bool PCAPParser::seek(uint64_t offset) {
+	if (offset < sizeof(PCAPFileHeader) || offset > fileSize) {
+		LOG_WARNING("Cannot seek to offset " << offset << ", file size is " << fileSize);
+		return false;
+	}
+	file.clear();
+	if (!file.seekg(static_cast<std::streamoff>(offset), std::ios::beg)) {
+		return false;
+	}
+	nextPacketOffset = offset;
+	return true;
+}
+
 void PCAPParser::readFileHeader() {
 	LOG_INFO("Attempting to read PCAP file header...");
 
@@ -130,13 +199,15 @@ void PCAPParser::readFileHeader() {
 	LOG_INFO("Network type: " << fileHeader.network);
 
 	// Choose the interpretation that looks more correct
-	if (fileHeader.magic_number == 0xa1b2c3d4 || fileHeader.magic_number == 0xa1b23c4d) {
+	if (fileHeader.magic_number == PCAP_MAGIC_MICROSECONDS || fileHeader.magic_number == PCAP_MAGIC_NANOSECONDS) {
 		is_valid = true;
+		nanosecondTimestamps = (fileHeader.magic_number == PCAP_MAGIC_NANOSECONDS);
 	} else {
         	LOG_ERROR("Invalid PCAP file format. Unrecognized magic number.");
         	return;			
 	}
 
+	nextPacketOffset = sizeof(PCAPFileHeader);
 	LOG_INFO("PCAP file header read successfully");
 }    
 
@@ -197,27 +268,3 @@ void PCAPParser::processPacket(const std::vector<unsigned char>& packet_data, Si
 		LOG_WARNING("Failed to decode message");
 	}
 }
-
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <pcap_file>" << std::endl;
-        return 1;
-    }
-
-    Logger::init_log("simba.log");
-
-    PCAPParser parser(argv[1]);
-    if (!parser.isValid()) {
-        LOG_ERROR("Failed to initialize PCAPParser");
-        Logger::close_log();
-        return 1;
-    }
-
-    SimbaDecoder decoder;
-    parser.parsePackets(decoder);
-
-    decoder.printStatistics();
-
-    Logger::close_log();
-    return 0;
-}
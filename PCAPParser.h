@@ -4,10 +4,15 @@
 #define PCAP_PARSER_H
 
 #include <fstream>
+#include <functional>
 #include <vector>
 
+#include "DecodedEvent.h"
+#include "Placement.h"
 #include "SimbaDecoder.h"
 
+class PerfCounters;
+
 // Structures for PCAP file headers
 struct PCAPFileHeader {
 	uint32_t magic_number;
@@ -56,18 +61,103 @@ struct UDPHeader {
 static constexpr uint16_t SIMBA_PORT = 44040; // Replace with the actual port
 static constexpr uint32_t SIMBA_MULTICAST_IP = 0xEFC31452; // 239.195.20.82 in network byte order
 
-class PCAPParser {
+static constexpr uint32_t PCAP_MAGIC_MICROSECONDS = 0xa1b2c3d4;
+static constexpr uint32_t PCAP_MAGIC_NANOSECONDS = 0xa1b23c4d;
+
+// SIMBA payload of one captured UDP packet; valid until the next call to nextPacket()
+struct CapturedPacket {
+	const uint8_t* data = nullptr;
+	size_t length = 0;
+	uint64_t captureTime = 0;   // ns since epoch
+	uint32_t destIP = 0;        // UDP destination, host byte order
+	uint16_t destPort = 0;
+};
+
+// Parses the Ethernet/IPv4/UDP headers of a captured frame and points packet at its
+// UDP payload; captureTime is left to the caller. Returns false for other frames.
+bool parseLinkLayer(const uint8_t* frame, size_t length, CapturedPacket& packet);
+
+// Capture timestamp in nanoseconds since epoch, honouring the file's timestamp resolution
+inline uint64_t pcapCaptureTimeNs(const PCAPPacketHeader& header, bool nanosecondTimestamps) noexcept {
+	uint64_t fraction = nanosecondTimestamps ? header.ts_usec : uint64_t{header.ts_usec} * 1000;
+	return uint64_t{header.ts_sec} * 1000000000 + fraction;
+}
+
+// Consumer of every successfully decoded message
+using MessageHandler = std::function<void(const DecodedMessage&)>;
+// Consumer of every event of each payload the decoder completes
+using EventHandler = std::function<void(const std::vector<DecodedEvent>&)>;
+
+// Anything that yields captured SIMBA payloads in capture order
+class PacketSource {
+	public:
+		virtual ~PacketSource() = default;
+
+		// Advances to the next UDP packet and exposes its SIMBA payload.
+		// Returns false at end of input or on a read error.
+		virtual bool nextPacket(CapturedPacket& packet) = 0;
+};
+
+// A single capture file: its read position can be checkpointed and restored
+class SeekablePacketSource : public PacketSource {
+	public:
+		virtual bool isValid() const = 0;
+
+		// Byte offset of the next packet record, and repositioning to such an offset
+		virtual uint64_t position() const = 0;
+		virtual bool seek(uint64_t offset) = 0;
+		virtual uint64_t getFileSize() const = 0;
+
+		// Optional hardware counters around the read and link-layer parse; must outlive the source
+		virtual void setPerfCounters(PerfCounters* counters) noexcept = 0;
+};
+
+// Decodes every packet of source and passes each decoded message to handler
+void decodePackets(PacketSource& source, SimbaDecoder& decoder, const MessageHandler& handler = {});
+// Same, passing handler all events of each payload, including both templates of a mixed packet
+void decodePacketEvents(PacketSource& source, SimbaDecoder& decoder, const EventHandler& handler = {});
+
+class PCAPParser : public SeekablePacketSource {
 	public:
 		PCAPParser(const std::string& filename);
-		void parsePackets(SimbaDecoder& decoder);
-		bool isValid() const { return is_valid; }
+		void parsePackets(SimbaDecoder& decoder, const MessageHandler& handler = {});
+		bool isValid() const override { return is_valid; }
+
+		bool nextPacket(CapturedPacket& packet) override;
+
+		void setPerfCounters(PerfCounters* counters) noexcept override { perfCounters = counters; }
+
+		uint64_t position() const override { return nextPacketOffset; }
+		bool seek(uint64_t offset) override;
+		uint64_t getFileSize() const override { return fileSize; }
+
+		// Raw pcap record of the packet returned last by nextPacket() (header fields in host order)
+		const PCAPFileHeader& getFileHeader() const { return fileHeader; }
+		const PCAPPacketHeader& recordHeader() const { return packetHeader; }
+		const std::vector<uint8_t>& recordFrame() const { return packetData; }
 	private:
 		void readFileHeader();
 		void processPacket(const std::vector<unsigned char>& packet_data, SimbaDecoder& decoder);
 
+		uint64_t captureTimeNs(const PCAPPacketHeader& header) const noexcept {
+			return pcapCaptureTimeNs(header, nanosecondTimestamps);
+		}
+
+		// Stream buffer of the capture file; declared first so it outlives the stream
+		static constexpr size_t READ_BUFFER_SIZE = 4 * 1024 * 1024;
+		HugePageBuffer readBuffer;
 		std::ifstream file;
 		PCAPFileHeader fileHeader;
 		bool is_valid = false;
+		bool nanosecondTimestamps = false;
+		uint64_t fileSize = 0;
+		uint64_t nextPacketOffset = 0;
+
+		PCAPPacketHeader packetHeader;
+		std::vector<uint8_t> packetData;
+		int packetCount = 0;
+
+		PerfCounters* perfCounters = nullptr;
 };
 
 #endif // PCAP_PARSER_H
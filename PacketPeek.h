@@ -0,0 +1,142 @@
+// PacketPeek.h
+
+#ifndef PACKET_PEEK_H
+#define PACKET_PEEK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+
+// Fields of a raw SIMBA packet read at their fixed offsets without decoding
+// it: the packet flags and MsgSeqNum, the TransactTime of an incremental
+// packet, the LastMsgSeqNumProcessed of a snapshot and the SecurityID of
+// every SBE message. Lets tools pick out the packets of a few
+// instruments far faster than a full decode would.
+class PacketPeek {
+	public:
+		static constexpr size_t MARKET_DATA_HEADER_SIZE = 16;
+		static constexpr size_t INCREMENTAL_HEADER_SIZE = 12;
+		static constexpr size_t SBE_HEADER_SIZE = 8;
+		static constexpr size_t GROUP_HEADER_SIZE = 3;        // blockLength (uint16), numInGroup (uint8)
+
+		static constexpr uint16_t FLAG_START_OF_SNAPSHOT = 0x2;
+		static constexpr uint16_t FLAG_END_OF_SNAPSHOT = 0x4;
+		static constexpr uint16_t FLAG_INCREMENTAL = 0x8;
+
+		static constexpr uint16_t TEMPLATE_ID_ORDER_UPDATE = 15;
+		static constexpr uint16_t TEMPLATE_ID_ORDER_EXECUTION = 16;
+		static constexpr uint16_t TEMPLATE_ID_ORDER_BOOK_SNAPSHOT = 17;
+
+		// Offset of SecurityID within the message block
+		static constexpr size_t ORDER_UPDATE_SECURITY_ID_OFFSET = 40;
+		static constexpr size_t ORDER_EXECUTION_SECURITY_ID_OFFSET = 64;
+		static constexpr size_t SNAPSHOT_SECURITY_ID_OFFSET = 0;
+		static constexpr size_t SNAPSHOT_LAST_MSG_SEQ_NUM_PROCESSED_OFFSET = 4;
+		static constexpr size_t SNAPSHOT_ROOT_BLOCK_SIZE = 16;
+
+		// MsgFlags of the packet and, for incremental packets, TransactTime (0 otherwise).
+		// False if the packet is too short for its headers.
+		static bool header(const uint8_t* data, size_t length, uint16_t& msgFlags, uint64_t& transactTime) noexcept {
+			if (length < MARKET_DATA_HEADER_SIZE) {
+				return false;
+			}
+			msgFlags = readUInt16(data + 6);
+			transactTime = 0;
+			if (msgFlags & FLAG_INCREMENTAL) {
+				if (length < MARKET_DATA_HEADER_SIZE + INCREMENTAL_HEADER_SIZE) {
+					return false;
+				}
+				uint64_t value;
+				std::memcpy(&value, data + MARKET_DATA_HEADER_SIZE, sizeof(value));
+				transactTime = le64toh(value);
+			}
+			return true;
+		}
+
+		// MsgSeqNum of a packet that header() accepted
+		static uint32_t msgSeqNum(const uint8_t* data) noexcept {
+			return readUInt32(data);
+		}
+
+		// LastMsgSeqNumProcessed of the OrderBookSnapshot leading a snapshot packet: the last
+		// incremental packet the image includes. False if the packet does not start with one.
+		static bool snapshotLastMsgSeqNumProcessed(const uint8_t* data, size_t length, uint32_t& msgSeqNum) noexcept {
+			size_t block = MARKET_DATA_HEADER_SIZE + SBE_HEADER_SIZE;
+			if (length < block + SNAPSHOT_ROOT_BLOCK_SIZE || (readUInt16(data + 6) & FLAG_INCREMENTAL)
+					|| readUInt16(data + MARKET_DATA_HEADER_SIZE + 2) != TEMPLATE_ID_ORDER_BOOK_SNAPSHOT) {
+				return false;
+			}
+			msgSeqNum = readUInt32(data + block + SNAPSHOT_LAST_MSG_SEQ_NUM_PROCESSED_OFFSET);
+			return true;
+		}
+
+		// Calls fn(int32_t securityId, uint16_t templateId) for the SBE messages of a packet in
+		// order, until fn returns false or a template of unknown size is reached. Returns
+		// whether any message was seen.
+		template<typename Fn>
+		static bool forEachSecurityId(const uint8_t* data, size_t length, Fn&& fn) noexcept {
+			if (length < MARKET_DATA_HEADER_SIZE) {
+				return false;
+			}
+			uint16_t msgFlags = readUInt16(data + 6);
+			size_t offset = MARKET_DATA_HEADER_SIZE;
+			if (msgFlags & FLAG_INCREMENTAL) {
+				offset += INCREMENTAL_HEADER_SIZE;
+			}
+
+			bool anyMessage = false;
+			while (offset + SBE_HEADER_SIZE <= length) {
+				uint16_t blockLength = readUInt16(data + offset);
+				uint16_t templateId = readUInt16(data + offset + 2);
+				const uint8_t* block = data + offset + SBE_HEADER_SIZE;
+				size_t available = length - offset - SBE_HEADER_SIZE;
+				size_t messageSize = SBE_HEADER_SIZE + blockLength;
+
+				size_t securityIdOffset;
+				switch (templateId) {
+					case TEMPLATE_ID_ORDER_UPDATE: securityIdOffset = ORDER_UPDATE_SECURITY_ID_OFFSET; break;
+					case TEMPLATE_ID_ORDER_EXECUTION: securityIdOffset = ORDER_EXECUTION_SECURITY_ID_OFFSET; break;
+					case TEMPLATE_ID_ORDER_BOOK_SNAPSHOT:
+						securityIdOffset = SNAPSHOT_SECURITY_ID_OFFSET;
+						// Root block, then the entry group
+						if (available < SNAPSHOT_ROOT_BLOCK_SIZE + GROUP_HEADER_SIZE) {
+							return anyMessage;
+						}
+						messageSize = SBE_HEADER_SIZE + SNAPSHOT_ROOT_BLOCK_SIZE + GROUP_HEADER_SIZE
+							+ static_cast<size_t>(readUInt16(block + SNAPSHOT_ROOT_BLOCK_SIZE)) * block[SNAPSHOT_ROOT_BLOCK_SIZE + 2];
+						break;
+					default:
+						// Without the schema of other templates their size is unknown past the root block
+						return anyMessage;
+				}
+				if (available < securityIdOffset + sizeof(int32_t)) {
+					return anyMessage;
+				}
+
+				uint32_t securityId;
+				std::memcpy(&securityId, block + securityIdOffset, sizeof(securityId));
+				anyMessage = true;
+				if (!fn(static_cast<int32_t>(le32toh(securityId)), templateId)) {
+					return true;
+				}
+				offset += messageSize;
+			}
+			return anyMessage;
+		}
+
+	private:
+		static uint16_t readUInt16(const uint8_t* data) noexcept {
+			uint16_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return le16toh(value);
+		}
+
+		static uint32_t readUInt32(const uint8_t* data) noexcept {
+			uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return le32toh(value);
+		}
+};
+
+#endif // PACKET_PEEK_H
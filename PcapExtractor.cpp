@@ -0,0 +1,248 @@
+#include "PcapExtractor.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+
+#include "PacketPeek.h"
+#include "log.h"
+
+bool ExtractFilter::parseTime(const std::string& text, uint64_t& ns) {
+	size_t dot = text.find('.');
+	std::string seconds = text.substr(0, dot);
+	std::string fraction = dot == std::string::npos ? std::string() : text.substr(dot + 1);
+	if (seconds.empty() || seconds.find_first_not_of("0123456789") != std::string::npos
+			|| fraction.size() > 9 || fraction.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+	fraction.resize(9, '0');
+	ns = std::stoull(seconds) * 1000000000 + std::stoull(fraction);
+	return true;
+}
+
+bool ExtractFilter::parseChannel(const std::string& text, ExtractChannel& channel) {
+	size_t colon = text.find(':');
+	std::string address = text.substr(0, colon);
+	if (!address.empty()) {
+		in_addr parsed;
+		if (inet_pton(AF_INET, address.c_str(), &parsed) != 1) {
+			return false;
+		}
+		channel.ip = ntohl(parsed.s_addr);
+	}
+	if (colon != std::string::npos) {
+		try {
+			unsigned long port = std::stoul(text.substr(colon + 1));
+			if (port == 0 || port > UINT16_MAX) {
+				return false;
+			}
+			channel.port = static_cast<uint16_t>(port);
+		} catch (const std::exception&) {
+			return false;
+		}
+	}
+	return channel.ip != 0 || channel.port != 0;
+}
+
+PcapExtractor::PcapExtractor(const ExtractFilter& filter) : filter(filter) {
+	for (int32_t securityId : filter.securityIds) {
+		selection.assign(securityId);
+	}
+}
+
+bool PcapExtractor::channelSelected(const CapturedPacket& packet) const noexcept {
+	if (filter.channels.empty()) {
+		return true;
+	}
+	for (const ExtractChannel& channel : filter.channels) {
+		if ((channel.ip == 0 || channel.ip == packet.destIP) && (channel.port == 0 || channel.port == packet.destPort)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PcapExtractor::instrumentSelected(int32_t securityId) const noexcept {
+	return filter.securityIds.empty() || selection.find(securityId) != InstrumentIndex::NOT_FOUND;
+}
+
+bool PcapExtractor::inspect(const CapturedPacket& packet, PacketInstruments& result) const noexcept {
+	uint16_t msgFlags;
+	uint64_t transactTime;
+	if (!PacketPeek::header(packet.data, packet.length, msgFlags, transactTime)) {
+		return false;
+	}
+
+	result.isIncremental = (msgFlags & PacketPeek::FLAG_INCREMENTAL) != 0;
+	bool first = true;
+	return PacketPeek::forEachSecurityId(packet.data, packet.length, [&](int32_t securityId, uint16_t templateId) {
+			if (first && templateId == PacketPeek::TEMPLATE_ID_ORDER_BOOK_SNAPSHOT && !(msgFlags & PacketPeek::FLAG_INCREMENTAL)) {
+				result.isSnapshot = true;
+				result.startOfSnapshot = (msgFlags & PacketPeek::FLAG_START_OF_SNAPSHOT) != 0;
+				result.endOfSnapshot = (msgFlags & PacketPeek::FLAG_END_OF_SNAPSHOT) != 0;
+				result.snapshotSecurityId = securityId;
+			}
+			first = false;
+			if (instrumentSelected(securityId)) {
+				result.selected = true;
+				// The rest cannot change the outcome
+				return result.isSnapshot;
+			}
+			return true;
+		});
+}
+
+void PcapExtractor::recordSeed(int32_t securityId, const PacketInstruments& instruments,
+		const PCAPPacketHeader& header, const std::vector<uint8_t>& frame, const CapturedPacket& packet) {
+	uint32_t index = seedIndex.assign(securityId);
+	if (index == seeds.size()) {
+		seeds.emplace_back();
+	}
+	SeedCycle& cycle = seeds[index];
+
+	if (instruments.startOfSnapshot) {
+		cycle.building.clear();
+		cycle.buildingPackets = 0;
+		cycle.buildingLastMsgSeqNum = 0;
+		PacketPeek::snapshotLastMsgSeqNumProcessed(packet.data, packet.length, cycle.buildingLastMsgSeqNum);
+	} else if (cycle.buildingPackets == 0) {
+		return;   // Joined in the middle of a cycle
+	}
+
+	const auto* headerBytes = reinterpret_cast<const uint8_t*>(&header);
+	cycle.building.insert(cycle.building.end(), headerBytes, headerBytes + sizeof(header));
+	cycle.building.insert(cycle.building.end(), frame.begin(), frame.begin() + header.incl_len);
+	cycle.buildingPackets++;
+
+	if (instruments.endOfSnapshot) {
+		if (cycle.completePackets == 0 || cycle.completeLastMsgSeqNum != cycle.buildingLastMsgSeqNum) {
+			images.emplace(cycle.buildingLastMsgSeqNum, index);
+		}
+		std::swap(cycle.building, cycle.complete);
+		cycle.completePackets = cycle.buildingPackets;
+		cycle.completeLastMsgSeqNum = cycle.buildingLastMsgSeqNum;
+		cycle.building.clear();
+		cycle.buildingPackets = 0;
+		trimSeedUpdates();
+	}
+}
+
+void PcapExtractor::recordSeedUpdate(const PCAPPacketHeader& header, const std::vector<uint8_t>& frame,
+		const CapturedPacket& packet) {
+	SeedUpdate& update = seedUpdates.emplace_back();
+	update.msgSeqNum = PacketPeek::msgSeqNum(packet.data);
+	const auto* headerBytes = reinterpret_cast<const uint8_t*>(&header);
+	update.record.reserve(sizeof(header) + header.incl_len);
+	update.record.insert(update.record.end(), headerBytes, headerBytes + sizeof(header));
+	update.record.insert(update.record.end(), frame.begin(), frame.begin() + header.incl_len);
+	seedUpdateBytes += update.record.size();
+
+	while (seedUpdateBytes > MAX_SEED_UPDATE_BYTES && !seedUpdates.empty()) {
+		// The oldest image pins the updates; without one, trimming drops them all
+		if (oldestImage() != UINT32_MAX) {
+			uint32_t index = images.top().second;
+			SeedCycle& cycle = seeds[index];
+			LOG_WARNING("Snapshot of SecurityID " << seedIndex.securityIdAt(index) << " at MsgSeqNum "
+					<< cycle.completeLastMsgSeqNum << " is older than " << (MAX_SEED_UPDATE_BYTES >> 20)
+					<< " MB of updates, not seeded unless a newer cycle completes");
+			cycle.complete.clear();
+			cycle.complete.shrink_to_fit();
+			cycle.completePackets = 0;
+			stats.seedCyclesDropped++;
+		}
+		trimSeedUpdates();
+	}
+}
+
+uint32_t PcapExtractor::oldestImage() {
+	while (!images.empty()) {
+		auto [lastMsgSeqNum, index] = images.top();
+		const SeedCycle& cycle = seeds[index];
+		if (cycle.completePackets != 0 && cycle.completeLastMsgSeqNum == lastMsgSeqNum) {
+			return lastMsgSeqNum;
+		}
+		images.pop();
+	}
+	return UINT32_MAX;
+}
+
+void PcapExtractor::trimSeedUpdates() {
+	// Images completed later are taken later, so they include at least as much
+	uint32_t included = oldestImage();
+	while (!seedUpdates.empty() && seedUpdates.front().msgSeqNum <= included) {
+		seedUpdateBytes -= seedUpdates.front().record.size();
+		seedUpdates.pop_front();
+	}
+}
+
+void PcapExtractor::writeSeeds(PcapWriter& output) {
+	for (SeedCycle& cycle : seeds) {
+		if (cycle.completePackets == 0) {
+			continue;
+		}
+		for (size_t offset = 0; offset < cycle.complete.size();) {
+			PCAPPacketHeader header;
+			std::memcpy(&header, cycle.complete.data() + offset, sizeof(header));
+			offset += sizeof(header);
+			output.write(header, cycle.complete.data() + offset);
+			offset += header.incl_len;
+		}
+		stats.seedPackets += cycle.completePackets;
+		stats.seedCycles++;
+	}
+	seeds.clear();
+	seeds.shrink_to_fit();
+
+	// In capture order, after every image: the books skip what an image already holds
+	for (const SeedUpdate& update : seedUpdates) {
+		PCAPPacketHeader header;
+		std::memcpy(&header, update.record.data(), sizeof(header));
+		output.write(header, update.record.data() + sizeof(header));
+	}
+	stats.seedUpdatePackets = seedUpdates.size();
+	seedUpdates.clear();
+	seedUpdates.shrink_to_fit();
+	seedUpdateBytes = 0;
+	images = {};
+}
+
+bool PcapExtractor::run(PCAPParser& input, PcapWriter& output) {
+	// Nothing precedes the window if it starts with the capture
+	bool seeding = filter.seedSnapshots && filter.fromNs > 0;
+
+	CapturedPacket packet;
+	while (input.nextPacket(packet)) {
+		stats.packetsRead++;
+		if (packet.captureTime > filter.toNs) {
+			break;
+		}
+		if (!channelSelected(packet)) {
+			continue;
+		}
+
+		PacketInstruments instruments;
+		bool hasInstrument = inspect(packet, instruments);
+		bool selected = hasInstrument ? instruments.selected : filter.securityIds.empty();
+
+		if (packet.captureTime < filter.fromNs) {
+			if (seeding && instruments.isSnapshot && instrumentSelected(instruments.snapshotSecurityId)) {
+				recordSeed(instruments.snapshotSecurityId, instruments, input.recordHeader(), input.recordFrame(), packet);
+			} else if (seeding && instruments.isIncremental && selected && !seeds.empty()) {
+				recordSeedUpdate(input.recordHeader(), input.recordFrame(), packet);
+			}
+			continue;
+		}
+		if (seeding) {
+			writeSeeds(output);
+			seeding = false;
+		}
+		if (selected) {
+			output.write(input.recordHeader(), input.recordFrame().data());
+		}
+	}
+	if (seeding) {
+		LOG_WARNING("The capture ends before the start of the window, no packets extracted");
+	}
+
+	stats.packetsWritten = output.getPacketsWritten();
+	return output.close();
+}
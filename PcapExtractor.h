@@ -0,0 +1,123 @@
+// PcapExtractor.h
+
+#ifndef PCAP_EXTRACTOR_H
+#define PCAP_EXTRACTOR_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "InstrumentIndex.h"
+#include "PCAPParser.h"
+#include "PcapWriter.h"
+
+// UDP destination of a feed; 0 matches any address or port
+struct ExtractChannel {
+	uint32_t ip = 0;      // Host byte order
+	uint16_t port = 0;
+};
+
+struct ExtractFilter {
+	std::vector<int32_t> securityIds;       // Empty: every instrument
+	uint64_t fromNs = 0;                    // Capture time window, ns since epoch
+	uint64_t toNs = UINT64_MAX;
+	std::vector<ExtractChannel> channels;   // Empty: every channel
+	bool seedSnapshots = true;              // Prepend the last snapshot cycle before fromNs
+
+	// "1700000000", "1700000000.25" (seconds since epoch)
+	static bool parseTime(const std::string& text, uint64_t& ns);
+	// "239.195.20.82:44040", "239.195.20.82" or ":44040"
+	static bool parseChannel(const std::string& text, ExtractChannel& channel);
+};
+
+struct ExtractStats {
+	uint64_t packetsRead = 0;
+	uint64_t packetsWritten = 0;
+	uint64_t seedPackets = 0;               // Snapshot packets written ahead of the window
+	uint64_t seedCycles = 0;
+	uint64_t seedUpdatePackets = 0;         // Incremental packets between the seeds and the window
+	uint64_t seedCyclesDropped = 0;         // Images too old to keep the updates after them
+};
+
+// Copies the packets of a capture that match an ExtractFilter into a new pcap.
+// The SecurityID of every SBE message is read at its fixed offset in the
+// message block, without decoding it; a packet is kept if any of its messages
+// belongs to a selected instrument. When the window starts after the
+// beginning of the capture, the last complete snapshot cycle of each selected
+// instrument seen before it is written first, followed by the selected
+// incremental packets after the oldest of those images (by its
+// LastMsgSeqNumProcessed), so a decoder replaying the output holds the
+// current books when the window starts. Updates an image already includes
+// are dropped by the books on their RptSeq. The updates kept are bounded by
+// MAX_SEED_UPDATE_BYTES: past it the oldest image, e.g. of an instrument
+// whose snapshots stopped, is dropped with a warning instead.
+// The capture is assumed to be in time order: reading stops at the first
+// packet past toNs.
+class PcapExtractor {
+	public:
+		static constexpr size_t MAX_SEED_UPDATE_BYTES = size_t{512} << 20;
+
+		explicit PcapExtractor(const ExtractFilter& filter);
+
+		bool run(PCAPParser& input, PcapWriter& output);
+
+		[[nodiscard]] const ExtractStats& getStats() const noexcept { return stats; }
+
+	private:
+		// SecurityIDs of a packet's messages, read from the SBE blocks
+		struct PacketInstruments {
+			bool isSnapshot = false;
+			bool isIncremental = false;
+			bool startOfSnapshot = false;
+			bool endOfSnapshot = false;
+			bool selected = false;          // Any message of a selected instrument
+			int32_t snapshotSecurityId = 0;
+		};
+
+		// Snapshot packets of one instrument, as serialized pcap records
+		struct SeedCycle {
+			std::vector<uint8_t> building;
+			std::vector<uint8_t> complete;
+			uint32_t buildingPackets = 0;
+			uint32_t completePackets = 0;
+			uint32_t buildingLastMsgSeqNum = 0;   // LastMsgSeqNumProcessed of the image
+			uint32_t completeLastMsgSeqNum = 0;
+		};
+
+		// Selected incremental packet before the window, as a serialized pcap record
+		struct SeedUpdate {
+			uint32_t msgSeqNum;
+			std::vector<uint8_t> record;
+		};
+
+		bool channelSelected(const CapturedPacket& packet) const noexcept;
+		bool instrumentSelected(int32_t securityId) const noexcept;
+		bool inspect(const CapturedPacket& packet, PacketInstruments& result) const noexcept;
+
+		void recordSeed(int32_t securityId, const PacketInstruments& instruments,
+				const PCAPPacketHeader& header, const std::vector<uint8_t>& frame, const CapturedPacket& packet);
+		void recordSeedUpdate(const PCAPPacketHeader& header, const std::vector<uint8_t>& frame, const CapturedPacket& packet);
+		// LastMsgSeqNumProcessed of the oldest complete image, UINT32_MAX if there is none
+		uint32_t oldestImage();
+		// Drops the updates every complete image already includes
+		void trimSeedUpdates();
+		void writeSeeds(PcapWriter& output);
+
+		ExtractFilter filter;
+		InstrumentIndex selection;
+		InstrumentIndex seedIndex;
+		std::vector<SeedCycle> seeds;
+		std::deque<SeedUpdate> seedUpdates;
+		size_t seedUpdateBytes = 0;
+		// (LastMsgSeqNumProcessed, seed index) of complete images, smallest first. An entry is
+		// pushed when an image's value changes and the stale ones are popped when they surface.
+		using ImageEntry = std::pair<uint32_t, uint32_t>;
+		std::priority_queue<ImageEntry, std::vector<ImageEntry>, std::greater<ImageEntry>> images;
+		ExtractStats stats;
+};
+
+#endif // PCAP_EXTRACTOR_H
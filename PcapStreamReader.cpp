@@ -0,0 +1,280 @@
+#include "PcapStreamReader.h"
+#include <cerrno>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+
+PcapStreamReader::PcapStreamReader(const std::string& path)
+	: storage(2 * (MAX_RECORD_SIZE + BUFFER_SIZE), "pcap stream buffers") {
+	if (!storage.data()) {
+		return;
+	}
+	for (size_t i = 0; i < 2; ++i) {
+		buffers[i].data = static_cast<uint8_t*>(storage.data()) + i * (MAX_RECORD_SIZE + BUFFER_SIZE) + MAX_RECORD_SIZE;
+	}
+
+	if (path == "-") {
+		fd = STDIN_FILENO;
+	} else {
+		fd = ::open(path.c_str(), O_RDONLY);
+		ownsFd = true;
+	}
+	if (fd < 0) {
+		LOG_ERROR("Cannot open stream " << path << ": " << std::strerror(errno));
+		return;
+	}
+	wakeFd = eventfd(0, EFD_CLOEXEC);
+	if (wakeFd < 0) {
+		LOG_ERROR("Cannot create eventfd: " << std::strerror(errno));
+		return;
+	}
+	decompressor = std::make_unique<Decompressor>(fd);
+	if (!decompressor->open()) {
+		LOG_ERROR("Cannot read " << path << ": " << decompressor->getError());
+		return;
+	}
+	LOG_INFO("Reading " << Decompressor::formatName(decompressor->getFormat()) << " pcap stream from "
+			<< (path == "-" ? "standard input" : path));
+
+	// The consumer starts on buffer 1, so its first advance waits for buffer 0
+	current = 1;
+	readerThread = std::thread(&PcapStreamReader::readLoop, this);
+	Placement::pinThread(readerThread, ThreadRole::Prefetch);
+	readFileHeader();
+}
+
+PcapStreamReader::~PcapStreamReader() {
+	if (readerThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		changed.notify_all();
+		uint64_t wake = 1;
+		[[maybe_unused]] ssize_t n = ::write(wakeFd, &wake, sizeof(wake));
+		readerThread.join();
+	}
+	if (wakeFd >= 0) {
+		::close(wakeFd);
+	}
+	if (ownsFd && fd >= 0) {
+		::close(fd);
+	}
+}
+
+bool PcapStreamReader::isStream(const std::string& path) {
+	struct stat info;
+	return path == "-" || (::stat(path.c_str(), &info) == 0 && !S_ISREG(info.st_mode));
+}
+
+bool PcapStreamReader::needsStreaming(const std::string& path) {
+	return isStream(path) || Decompressor::detectFile(path) != Decompressor::Format::None;
+}
+
+void PcapStreamReader::readLoop() {
+	// Never logs: the logger belongs to the consumer thread
+	for (size_t index = 0; ; index ^= 1) {
+		Buffer& buffer = buffers[index];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return stopping || !buffer.ready; });
+			if (stopping) {
+				return;
+			}
+		}
+
+		size_t filled = 0;
+		std::string error;
+		bool eof = false;
+		while (filled < BUFFER_SIZE) {
+			if (!decompressor->hasPendingInput()) {
+				// Block for the first bytes; after that hand the buffer over as soon as the input is drained
+				pollfd fds[2] = {{fd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+				int ready = poll(fds, 2, filled > 0 ? 0 : -1);
+				if (ready < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					error = std::strerror(errno);
+					break;
+				}
+				if (fds[1].revents) {
+					return;
+				}
+				if (ready == 0) {
+					break;
+				}
+			}
+			ssize_t n = decompressor->read(buffer.data + filled, BUFFER_SIZE - filled);
+			if (n < 0) {
+				error = decompressor->getError();
+				break;
+			}
+			filled += static_cast<size_t>(n);
+			if (decompressor->atEnd()) {
+				eof = true;
+				break;
+			}
+		}
+
+		bool last = eof || !error.empty();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			buffer.filled = filled;
+			buffer.ready = true;
+			if (last) {
+				endOfStream = true;
+				readError = std::move(error);
+			}
+		}
+		changed.notify_all();
+		if (last) {
+			return;
+		}
+	}
+}
+
+bool PcapStreamReader::advanceBuffer() {
+	size_t remainder = static_cast<size_t>(end - cursor);
+	Buffer& next = buffers[current ^ 1];
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return next.ready || endOfStream; });
+		if (!next.ready) {
+			if (!readError.empty()) {
+				LOG_ERROR("Reading the pcap stream failed: " << readError);
+			} else if (remainder > 0) {
+				LOG_WARNING("The pcap stream ends inside a record, " << remainder << " bytes dropped");
+			}
+			return false;
+		}
+	}
+
+	// The partial record moves into the carry room right in front of the next buffer's data
+	std::memcpy(next.data - remainder, cursor, remainder);
+	cursor = next.data - remainder;
+	end = next.data + next.filled;
+
+	if (holdingBuffer) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			buffers[current].ready = false;
+		}
+		changed.notify_all();
+	}
+	holdingBuffer = true;
+	current ^= 1;
+	return true;
+}
+
+void PcapStreamReader::readFileHeader() {
+	while (static_cast<size_t>(end - cursor) < sizeof(PCAPFileHeader)) {
+		if (!advanceBuffer()) {
+			LOG_ERROR("The pcap stream ends before its file header");
+			return;
+		}
+	}
+
+	// A pcapng section header is read as the stream's first block
+	if (PcapngSection::isPcapng(cursor, static_cast<size_t>(end - cursor))) {
+		LOG_INFO("Pcapng stream");
+		pcapng = true;
+		is_valid = true;
+		return;
+	}
+
+	PCAPFileHeader fileHeader;
+	std::memcpy(&fileHeader, cursor, sizeof(fileHeader));
+	cursor += sizeof(fileHeader);
+	uint32_t magic = le32toh(fileHeader.magic_number);
+	if (magic != PCAP_MAGIC_MICROSECONDS && magic != PCAP_MAGIC_NANOSECONDS) {
+		LOG_ERROR("Invalid pcap stream. Unrecognized magic number 0x" << std::hex << magic << std::dec);
+		return;
+	}
+	nanosecondTimestamps = (magic == PCAP_MAGIC_NANOSECONDS);
+	LOG_INFO("Pcap stream header: network type " << le32toh(fileHeader.network)
+			<< ", " << (nanosecondTimestamps ? "nanosecond" : "microsecond") << " timestamps");
+	is_valid = true;
+}
+
+bool PcapStreamReader::nextPacket(CapturedPacket& packet) {
+	if (!is_valid) {
+		return false;
+	}
+	if (pcapng) {
+		return nextPcapngPacket(packet);
+	}
+	for (;;) {
+		size_t available = static_cast<size_t>(end - cursor);
+		if (available >= sizeof(PCAPPacketHeader)) {
+			PCAPPacketHeader header;
+			std::memcpy(&header, cursor, sizeof(header));
+			header.ts_sec = le32toh(header.ts_sec);
+			header.ts_usec = le32toh(header.ts_usec);
+			header.incl_len = le32toh(header.incl_len);
+			header.orig_len = le32toh(header.orig_len);
+			if (header.incl_len > MAX_RECORD_SIZE - sizeof(header)) {
+				LOG_ERROR("Pcap record " << packetCount + 1 << " claims " << header.incl_len << " bytes, stream is corrupt");
+				is_valid = false;
+				return false;
+			}
+
+			size_t recordSize = sizeof(header) + header.incl_len;
+			if (available >= recordSize) {
+				const uint8_t* frame = cursor + sizeof(header);
+				cursor += recordSize;
+				++packetCount;
+				if (parseLinkLayer(frame, header.incl_len, packet)) {
+					packet.captureTime = pcapCaptureTimeNs(header, nanosecondTimestamps);
+					return true;
+				}
+				continue;
+			}
+		}
+		if (!advanceBuffer()) {
+			return false;
+		}
+	}
+}
+
+bool PcapStreamReader::nextPcapngPacket(CapturedPacket& packet) {
+	for (;;) {
+		size_t available = static_cast<size_t>(end - cursor);
+		if (available >= PcapngSection::BLOCK_PEEK_SIZE) {
+			uint32_t type;
+			uint32_t length;
+			if (!section.peekBlock(cursor, type, length) || length > MAX_RECORD_SIZE) {
+				LOG_ERROR("Malformed pcapng block " << packetCount + 1 << ", stream is corrupt");
+				is_valid = false;
+				return false;
+			}
+
+			if (available >= length) {
+				const uint8_t* block = cursor;
+				cursor += length;
+				++packetCount;
+				PcapngPacket frame;
+				PcapngSection::BlockResult result = section.processBlock(block, type, length, frame);
+				if (result == PcapngSection::BlockResult::Invalid) {
+					LOG_ERROR("Invalid pcapng block " << packetCount << ": " << section.getError());
+					is_valid = false;
+					return false;
+				}
+				if (result == PcapngSection::BlockResult::Packet && parseLinkLayer(frame.frame, frame.capturedLength, packet)) {
+					packet.captureTime = frame.captureTime;
+					return true;
+				}
+				continue;
+			}
+		}
+		if (!advanceBuffer()) {
+			return false;
+		}
+	}
+}
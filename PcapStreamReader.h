@@ -0,0 +1,85 @@
+// PcapStreamReader.h
+
+#ifndef PCAP_STREAM_READER_H
+#define PCAP_STREAM_READER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Decompressor.h"
+#include "PCAPParser.h"
+#include "PcapngSection.h"
+#include "Placement.h"
+
+// Reads a pcap or pcapng stream that cannot seek: standard input ("-"), a FIFO or any
+// other non-regular file, e.g. `tcpdump -w - | simba_decoder -`, and gzip or
+// zstd compressed captures (.pcap.gz, .pcap.zst), which are decompressed on
+// the fly instead of being unpacked to disk first.
+// A reader thread fills two large buffers in turn with read(2), decompressing
+// if needed, while the decoder parses records in place from the other one.
+// Each buffer is preceded by room for one record: the few bytes of a record
+// that straddles the end of a buffer are copied in front of the next one, so
+// packets are never copied otherwise and no buffer is ever resized.
+class PcapStreamReader : public PacketSource {
+	public:
+		static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+		// Largest snaplen plus a pcap record header, or pcapng block framing and options
+		static constexpr size_t MAX_RECORD_SIZE = 262144 + 4096;
+
+		explicit PcapStreamReader(const std::string& path);
+		~PcapStreamReader();
+
+		PcapStreamReader(const PcapStreamReader&) = delete;
+		PcapStreamReader& operator=(const PcapStreamReader&) = delete;
+
+		bool isValid() const { return is_valid; }
+
+		bool nextPacket(CapturedPacket& packet) override;
+
+		// True for "-" and for paths that are not regular files (FIFOs, character devices, sockets)
+		static bool isStream(const std::string& path);
+		// True for streams and for compressed files
+		static bool needsStreaming(const std::string& path);
+
+	private:
+		struct Buffer {
+			uint8_t* data = nullptr;     // BUFFER_SIZE bytes, preceded by MAX_RECORD_SIZE bytes of carry room
+			size_t filled = 0;
+			bool ready = false;          // Filled by the reader, not yet released by the consumer
+		};
+
+		void readLoop();
+		// Releases the current buffer and waits for the next, carrying over a partial record
+		bool advanceBuffer();
+		void readFileHeader();
+		bool nextPcapngPacket(CapturedPacket& packet);
+
+		int fd = -1;
+		bool ownsFd = false;
+		int wakeFd = -1;                 // eventfd that interrupts a blocking read on shutdown
+		std::unique_ptr<Decompressor> decompressor;
+		bool is_valid = false;
+		bool nanosecondTimestamps = false;
+		bool pcapng = false;
+		PcapngSection section;
+
+		HugePageBuffer storage;
+		Buffer buffers[2];
+		size_t current = 0;
+		bool holdingBuffer = false;      // buffers[current] is filled and being parsed
+		const uint8_t* cursor = nullptr;
+		const uint8_t* end = nullptr;
+		uint64_t packetCount = 0;       // Records, or blocks of a pcapng stream
+
+		std::thread readerThread;
+		std::mutex mutex;
+		std::condition_variable changed;
+		bool endOfStream = false;        // Set by the reader after the last buffer
+		std::string readError;           // Of a failed read, logged by the consumer
+		bool stopping = false;
+};
+
+#endif // PCAP_STREAM_READER_H
@@ -0,0 +1,88 @@
+#include "PcapWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "log.h"
+
+PcapWriter::PcapWriter(const std::string& filename, const PCAPFileHeader& fileHeader)
+	: filename(filename), buffer(WRITE_BUFFER_SIZE, "pcap write buffer") {
+	if (!buffer.data()) {
+		return;
+	}
+	fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		LOG_ERROR("Cannot create " << filename << ": " << std::strerror(errno));
+		return;
+	}
+	append(&fileHeader, sizeof(fileHeader));
+}
+
+PcapWriter::~PcapWriter() {
+	close();
+}
+
+void PcapWriter::write(const PCAPPacketHeader& header, const uint8_t* frame) {
+	PCAPPacketHeader record;
+	record.ts_sec = htole32(header.ts_sec);
+	record.ts_usec = htole32(header.ts_usec);
+	record.incl_len = htole32(header.incl_len);
+	record.orig_len = htole32(header.orig_len);
+	append(&record, sizeof(record));
+	append(frame, header.incl_len);
+	packetsWritten++;
+}
+
+void PcapWriter::append(const void* data, size_t length) {
+	if (!isValid()) {
+		return;
+	}
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	while (length > 0) {
+		size_t chunk = std::min(length, buffer.size() - used);
+		std::memcpy(static_cast<uint8_t*>(buffer.data()) + used, bytes, chunk);
+		used += chunk;
+		bytes += chunk;
+		length -= chunk;
+		if (used == buffer.size()) {
+			flush();
+		}
+	}
+}
+
+void PcapWriter::flush() {
+	const auto* data = static_cast<const uint8_t*>(buffer.data());
+	size_t written = 0;
+	while (written < used) {
+		ssize_t n = ::write(fd, data + written, used - written);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOG_ERROR("Write to " << filename << " failed: " << std::strerror(errno));
+			failed = true;
+			break;
+		}
+		written += static_cast<size_t>(n);
+	}
+	bytesWritten += written;
+	used = 0;
+}
+
+bool PcapWriter::close() {
+	if (fd < 0) {
+		return !failed;
+	}
+	if (!failed) {
+		flush();
+	}
+	if (::close(fd) != 0 && !failed) {
+		LOG_ERROR("Closing " << filename << " failed: " << std::strerror(errno));
+		failed = true;
+	}
+	fd = -1;
+	return !failed;
+}
@@ -0,0 +1,50 @@
+// PcapWriter.h
+
+#ifndef PCAP_WRITER_H
+#define PCAP_WRITER_H
+
+#include <cstdint>
+#include <string>
+
+#include "PCAPParser.h"
+#include "Placement.h"
+
+// Writes a classic pcap file. Records are gathered in a large buffer that is
+// handed to write(2) whole, so output is a stream of multi-megabyte
+// sequential writes regardless of packet size.
+class PcapWriter {
+	public:
+		static constexpr size_t WRITE_BUFFER_SIZE = 8 * 1024 * 1024;
+
+		// fileHeader is written as given, so the output keeps the input's link type and timestamp resolution
+		PcapWriter(const std::string& filename, const PCAPFileHeader& fileHeader);
+		~PcapWriter();
+
+		PcapWriter(const PcapWriter&) = delete;
+		PcapWriter& operator=(const PcapWriter&) = delete;
+
+		bool isValid() const { return fd >= 0 && !failed; }
+
+		// header fields in host byte order; incl_len bytes of frame are written
+		void write(const PCAPPacketHeader& header, const uint8_t* frame);
+
+		// Flushes buffered records and closes the file; returns false if any write failed
+		bool close();
+
+		uint64_t getPacketsWritten() const { return packetsWritten; }
+		uint64_t getBytesWritten() const { return bytesWritten; }
+
+	private:
+		void append(const void* data, size_t length);
+		void flush();
+
+		std::string filename;
+		int fd = -1;
+		bool failed = false;
+		HugePageBuffer buffer;
+		size_t used = 0;
+		uint64_t packetsWritten = 0;
+		uint64_t bytesWritten = 0;
+};
+
+#endif // PCAP_WRITER_H
@@ -0,0 +1,151 @@
+#include "PcapngReader.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PerfCounters.h"
+#include "log.h"
+
+PcapngReader::PcapngReader(const std::string& filename) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		LOG_ERROR("Cannot open file: " << filename << ": " << std::strerror(errno));
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		LOG_ERROR("Cannot read " << filename << ": empty or not a file");
+		::close(fd);
+		return;
+	}
+	fileSize = static_cast<uint64_t>(st.st_size);
+	void* region = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (region == MAP_FAILED) {
+		LOG_ERROR("mmap of " << filename << " failed: " << std::strerror(errno));
+		return;
+	}
+	madvise(region, fileSize, MADV_SEQUENTIAL);
+	data = static_cast<const uint8_t*>(region);
+	LOG_INFO("Pcapng file mapped: " << filename << ", " << fileSize << " bytes");
+
+	if (!PcapngSection::isPcapng(data, fileSize)) {
+		LOG_ERROR("Invalid pcapng file " << filename << ": no section header block");
+		return;
+	}
+	is_valid = true;
+}
+
+PcapngReader::~PcapngReader() {
+	if (data) {
+		munmap(const_cast<uint8_t*>(data), fileSize);
+	}
+}
+
+bool PcapngReader::isPcapngFile(const std::string& filename) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	uint8_t magic[4];
+	ssize_t n = ::read(fd, magic, sizeof(magic));
+	::close(fd);
+	return n > 0 && PcapngSection::isPcapng(magic, static_cast<size_t>(n));
+}
+
+bool PcapngReader::peekBlock(uint32_t& type, uint32_t& length) {
+	uint64_t remaining = fileSize - offset;
+	if (remaining == 0) {
+		return false;
+	}
+	if (remaining < PcapngSection::BLOCK_PEEK_SIZE) {
+		LOG_WARNING("The pcapng file ends inside a block, " << remaining << " bytes dropped");
+		return false;
+	}
+	if (!section.peekBlock(data + offset, type, length)) {
+		LOG_ERROR("Malformed pcapng block " << blockCount + 1 << " at offset " << offset);
+		is_valid = false;
+		return false;
+	}
+	if (length > remaining) {
+		LOG_WARNING("The pcapng file ends inside a block, " << remaining << " bytes dropped");
+		return false;
+	}
+	return true;
+}
+
+bool PcapngReader::nextPacket(CapturedPacket& packet) {
+	if (!is_valid) {
+		return false;
+	}
+	for (;;) {
+		if (perfCounters) {
+			perfCounters->begin();
+		}
+		uint32_t type;
+		uint32_t length;
+		if (!peekBlock(type, length)) {
+			return false;
+		}
+		const uint8_t* block = data + offset;
+		offset += length;
+		++blockCount;
+
+		PcapngPacket frame;
+		PcapngSection::BlockResult result = section.processBlock(block, type, length, frame);
+		if (result == PcapngSection::BlockResult::Invalid) {
+			LOG_ERROR("Invalid pcapng block " << blockCount << ": " << section.getError());
+			is_valid = false;
+			return false;
+		}
+		if (perfCounters) {
+			perfCounters->end(PerfStage::PcapRead);
+			perfCounters->begin();
+		}
+		// Skipped blocks and frames end their stage too, so their cycles are not lost
+		bool parsed = result == PcapngSection::BlockResult::Packet
+			&& parseLinkLayer(frame.frame, frame.capturedLength, packet);
+		if (perfCounters) {
+			perfCounters->end(PerfStage::LinkParse);
+		}
+		if (parsed) {
+			packet.captureTime = frame.captureTime;
+			return true;
+		}
+	}
+}
+
+bool PcapngReader::seek(uint64_t target) {
+	if (!data || target > fileSize) {
+		LOG_WARNING("Cannot seek to offset " << target << ", file size is " << fileSize);
+		return false;
+	}
+	section.reset();
+	offset = 0;
+	blockCount = 0;
+	is_valid = true;
+	while (offset < target) {
+		uint32_t type;
+		uint32_t length;
+		if (!peekBlock(type, length) || offset + length > target) {
+			LOG_WARNING("Offset " << target << " is not at a pcapng block boundary");
+			is_valid = false;
+			return false;
+		}
+		// Only section headers and interface descriptions carry state
+		if (type != PCAPNG_ENHANCED_PACKET_BLOCK && type != PCAPNG_PACKET_BLOCK) {
+			PcapngPacket unused;
+			if (section.processBlock(data + offset, type, length, unused) == PcapngSection::BlockResult::Invalid) {
+				LOG_ERROR("Invalid pcapng block " << blockCount + 1 << ": " << section.getError());
+				is_valid = false;
+				return false;
+			}
+		}
+		offset += length;
+		++blockCount;
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+// PcapngReader.h
+
+#ifndef PCAPNG_READER_H
+#define PCAPNG_READER_H
+
+#include <string>
+
+#include "PCAPParser.h"
+#include "PcapngSection.h"
+
+// Reads a pcapng capture file (section header, interface description and
+// enhanced packet blocks, any number of interfaces and sections, either byte
+// order). The file is mapped and its blocks are walked in place: frames are
+// handed to the link-layer parser straight from the mapping, never copied.
+class PcapngReader : public SeekablePacketSource {
+	public:
+		explicit PcapngReader(const std::string& filename);
+		~PcapngReader();
+
+		PcapngReader(const PcapngReader&) = delete;
+		PcapngReader& operator=(const PcapngReader&) = delete;
+
+		bool isValid() const override { return is_valid; }
+
+		bool nextPacket(CapturedPacket& packet) override;
+
+		void setPerfCounters(PerfCounters* counters) noexcept override { perfCounters = counters; }
+
+		// Offset of the next block. Seeking walks the metadata blocks before offset
+		// again, so the interfaces are known when reading resumes.
+		uint64_t position() const override { return offset; }
+		bool seek(uint64_t target) override;
+		uint64_t getFileSize() const override { return fileSize; }
+
+		// True if the file starts with a pcapng section header block
+		static bool isPcapngFile(const std::string& filename);
+
+	private:
+		// Type and length of the block at offset; false at the end of the file or on a malformed block
+		bool peekBlock(uint32_t& type, uint32_t& length);
+
+		const uint8_t* data = nullptr;   // Read-only mapping of the whole file
+		uint64_t fileSize = 0;
+		uint64_t offset = 0;
+		bool is_valid = false;
+		PcapngSection section;
+		uint64_t blockCount = 0;
+
+		PerfCounters* perfCounters = nullptr;
+};
+
+#endif // PCAPNG_READER_H
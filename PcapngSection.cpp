@@ -0,0 +1,213 @@
+#include "PcapngSection.h"
+#include <cstring>
+#include <endian.h>
+
+#include "log.h"
+
+namespace {
+
+// Offsets within blocks, from the start of the block
+constexpr size_t SHB_BYTE_ORDER_OFFSET = 8;
+constexpr size_t SHB_MIN_LENGTH = 28;
+constexpr size_t IDB_LINK_TYPE_OFFSET = 8;
+constexpr size_t IDB_OPTIONS_OFFSET = 16;
+constexpr size_t PACKET_INTERFACE_OFFSET = 8;
+constexpr size_t PACKET_TIMESTAMP_OFFSET = 12;
+constexpr size_t PACKET_CAPTURED_LENGTH_OFFSET = 20;
+constexpr size_t PACKET_DATA_OFFSET = 28;
+constexpr size_t PACKET_MIN_LENGTH = 32;
+
+constexpr uint16_t OPTION_END = 0;
+constexpr uint16_t OPTION_IF_TSRESOL = 9;
+constexpr uint16_t OPTION_IF_TSOFFSET = 14;
+
+constexpr uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+
+} // namespace
+
+bool PcapngSection::isPcapng(const uint8_t* data, size_t length) noexcept {
+	uint32_t type;
+	if (length < sizeof(type)) {
+		return false;
+	}
+	std::memcpy(&type, data, sizeof(type));
+	return type == PCAPNG_SECTION_HEADER_BLOCK;   // Reads the same in either byte order
+}
+
+uint16_t PcapngSection::read16(const uint8_t* p) const noexcept {
+	uint16_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return bigEndian ? be16toh(value) : le16toh(value);
+}
+
+uint32_t PcapngSection::read32(const uint8_t* p) const noexcept {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return bigEndian ? be32toh(value) : le32toh(value);
+}
+
+uint64_t PcapngSection::read64(const uint8_t* p) const noexcept {
+	uint64_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return bigEndian ? be64toh(value) : le64toh(value);
+}
+
+bool PcapngSection::peekBlock(const uint8_t* data, uint32_t& type, uint32_t& length) const noexcept {
+	std::memcpy(&type, data, sizeof(type));
+	if (type == PCAPNG_SECTION_HEADER_BLOCK) {
+		// A new section may switch byte order; its magic tells how to read its length
+		uint32_t magic;
+		std::memcpy(&magic, data + SHB_BYTE_ORDER_OFFSET, sizeof(magic));
+		if (le32toh(magic) == PCAPNG_BYTE_ORDER_MAGIC) {
+			std::memcpy(&length, data + 4, sizeof(length));
+			length = le32toh(length);
+		} else if (be32toh(magic) == PCAPNG_BYTE_ORDER_MAGIC) {
+			std::memcpy(&length, data + 4, sizeof(length));
+			length = be32toh(length);
+		} else {
+			return false;
+		}
+		return length >= SHB_MIN_LENGTH && length % 4 == 0;
+	}
+	if (!inSection) {
+		return false;
+	}
+	type = read32(data);
+	length = read32(data + 4);
+	return length >= MIN_BLOCK_SIZE && length % 4 == 0;
+}
+
+void PcapngSection::reset() {
+	bigEndian = false;
+	inSection = false;
+	interfaces.clear();
+	error.clear();
+}
+
+PcapngSection::BlockResult PcapngSection::processBlock(const uint8_t* block, uint32_t type, uint32_t length,
+		PcapngPacket& packet) {
+	switch (type) {
+		case PCAPNG_SECTION_HEADER_BLOCK:
+			return readSectionHeader(block, length) ? BlockResult::Other : BlockResult::Invalid;
+		case PCAPNG_INTERFACE_DESCRIPTION_BLOCK:
+			return readInterface(block, length) ? BlockResult::Other : BlockResult::Invalid;
+		case PCAPNG_ENHANCED_PACKET_BLOCK:
+			return readPacket(block, length, true, packet);
+		case PCAPNG_PACKET_BLOCK:
+			return readPacket(block, length, false, packet);
+		default:
+			// Name resolution, statistics, simple packet blocks (no timestamp) and custom blocks
+			return BlockResult::Other;
+	}
+}
+
+bool PcapngSection::readSectionHeader(const uint8_t* block, uint32_t length) {
+	uint32_t magic;
+	std::memcpy(&magic, block + SHB_BYTE_ORDER_OFFSET, sizeof(magic));
+	bigEndian = be32toh(magic) == PCAPNG_BYTE_ORDER_MAGIC;
+	uint16_t major = read16(block + SHB_BYTE_ORDER_OFFSET + 4);
+	if (major != 1 || length < SHB_MIN_LENGTH) {
+		error = "unsupported pcapng version " + std::to_string(major);
+		return false;
+	}
+	// Interface numbers restart with every section
+	interfaces.clear();
+	inSection = true;
+	LOG_INFO("Pcapng section, " << (bigEndian ? "big" : "little") << "-endian");
+	return true;
+}
+
+bool PcapngSection::readInterface(const uint8_t* block, uint32_t length) {
+	if (length < IDB_OPTIONS_OFFSET + 4) {
+		error = "interface description block too short";
+		return false;
+	}
+	Interface interface;
+	interface.linkType = read16(block + IDB_LINK_TYPE_OFFSET);
+
+	const uint8_t* option = block + IDB_OPTIONS_OFFSET;
+	const uint8_t* optionsEnd = block + length - 4;
+	while (optionsEnd - option >= 4) {
+		uint16_t code = read16(option);
+		uint16_t optionLength = read16(option + 2);
+		const uint8_t* value = option + 4;
+		if (code == OPTION_END || optionsEnd - value < optionLength) {
+			break;
+		}
+		if (code == OPTION_IF_TSRESOL && optionLength >= 1) {
+			// High bit clear: 10^-n seconds, set: 2^-n seconds
+			uint8_t resolution = value[0];
+			uint8_t exponent = resolution & 0x7F;
+			bool binary = resolution & 0x80;
+			if (exponent > (binary ? 63 : 19)) {
+				error = "unsupported timestamp resolution " + std::to_string(resolution);
+				return false;
+			}
+			uint64_t units = 1;
+			for (uint8_t i = 0; i < exponent; ++i) {
+				units *= binary ? 2 : 10;
+			}
+			interface.unitsPerSecond = units;
+		} else if (code == OPTION_IF_TSOFFSET && optionLength >= 8) {
+			interface.offsetSeconds = static_cast<int64_t>(read64(value));
+		}
+		option = value + ((optionLength + 3u) & ~3u);
+	}
+
+	if (interface.linkType != LINKTYPE_ETHERNET) {
+		LOG_WARNING("Pcapng interface " << interfaces.size() << " has link type " << interface.linkType
+				<< ", its packets are skipped");
+	}
+	LOG_INFO("Pcapng interface " << interfaces.size() << ": link type " << interface.linkType
+			<< ", " << interface.unitsPerSecond << " timestamp units per second");
+	interfaces.push_back(interface);
+	return true;
+}
+
+PcapngSection::BlockResult PcapngSection::readPacket(const uint8_t* block, uint32_t length, bool enhanced,
+		PcapngPacket& packet) {
+	if (length < PACKET_MIN_LENGTH) {
+		error = "packet block too short";
+		return BlockResult::Invalid;
+	}
+	uint32_t interfaceId = enhanced ? read32(block + PACKET_INTERFACE_OFFSET) : read16(block + PACKET_INTERFACE_OFFSET);
+	if (interfaceId >= interfaces.size()) {
+		error = "packet of undeclared interface " + std::to_string(interfaceId);
+		return BlockResult::Invalid;
+	}
+	uint32_t capturedLength = read32(block + PACKET_CAPTURED_LENGTH_OFFSET);
+	if (capturedLength > length - PACKET_MIN_LENGTH) {
+		error = "packet block shorter than its captured length";
+		return BlockResult::Invalid;
+	}
+	const Interface& interface = interfaces[interfaceId];
+	if (interface.linkType != LINKTYPE_ETHERNET) {
+		return BlockResult::Other;
+	}
+
+	uint64_t units = uint64_t{read32(block + PACKET_TIMESTAMP_OFFSET)} << 32 | read32(block + PACKET_TIMESTAMP_OFFSET + 4);
+	packet.frame = block + PACKET_DATA_OFFSET;
+	packet.capturedLength = capturedLength;
+	packet.captureTime = toNanoseconds(units, interface);
+	return BlockResult::Packet;
+}
+
+uint64_t PcapngSection::toNanoseconds(uint64_t units, const Interface& interface) noexcept {
+	uint64_t nanoseconds;
+	if (interface.unitsPerSecond == NANOSECONDS_PER_SECOND) {
+		nanoseconds = units;
+	} else if (interface.unitsPerSecond == 1000000) {
+		nanoseconds = units * 1000;
+	} else {
+		uint64_t seconds = units / interface.unitsPerSecond;
+		uint64_t fraction = units % interface.unitsPerSecond;
+		if (interface.unitsPerSecond <= UINT64_MAX / NANOSECONDS_PER_SECOND) {
+			fraction = fraction * NANOSECONDS_PER_SECOND / interface.unitsPerSecond;
+		} else {
+			// Finer than 2^-34 s: the exact product would overflow
+			fraction = static_cast<uint64_t>(static_cast<long double>(fraction) * NANOSECONDS_PER_SECOND / interface.unitsPerSecond);
+		}
+		nanoseconds = seconds * NANOSECONDS_PER_SECOND + fraction;
+	}
+	return nanoseconds + static_cast<uint64_t>(interface.offsetSeconds) * NANOSECONDS_PER_SECOND;
+}
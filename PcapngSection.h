@@ -0,0 +1,79 @@
+// PcapngSection.h
+
+#ifndef PCAPNG_SECTION_H
+#define PCAPNG_SECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t PCAPNG_SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+static constexpr uint32_t PCAPNG_INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+static constexpr uint32_t PCAPNG_PACKET_BLOCK = 0x00000002;   // Obsolete, still written by old tools
+static constexpr uint32_t PCAPNG_ENHANCED_PACKET_BLOCK = 0x00000006;
+static constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+static constexpr uint16_t LINKTYPE_ETHERNET = 1;
+
+// One captured frame of a pcapng packet block, pointing into the block
+struct PcapngPacket {
+	const uint8_t* frame = nullptr;
+	uint32_t capturedLength = 0;
+	uint64_t captureTime = 0;   // ns since epoch
+};
+
+// Interprets pcapng blocks in place: the byte order of the current section,
+// its interfaces with their link type and timestamp resolution (if_tsresol)
+// and offset (if_tsoffset), and the packets of Ethernet interfaces. Knows
+// nothing about where the blocks come from, so file and stream readers share it.
+class PcapngSection {
+	public:
+		// Bytes needed to tell the length of any block (a section header's byte order follows its length)
+		static constexpr size_t BLOCK_PEEK_SIZE = 12;
+		static constexpr size_t MIN_BLOCK_SIZE = 12;
+
+		// True if data (at least 4 bytes) starts with a section header block
+		static bool isPcapng(const uint8_t* data, size_t length) noexcept;
+
+		// Type and total length of the block at data, which has BLOCK_PEEK_SIZE bytes.
+		// False if the header is malformed.
+		bool peekBlock(const uint8_t* data, uint32_t& type, uint32_t& length) const noexcept;
+
+		enum class BlockResult {
+			Packet,     // packet is set
+			Other,      // Metadata, or a packet of an interface that is not Ethernet
+			Invalid
+		};
+
+		// Applies a complete block as returned by peekBlock
+		BlockResult processBlock(const uint8_t* block, uint32_t type, uint32_t length, PcapngPacket& packet);
+
+		// Forgets the section, e.g. before walking a file again from the start
+		void reset();
+
+		const std::string& getError() const noexcept { return error; }
+		size_t interfaceCount() const noexcept { return interfaces.size(); }
+
+	private:
+		struct Interface {
+			uint16_t linkType = 0;
+			uint64_t unitsPerSecond = 1000000;   // if_tsresol, microseconds by default
+			int64_t offsetSeconds = 0;           // if_tsoffset
+		};
+
+		uint16_t read16(const uint8_t* p) const noexcept;
+		uint32_t read32(const uint8_t* p) const noexcept;
+		uint64_t read64(const uint8_t* p) const noexcept;
+
+		bool readSectionHeader(const uint8_t* block, uint32_t length);
+		bool readInterface(const uint8_t* block, uint32_t length);
+		BlockResult readPacket(const uint8_t* block, uint32_t length, bool enhanced, PcapngPacket& packet);
+		static uint64_t toNanoseconds(uint64_t units, const Interface& interface) noexcept;
+
+		bool bigEndian = false;
+		bool inSection = false;
+		std::vector<Interface> interfaces;
+		std::string error;
+};
+
+#endif // PCAPNG_SECTION_H
@@ -0,0 +1,147 @@
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.h"
+
+namespace {
+
+struct EventConfig {
+	uint32_t type;
+	uint64_t config;
+	const char* name;
+};
+
+constexpr EventConfig EVENT_CONFIGS[PerfCounters::EVENT_COUNT] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+		| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "L1D misses"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "LLC misses"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch misses"},
+};
+
+int openEvent(const EventConfig& event, int groupFd, bool excludeKernel) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = event.type;
+	attr.config = event.config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.disabled = groupFd < 0 ? 1 : 0;
+	attr.exclude_kernel = excludeKernel ? 1 : 0;
+	attr.exclude_hv = 1;
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+	fds.fill(-1);
+	slot.fill(-1);
+
+	// Kernel time matters for the pcap read stage, but needs perf_event_paranoid <= 1
+	includesKernel = true;
+	fds[Cycles] = openEvent(EVENT_CONFIGS[Cycles], -1, false);
+	if (fds[Cycles] < 0 && (errno == EACCES || errno == EPERM)) {
+		includesKernel = false;
+		fds[Cycles] = openEvent(EVENT_CONFIGS[Cycles], -1, true);
+	}
+	if (fds[Cycles] < 0) {
+		LOG_WARNING("perf_event_open failed for cycles: " << std::strerror(errno)
+				<< "; hardware counters are disabled");
+		return;
+	}
+	slot[Cycles] = static_cast<int8_t>(openCount++);
+
+	for (size_t i = Cycles + 1; i < EVENT_COUNT; ++i) {
+		fds[i] = openEvent(EVENT_CONFIGS[i], fds[Cycles], !includesKernel);
+		if (fds[i] < 0) {
+			LOG_WARNING("Hardware counter " << EVENT_CONFIGS[i].name << " is not available: " << std::strerror(errno));
+			continue;
+		}
+		slot[i] = static_cast<int8_t>(openCount++);
+	}
+
+	ioctl(fds[Cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fds[Cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	LOG_INFO("Hardware counters enabled: " << openCount << " events, "
+			<< (includesKernel ? "user and kernel" : "user space only"));
+}
+
+PerfCounters::~PerfCounters() {
+	for (int fd : fds) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+void PerfCounters::read(Reading& reading) noexcept {
+	if (!isValid()) {
+		return;
+	}
+	// PERF_FORMAT_GROUP layout: nr, then one value per event in the order they were opened
+	uint64_t buffer[1 + EVENT_COUNT];
+	if (::read(fds[Cycles], buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t) * (1 + openCount))) {
+		return;
+	}
+	for (size_t i = 0; i < EVENT_COUNT; ++i) {
+		if (slot[i] >= 0) {
+			reading[i] = buffer[1 + slot[i]];
+		}
+	}
+}
+
+void PerfCounters::end(PerfStage stage) noexcept {
+	Reading now = start;
+	read(now);
+	Reading& total = totals[static_cast<size_t>(stage)];
+	for (size_t i = 0; i < EVENT_COUNT; ++i) {
+		total[i] += now[i] - start[i];
+	}
+	calls[static_cast<size_t>(stage)]++;
+}
+
+const char* PerfCounters::stageName(PerfStage stage) noexcept {
+	switch (stage) {
+		case PerfStage::PcapRead: return "pcap read";
+		case PerfStage::LinkParse: return "link-layer parse";
+		case PerfStage::Reassembly: return "reassembly";
+		case PerfStage::SbeDecode: return "SBE decode";
+		case PerfStage::SnapshotDecode: return "snapshot decode";
+		default: return "unknown";
+	}
+}
+
+void PerfCounters::printReport() const {
+	if (!isValid()) {
+		return;
+	}
+	LOG_INFO("Hardware counter report (" << (includesKernel ? "user and kernel" : "user space only")
+			<< ", per stage totals and per call averages)");
+	for (size_t s = 0; s < STAGE_COUNT; ++s) {
+		if (calls[s] == 0) {
+			continue;
+		}
+		const Reading& total = totals[s];
+		std::ostringstream line;
+		line << "  " << stageName(static_cast<PerfStage>(s)) << ": calls=" << calls[s];
+		for (size_t i = 0; i < EVENT_COUNT; ++i) {
+			if (slot[i] < 0) {
+				continue;
+			}
+			line << " " << EVENT_CONFIGS[i].name << "=" << total[i]
+				<< " (" << total[i] / calls[s] << "/call)";
+		}
+		if (slot[Instructions] >= 0 && total[Cycles] > 0) {
+			line << " IPC=" << std::fixed << std::setprecision(2)
+				<< static_cast<double>(total[Instructions]) / static_cast<double>(total[Cycles]);
+		}
+		LOG_INFO(line.str());
+	}
+}
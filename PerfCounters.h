@@ -0,0 +1,77 @@
+// PerfCounters.h
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Pipeline stages measured with hardware counters:
+//   PcapRead       - reading packet records from the capture
+//   LinkParse      - Ethernet/IPv4/UDP header parsing
+//   Reassembly     - SIMBA packet headers and fragment reassembly
+//   SbeDecode      - decoding OrderUpdate/OrderExecution payloads
+//   SnapshotDecode - decoding OrderBookSnapshot payloads
+enum class PerfStage : uint8_t {
+	PcapRead = 0,
+	LinkParse,
+	Reassembly,
+	SbeDecode,
+	SnapshotDecode,
+	Count
+};
+
+// In-process hardware counters (cycles, instructions, L1D and LLC misses,
+// branch misses) read through perf_event_open around each pipeline stage and
+// accumulated per stage. All counters form one group, so they are scheduled
+// together and read with a single read(2) per stage boundary; that read is
+// the instrumentation cost (about a microsecond), so only enable this for
+// profiling runs. Counters the CPU or hypervisor does not offer are left
+// out. Kernel time is included when perf_event_paranoid allows it.
+class PerfCounters {
+	public:
+		enum Event : uint8_t {
+			Cycles = 0,
+			Instructions,
+			L1DMisses,
+			LlcMisses,
+			BranchMisses,
+			EVENT_COUNT
+		};
+
+		static constexpr size_t STAGE_COUNT = static_cast<size_t>(PerfStage::Count);
+
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		// False if not even the cycle counter could be opened
+		bool isValid() const { return fds[Cycles] >= 0; }
+
+		// Stages are measured one at a time: begin(), then end() with the stage just run
+		void begin() noexcept { read(start); }
+		void end(PerfStage stage) noexcept;
+
+		void printReport() const;
+
+	private:
+		using Reading = std::array<uint64_t, EVENT_COUNT>;
+
+		void read(Reading& reading) noexcept;
+
+		static const char* stageName(PerfStage stage) noexcept;
+
+		std::array<int, EVENT_COUNT> fds;
+		std::array<int8_t, EVENT_COUNT> slot;      // Position of each event in the group read, -1 if missing
+		size_t openCount = 0;
+		bool includesKernel = false;
+
+		Reading start{};
+		std::array<Reading, STAGE_COUNT> totals{};
+		std::array<uint64_t, STAGE_COUNT> calls{};
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,236 @@
+#include "Placement.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+#include "log.h"
+
+PlacementConfig Placement::config;
+bool Placement::configured = false;
+
+namespace {
+
+constexpr unsigned long MAX_NODES = sizeof(unsigned long) * 8;
+
+// Raw syscalls: libnuma is not required for a single-node bind
+long setMemoryPolicy(int mode, const unsigned long* nodemask, unsigned long maxnode) {
+	return syscall(SYS_set_mempolicy, mode, nodemask, maxnode);
+}
+
+long bindMemory(void* addr, unsigned long length, int node) {
+	unsigned long nodemask = 1UL << node;
+	return syscall(SYS_mbind, addr, length, MPOL_BIND, &nodemask, MAX_NODES, 0);
+}
+
+std::string readSysfsLine(const std::string& path) {
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+const char* roleName(ThreadRole role) {
+	switch (role) {
+		case ThreadRole::Reader: return "reader";
+		case ThreadRole::Prefetch: return "prefetch";
+		case ThreadRole::Consumer: return "consumer";
+	}
+	return "unknown";
+}
+
+const char* backingName(HugePageBuffer::Backing backing) {
+	switch (backing) {
+		case HugePageBuffer::Backing::HugeTlb: return "2 MB hugetlb pages";
+		case HugePageBuffer::Backing::TransparentHugePages: return "transparent huge pages (madvise)";
+		case HugePageBuffer::Backing::NormalPages: return "normal pages";
+		case HugePageBuffer::Backing::None: break;
+	}
+	return "unallocated";
+}
+
+} // namespace
+
+bool Placement::configure(const PlacementConfig& requested) {
+	config = requested;
+	configured = true;
+	bool ok = true;
+
+	if (config.readerCore >= 0) {
+		ok = pin(pthread_self(), config.readerCore) && ok;
+	}
+	if (config.numaNode < 0 && config.readerCore >= 0) {
+		config.numaNode = nodeOfCore(config.readerCore);
+	}
+	if (config.numaNode >= 0) {
+		if (static_cast<unsigned long>(config.numaNode) >= MAX_NODES) {
+			LOG_ERROR("NUMA node " << config.numaNode << " is out of range");
+			config.numaNode = -1;
+			ok = false;
+		} else {
+			unsigned long nodemask = 1UL << config.numaNode;
+			if (setMemoryPolicy(MPOL_BIND, &nodemask, MAX_NODES) != 0) {
+				LOG_ERROR("Cannot bind memory to NUMA node " << config.numaNode << ": " << std::strerror(errno));
+				config.numaNode = -1;
+				ok = false;
+			}
+		}
+	}
+
+	LOG_INFO("Placement: reader thread " << (config.readerCore >= 0 ? "pinned to core " + std::to_string(config.readerCore) : "not pinned")
+			<< ", running on core " << sched_getcpu()
+			<< ", memory " << (config.numaNode >= 0 ? "bound to NUMA node " + std::to_string(config.numaNode) : "not bound"));
+	if (config.hugePages) {
+		LOG_INFO("Placement: huge pages requested; free 2 MB hugetlb pages: "
+				<< readSysfsLine("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages")
+				<< ", transparent huge pages: " << readSysfsLine("/sys/kernel/mm/transparent_hugepage/enabled"));
+	}
+	return ok;
+}
+
+void Placement::pinThread(std::thread& thread, ThreadRole role, size_t index) {
+	int core = -1;
+	switch (role) {
+		case ThreadRole::Reader: core = config.readerCore; break;
+		case ThreadRole::Prefetch: core = config.prefetchCore; break;
+		case ThreadRole::Consumer:
+			if (!config.consumerCores.empty()) {
+				core = config.consumerCores[index % config.consumerCores.size()];
+			}
+			break;
+	}
+	if (core < 0) {
+		return;
+	}
+	if (pin(thread.native_handle(), core)) {
+		LOG_INFO("Placement: " << roleName(role) << " thread " << index << " pinned to core " << core
+				<< " (NUMA node " << nodeOfCore(core) << ")");
+	}
+}
+
+bool Placement::pin(pthread_t thread, int core) {
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+	int error = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+	if (error != 0) {
+		LOG_ERROR("Cannot pin thread to core " << core << ": " << std::strerror(error));
+		return false;
+	}
+	return true;
+}
+
+bool Placement::parseCoreList(const std::string& text, std::vector<int>& cores) {
+	size_t pos = 0;
+	while (pos < text.size()) {
+		size_t end = text.find(',', pos);
+		std::string item = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+		size_t dash = item.find('-');
+		try {
+			int first = std::stoi(item.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+			if (first < 0 || last < first) {
+				return false;
+			}
+			for (int core = first; core <= last; ++core) {
+				cores.push_back(core);
+			}
+		} catch (const std::exception&) {
+			return false;
+		}
+		if (end == std::string::npos) {
+			break;
+		}
+		pos = end + 1;
+	}
+	return !cores.empty();
+}
+
+int Placement::nodeOfCore(int core) {
+	std::error_code error;
+	std::filesystem::path cpuDir = "/sys/devices/system/cpu/cpu" + std::to_string(core);
+	for (const auto& entry : std::filesystem::directory_iterator(cpuDir, error)) {
+		std::string name = entry.path().filename().string();
+		if (name.starts_with("node") && name.size() > 4) {
+			return std::atoi(name.c_str() + 4);
+		}
+	}
+	return -1;
+}
+
+int Placement::nodeOfAddress(const void* addr) {
+	int node = -1;
+	if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+		return -1;
+	}
+	return node;
+}
+
+HugePageBuffer::HugePageBuffer(size_t size, const char* name) : requested(size) {
+	bool huge = Placement::hugePagesEnabled();
+	size_t pageSize = huge ? HUGE_PAGE_SIZE : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	mapped = (size + pageSize - 1) / pageSize * pageSize;
+
+	if (huge) {
+		region = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		backing = Backing::HugeTlb;
+	}
+	if (!huge || region == MAP_FAILED) {
+		region = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		backing = Backing::NormalPages;
+		if (huge && region != MAP_FAILED && madvise(region, mapped, MADV_HUGEPAGE) == 0) {
+			backing = Backing::TransparentHugePages;
+		}
+	}
+	if (region == MAP_FAILED) {
+		LOG_ERROR("Cannot allocate " << size << " bytes for " << name << ": " << std::strerror(errno));
+		region = nullptr;
+		mapped = 0;
+		backing = Backing::None;
+		return;
+	}
+
+	int node = Placement::numaNode();
+	if (node >= 0 && bindMemory(region, mapped, node) != 0) {
+		LOG_WARNING("Cannot bind " << name << " to NUMA node " << node << ": " << std::strerror(errno));
+	}
+
+	if (Placement::isConfigured()) {
+		// Fault the first page in so the report shows where the buffer actually lives
+		static_cast<volatile char*>(region)[0] = 0;
+		LOG_INFO("Placement: " << name << ", " << size << " bytes on " << backingName(backing)
+				<< ", NUMA node " << Placement::nodeOfAddress(region));
+	}
+}
+
+HugePageBuffer::~HugePageBuffer() {
+	release();
+}
+
+HugePageBuffer::HugePageBuffer(HugePageBuffer&& other) noexcept
+	: region(std::exchange(other.region, nullptr)), requested(std::exchange(other.requested, 0)),
+	mapped(std::exchange(other.mapped, 0)), backing(std::exchange(other.backing, Backing::None)) {}
+
+HugePageBuffer& HugePageBuffer::operator=(HugePageBuffer&& other) noexcept {
+	if (this != &other) {
+		release();
+		region = std::exchange(other.region, nullptr);
+		requested = std::exchange(other.requested, 0);
+		mapped = std::exchange(other.mapped, 0);
+		backing = std::exchange(other.backing, Backing::None);
+	}
+	return *this;
+}
+
+void HugePageBuffer::release() noexcept {
+	if (region) {
+		munmap(region, mapped);
+		region = nullptr;
+	}
+}
@@ -0,0 +1,93 @@
+// Placement.h
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <cstddef>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Threads that can be pinned
+enum class ThreadRole {
+	Reader,      // Main thread: pcap read, decode and in-line consumers
+	Prefetch,    // MultiPcapReader read-ahead, PcapStreamReader reads
+	Consumer     // EventFanout consumers, assigned round robin over the listed cores
+};
+
+struct PlacementConfig {
+	int readerCore = -1;                 // -1: not pinned
+	int prefetchCore = -1;
+	std::vector<int> consumerCores;
+	int numaNode = -1;                   // -1: the node of readerCore, if pinned
+	bool hugePages = false;              // Back large buffers with 2 MB pages
+};
+
+// Process-wide CPU and memory placement. configure() runs on the main thread
+// before any buffer or thread is created: it pins the main thread and binds
+// its memory policy to the NUMA node, which every heap allocation made later
+// (packet buffers, fragment storage, books) and every thread started later
+// inherit. Other threads are pinned by their owners through pinThread().
+// All placement results are logged, so they must be called on the main thread.
+class Placement {
+	public:
+		static bool configure(const PlacementConfig& config);
+
+		// Pins a thread to the core configured for role; no-op if none is
+		static void pinThread(std::thread& thread, ThreadRole role, size_t index = 0);
+
+		[[nodiscard]] static bool hugePagesEnabled() noexcept { return config.hugePages; }
+		[[nodiscard]] static int numaNode() noexcept { return config.numaNode; }
+		[[nodiscard]] static bool isConfigured() noexcept { return configured; }
+
+		// Parses "3" or "2,4-6" into core numbers
+		static bool parseCoreList(const std::string& text, std::vector<int>& cores);
+
+		// NUMA node of a CPU core or of the page holding addr; -1 if unknown
+		static int nodeOfCore(int core);
+		static int nodeOfAddress(const void* addr);
+
+	private:
+		static bool pin(pthread_t thread, int core);
+
+		static PlacementConfig config;
+		static bool configured;
+};
+
+// Large zero-initialised buffer placed according to Placement: 2 MB hugetlb
+// pages when enabled and available, else transparent huge pages (madvise),
+// else normal pages; bound to the configured NUMA node. Move-only.
+class HugePageBuffer {
+	public:
+		enum class Backing {
+			None,
+			HugeTlb,
+			TransparentHugePages,
+			NormalPages
+		};
+
+		static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+		HugePageBuffer() = default;
+		// name is used for the placement report
+		HugePageBuffer(size_t size, const char* name);
+		~HugePageBuffer();
+
+		HugePageBuffer(HugePageBuffer&& other) noexcept;
+		HugePageBuffer& operator=(HugePageBuffer&& other) noexcept;
+
+		[[nodiscard]] void* data() const noexcept { return region; }
+		[[nodiscard]] size_t size() const noexcept { return requested; }
+		[[nodiscard]] Backing getBacking() const noexcept { return backing; }
+
+	private:
+		void release() noexcept;
+
+		void* region = nullptr;
+		size_t requested = 0;
+		size_t mapped = 0;
+		Backing backing = Backing::None;
+};
+
+#endif // PLACEMENT_H
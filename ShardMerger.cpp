@@ -0,0 +1,155 @@
+#include "ShardMerger.h"
+#include <charconv>
+#include <functional>
+#include <queue>
+#include <string_view>
+#include <utility>
+
+#include "log.h"
+
+namespace {
+
+// How TextExporter leads the rows of ExportContent::ShardedEvents
+constexpr std::string_view CSV_KEY_COLUMNS = "packet,ordinal,";
+constexpr std::string_view JSONL_PACKET_FIELD = "{\"packet\":";
+constexpr std::string_view JSONL_ORDINAL_FIELD = "\"ordinal\":";
+
+// Reads the integer at text and the separator after it; advances text past both
+bool parseKeyField(std::string_view& text, std::string_view prefix, uint64_t& value) {
+	if (!text.starts_with(prefix)) {
+		return false;
+	}
+	text.remove_prefix(prefix.size());
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (error != std::errc() || end == text.data() + text.size() || *end != ',') {
+		return false;
+	}
+	text.remove_prefix(static_cast<size_t>(end - text.data()) + 1);
+	return true;
+}
+
+} // namespace
+
+ShardMerger::ShardMerger(const std::vector<std::string>& inputNames, const std::string& output) {
+	std::string header;
+	bool formatKnown = false;
+	for (const std::string& name : inputNames) {
+		auto input = std::make_unique<Input>();
+		input->name = name;
+		input->buffer = std::make_unique<char[]>(STREAM_BUFFER_SIZE);
+		input->stream.rdbuf()->pubsetbuf(input->buffer.get(), STREAM_BUFFER_SIZE);
+		input->stream.open(name, std::ios::binary);
+		if (!input->stream.is_open()) {
+			LOG_ERROR("Cannot open shard export " << name);
+			return;
+		}
+
+		// A CSV export starts with its header, JSONL rows with '{'; a shard may have no rows at all
+		int first = input->stream.peek();
+		if (first != std::char_traits<char>::eof()) {
+			bool inputCsv = first != '{';
+			if (formatKnown && inputCsv != csv) {
+				LOG_ERROR(name << " is not in the format of the other shard exports");
+				return;
+			}
+			csv = inputCsv;
+			formatKnown = true;
+			if (csv) {
+				std::string inputHeader;
+				std::getline(input->stream, inputHeader);
+				input->lineNumber++;
+				if (!inputHeader.starts_with(CSV_KEY_COLUMNS)) {
+					LOG_ERROR(name << " is not the export of a shard (simba_decoder --shard), its header has no packet and ordinal columns");
+					return;
+				}
+				if (!header.empty() && inputHeader != header) {
+					LOG_ERROR(name << " has another schema than the other shard exports");
+					return;
+				}
+				header = inputHeader;
+			}
+		}
+		inputs.push_back(std::move(input));
+	}
+
+	outBuffer = std::make_unique<char[]>(STREAM_BUFFER_SIZE);
+	out.rdbuf()->pubsetbuf(outBuffer.get(), STREAM_BUFFER_SIZE);
+	out.open(output, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		LOG_ERROR("Cannot create merged export " << output);
+		return;
+	}
+	if (!header.empty()) {
+		out << std::string_view(header).substr(CSV_KEY_COLUMNS.size()) << '\n';
+	}
+	LOG_INFO("Merging " << inputs.size() << " shard exports into " << output << " as " << (csv ? "CSV" : "JSONL"));
+	is_valid = true;
+}
+
+ShardMerger::~ShardMerger() = default;
+
+bool ShardMerger::advance(Input& input) {
+	if (!std::getline(input.stream, input.line)) {
+		return false;
+	}
+	input.lineNumber++;
+
+	std::string_view row(input.line);
+	Key key;
+	if (!parseKeyField(row, csv ? std::string_view() : JSONL_PACKET_FIELD, key.first)
+			|| !parseKeyField(row, csv ? std::string_view() : JSONL_ORDINAL_FIELD, key.second)) {
+		LOG_ERROR(input.name << ":" << input.lineNumber << ": row has no packet and ordinal key");
+		failed = true;
+		return false;
+	}
+	if (key < input.key) {
+		LOG_ERROR(input.name << ":" << input.lineNumber << ": packet " << key.first << " message " << key.second
+				<< " follows packet " << input.key.first << " message " << input.key.second
+				<< ", the export is not in capture order");
+		failed = true;
+		return false;
+	}
+	input.key = key;
+	input.rowStart = input.line.size() - row.size();
+	return true;
+}
+
+void ShardMerger::writeRow(const Input& input) {
+	if (!csv) {
+		out.put('{');
+	}
+	out.write(input.line.data() + input.rowStart, static_cast<std::streamsize>(input.line.size() - input.rowStart));
+	out.put('\n');
+	rowsWritten++;
+}
+
+bool ShardMerger::run() {
+	if (!is_valid) {
+		return false;
+	}
+
+	// Smallest packet and message first; the rows of one message come from a single shard
+	using Head = std::pair<Key, size_t>;
+	std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		if (advance(*inputs[i])) {
+			heads.push({inputs[i]->key, i});
+		}
+	}
+	while (!heads.empty() && !failed) {
+		size_t index = heads.top().second;
+		heads.pop();
+		Input& input = *inputs[index];
+		writeRow(input);
+		if (advance(input)) {
+			heads.push({input.key, index});
+		}
+	}
+
+	out.flush();
+	if (!out) {
+		LOG_ERROR("Writing the merged export failed");
+		return false;
+	}
+	return !failed;
+}
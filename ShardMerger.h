@@ -0,0 +1,66 @@
+// ShardMerger.h
+
+#ifndef SHARD_MERGER_H
+#define SHARD_MERGER_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Merges the exports of simba_decoder --shard runs over one capture back into
+// a single export in capture order. Each shard leads its rows with the number
+// of the capture packet that completed them and the ordinal of their SBE
+// message within its payload (ExportContent::ShardedEvents). Every shard
+// counts the same packets and messages, and the rows of one message come from
+// a single shard, so a k-way merge on (packet, ordinal) restores the row order
+// of an unsharded run. The key columns are dropped: the result has the plain
+// CSV/JSONL event schema.
+class ShardMerger {
+	public:
+		ShardMerger(const std::vector<std::string>& inputs, const std::string& output);
+		~ShardMerger();
+
+		ShardMerger(const ShardMerger&) = delete;
+		ShardMerger& operator=(const ShardMerger&) = delete;
+
+		bool isValid() const { return is_valid; }
+
+		// Writes the merged rows; false on an input that is not a shard export or out of order
+		bool run();
+
+		[[nodiscard]] uint64_t getRowsWritten() const noexcept { return rowsWritten; }
+
+	private:
+		static constexpr size_t STREAM_BUFFER_SIZE = 1024 * 1024;
+
+		// Packet, then message ordinal within it
+		using Key = std::pair<uint64_t, uint64_t>;
+
+		struct Input {
+			std::string name;
+			std::ifstream stream;
+			std::unique_ptr<char[]> buffer;
+			std::string line;
+			Key key;
+			size_t rowStart = 0;      // First byte of the line after the key
+			uint64_t lineNumber = 0;
+		};
+
+		// Reads the next row of input and parses its key; false at the end of the input or on error
+		bool advance(Input& input);
+		// The row without its key, in the plain schema
+		void writeRow(const Input& input);
+
+		std::vector<std::unique_ptr<Input>> inputs;
+		std::ofstream out;
+		std::unique_ptr<char[]> outBuffer;
+		bool csv = true;
+		bool is_valid = false;
+		bool failed = false;
+		uint64_t rowsWritten = 0;
+};
+
+#endif // SHARD_MERGER_H
@@ -0,0 +1,59 @@
+// ShmBookLayout.h
+//
+// Layout of the shared-memory order book region published by simba_decoder.
+// The region is a POSIX shared memory object (shm_open) that starts with a
+// ShmRegionHeader followed by maxInstruments ShmBookSlot entries.
+//
+// Every slot is guarded by its own seqlock: the writer makes the sequence odd,
+// updates the slot and makes it even again. Readers copy the slot and retry if
+// the sequence was odd or changed meanwhile, so they never block the writer and
+// never need a syscall after the initial mmap.
+
+#ifndef SHM_BOOK_LAYOUT_H
+#define SHM_BOOK_LAYOUT_H
+
+#include <atomic>
+#include <cstdint>
+
+static constexpr uint64_t SHM_BOOK_MAGIC = 0x4B4F4F4241424D53; // "SMBABOOK"
+static constexpr uint32_t SHM_BOOK_VERSION = 1;
+static constexpr uint32_t SHM_BOOK_DEPTH = 10;
+
+struct ShmPriceLevel {
+	int64_t price;   // Decimal5 mantissa
+	int64_t size;
+	uint32_t orders;
+	uint32_t reserved;
+};
+
+struct alignas(64) ShmRegionHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t depth;
+	uint32_t maxInstruments;
+	uint32_t slotSize;
+	// Number of slots in use; a slot's securityId is written before this is incremented
+	std::atomic<uint32_t> instrumentCount;
+	// Incremented by the writer on every publication, lets readers poll for any change
+	std::atomic<uint64_t> publishCount;
+};
+
+struct alignas(64) ShmBookSlot {
+	std::atomic<uint32_t> sequence;   // Odd while the writer is updating the slot
+	int32_t securityId;
+	uint32_t rptSeq;
+	uint32_t bidCount;
+	uint32_t askCount;
+	uint64_t publishTime;             // Wall clock of the publication, ns since epoch
+	ShmPriceLevel bids[SHM_BOOK_DEPTH];
+	ShmPriceLevel asks[SHM_BOOK_DEPTH];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock requires lock-free 32-bit atomics");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared region requires lock-free 64-bit atomics");
+
+inline constexpr size_t shmBookRegionSize(uint32_t maxInstruments) {
+	return sizeof(ShmRegionHeader) + static_cast<size_t>(maxInstruments) * sizeof(ShmBookSlot);
+}
+
+#endif // SHM_BOOK_LAYOUT_H
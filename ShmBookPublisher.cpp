@@ -0,0 +1,128 @@
+#include "ShmBookPublisher.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "LatencyTracer.h"
+
+ShmBookPublisher::ShmBookPublisher(const std::string& name, uint32_t maxInstruments) : name(name) {
+	// A fresh object rather than truncating an existing one: readers that still map a region
+	// left by an earlier run keep it intact instead of faulting with SIGBUS
+	if (shm_unlink(name.c_str()) == 0) {
+		LOG_INFO("Replaced shared memory " << name << " left by an earlier publisher");
+	}
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) {
+		LOG_ERROR("shm_open(" << name << ") failed: " << std::strerror(errno));
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0) {
+		objectId = static_cast<uint64_t>(st.st_ino);
+	}
+
+	regionSize = shmBookRegionSize(maxInstruments);
+	if (ftruncate(fd, static_cast<off_t>(regionSize)) != 0) {
+		LOG_ERROR("ftruncate of shared memory " << name << " failed: " << std::strerror(errno));
+		close(fd);
+		shm_unlink(name.c_str());
+		return;
+	}
+
+	void* region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (region == MAP_FAILED) {
+		LOG_ERROR("mmap of shared memory " << name << " failed: " << std::strerror(errno));
+		shm_unlink(name.c_str());
+		return;
+	}
+
+	// ftruncate zero-fills the region, so all slots start with sequence 0
+	header = static_cast<ShmRegionHeader*>(region);
+	slots = reinterpret_cast<ShmBookSlot*>(static_cast<uint8_t*>(region) + sizeof(ShmRegionHeader));
+	header->version = SHM_BOOK_VERSION;
+	header->depth = SHM_BOOK_DEPTH;
+	header->maxInstruments = maxInstruments;
+	header->slotSize = sizeof(ShmBookSlot);
+	header->instrumentCount.store(0, std::memory_order_relaxed);
+	header->publishCount.store(0, std::memory_order_relaxed);
+	// Magic last: readers treat a region without it as not yet initialised
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = SHM_BOOK_MAGIC;
+
+	LOG_INFO("Publishing order books to shared memory " << name << " (" << regionSize << " bytes, "
+			<< maxInstruments << " instruments, depth " << SHM_BOOK_DEPTH << ")");
+}
+
+ShmBookPublisher::~ShmBookPublisher() {
+	if (header) {
+		munmap(header, regionSize);
+		// Readers that already mapped the region keep their mapping. A later publisher
+		// may have replaced the name with an object of its own, which stays
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		struct stat st;
+		if (fd >= 0 && fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_ino) == objectId) {
+			shm_unlink(name.c_str());
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+ShmBookSlot* ShmBookPublisher::slotFor(int32_t securityId) {
+	uint32_t index = slotIndex.find(securityId);
+	if (index != InstrumentIndex::NOT_FOUND) [[likely]] {
+		return &slots[index];
+	}
+
+	if (slotIndex.size() >= header->maxInstruments) {
+		if (!overflowReported) {
+			LOG_WARNING("Shared memory book region is full (" << header->maxInstruments
+					<< " instruments), SecurityID " << securityId << " and later ones are not published");
+			overflowReported = true;
+		}
+		return nullptr;
+	}
+
+	index = slotIndex.assign(securityId);
+	ShmBookSlot* slot = &slots[index];
+	slot->securityId = securityId;
+	header->instrumentCount.store(index + 1, std::memory_order_release);
+	return slot;
+}
+
+void ShmBookPublisher::publish(int32_t securityId, const OrderBook& book) {
+	ShmBookSlot* slot = slotFor(securityId);
+	if (!slot) {
+		return;
+	}
+
+	PriceLevel bids[SHM_BOOK_DEPTH];
+	PriceLevel asks[SHM_BOOK_DEPTH];
+	size_t bidCount = book.topLevels(MDEntryType::Bid, bids, SHM_BOOK_DEPTH);
+	size_t askCount = book.topLevels(MDEntryType::Offer, asks, SHM_BOOK_DEPTH);
+
+	uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+	slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot->rptSeq = book.getRptSeq();
+	slot->bidCount = static_cast<uint32_t>(bidCount);
+	slot->askCount = static_cast<uint32_t>(askCount);
+	slot->publishTime = LatencyTracer::wallClockNs();
+	for (size_t i = 0; i < bidCount; ++i) {
+		slot->bids[i] = ShmPriceLevel{bids[i].price, bids[i].size, bids[i].orders, 0};
+	}
+	for (size_t i = 0; i < askCount; ++i) {
+		slot->asks[i] = ShmPriceLevel{asks[i].price, asks[i].size, asks[i].orders, 0};
+	}
+
+	slot->sequence.store(sequence + 2, std::memory_order_release);
+	header->publishCount.store(header->publishCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,41 @@
+// ShmBookPublisher.h
+
+#ifndef SHM_BOOK_PUBLISHER_H
+#define SHM_BOOK_PUBLISHER_H
+
+#include <string>
+
+#include "InstrumentIndex.h"
+#include "OrderBook.h"
+#include "ShmBookLayout.h"
+
+// Publishes top-of-book and depth of every instrument into a POSIX shared
+// memory region (see ShmBookLayout.h). Single writer; any number of
+// ShmBookReader instances in other processes may read concurrently.
+class ShmBookPublisher {
+	public:
+		static constexpr uint32_t DEFAULT_MAX_INSTRUMENTS = 16384;
+
+		ShmBookPublisher(const std::string& name, uint32_t maxInstruments = DEFAULT_MAX_INSTRUMENTS);
+		~ShmBookPublisher();
+
+		ShmBookPublisher(const ShmBookPublisher&) = delete;
+		ShmBookPublisher& operator=(const ShmBookPublisher&) = delete;
+
+		bool isValid() const { return header != nullptr; }
+
+		void publish(int32_t securityId, const OrderBook& book);
+
+	private:
+		ShmBookSlot* slotFor(int32_t securityId);
+
+		std::string name;
+		size_t regionSize = 0;
+		uint64_t objectId = 0;              // Inode of the object, to unlink only our own
+		ShmRegionHeader* header = nullptr;
+		ShmBookSlot* slots = nullptr;
+		InstrumentIndex slotIndex;          // Slot i holds slotIndex.securityIdAt(i)
+		bool overflowReported = false;
+};
+
+#endif // SHM_BOOK_PUBLISHER_H
@@ -0,0 +1,114 @@
+#include "ShmBookReader.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+ShmBookReader::ShmBookReader(const std::string& name) {
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		error = "shm_open(" + name + ") failed: " + std::strerror(errno);
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRegionHeader)) {
+		error = "shared memory " + name + " is too small";
+		close(fd);
+		return;
+	}
+
+	regionSize = static_cast<size_t>(st.st_size);
+	void* region = mmap(nullptr, regionSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (region == MAP_FAILED) {
+		error = "mmap of shared memory " + name + " failed: " + std::strerror(errno);
+		return;
+	}
+
+	const auto* candidate = static_cast<const ShmRegionHeader*>(region);
+	bool compatible = candidate->magic == SHM_BOOK_MAGIC;
+	// Pairs with the publisher's release fence before the magic: the layout fields are read after it
+	std::atomic_thread_fence(std::memory_order_acquire);
+	compatible = compatible
+		&& candidate->version == SHM_BOOK_VERSION
+		&& candidate->depth == SHM_BOOK_DEPTH
+		&& candidate->slotSize == sizeof(ShmBookSlot)
+		&& shmBookRegionSize(candidate->maxInstruments) <= regionSize;
+	if (!compatible) {
+		error = "shared memory " + name + " has an incompatible or uninitialised layout";
+		munmap(region, regionSize);
+		return;
+	}
+
+	header = candidate;
+	slots = reinterpret_cast<const ShmBookSlot*>(static_cast<const uint8_t*>(region) + sizeof(ShmRegionHeader));
+}
+
+ShmBookReader::~ShmBookReader() {
+	if (header) {
+		munmap(const_cast<ShmRegionHeader*>(header), regionSize);
+	}
+}
+
+void ShmBookReader::refreshIndex() {
+	uint32_t count = header->instrumentCount.load(std::memory_order_acquire);
+	for (; indexedCount < count; ++indexedCount) {
+		slotIndex.emplace(slots[indexedCount].securityId, indexedCount);
+	}
+}
+
+bool ShmBookReader::readSlot(const ShmBookSlot& slot, ShmBookView& view) {
+	for (uint32_t attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+		uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			std::this_thread::yield();   // Writer is in the middle of an update
+			continue;
+		}
+
+		view.securityId = slot.securityId;
+		view.rptSeq = slot.rptSeq;
+		view.bidCount = slot.bidCount;
+		view.askCount = slot.askCount;
+		view.publishTime = slot.publishTime;
+		std::memcpy(view.bids, slot.bids, sizeof(view.bids));
+		std::memcpy(view.asks, slot.asks, sizeof(view.asks));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == before) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ShmBookReader::read(int32_t securityId, ShmBookView& view) {
+	auto it = slotIndex.find(securityId);
+	if (it == slotIndex.end()) {
+		refreshIndex();
+		it = slotIndex.find(securityId);
+		if (it == slotIndex.end()) {
+			return false;
+		}
+	}
+
+	if (!readSlot(slots[it->second], view)) {
+		error = "book of SecurityID " + std::to_string(securityId)
+			+ " is still being updated after " + std::to_string(MAX_READ_ATTEMPTS) + " reads; is the publisher alive?";
+		return false;
+	}
+	return true;
+}
+
+std::vector<int32_t> ShmBookReader::instruments() {
+	refreshIndex();
+	std::vector<int32_t> result;
+	result.reserve(indexedCount);
+	for (uint32_t i = 0; i < indexedCount; ++i) {
+		result.push_back(slots[i].securityId);
+	}
+	return result;
+}
@@ -0,0 +1,64 @@
+// ShmBookReader.h
+//
+// Lock-free reader of the shared-memory order books published by
+// simba_decoder --shm-books <name>. Link against simba_shm_reader.
+
+#ifndef SHM_BOOK_READER_H
+#define SHM_BOOK_READER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ShmBookLayout.h"
+
+// Consistent copy of one instrument's slot
+struct ShmBookView {
+	int32_t securityId;
+	uint32_t rptSeq;
+	uint32_t bidCount;
+	uint32_t askCount;
+	uint64_t publishTime;
+	ShmPriceLevel bids[SHM_BOOK_DEPTH];
+	ShmPriceLevel asks[SHM_BOOK_DEPTH];
+};
+
+class ShmBookReader {
+	public:
+		explicit ShmBookReader(const std::string& name);
+		~ShmBookReader();
+
+		ShmBookReader(const ShmBookReader&) = delete;
+		ShmBookReader& operator=(const ShmBookReader&) = delete;
+
+		bool isValid() const { return header != nullptr; }
+		const std::string& getError() const { return error; }
+
+		// Copies the latest consistent book of securityId; false if it was never published,
+		// or if its slot stayed mid-update for MAX_READ_ATTEMPTS reads, as it does after the
+		// publisher died during an update (getError() then says so)
+		bool read(int32_t securityId, ShmBookView& view);
+
+		// SecurityIDs published so far
+		std::vector<int32_t> instruments();
+
+		// Changes on every publication; poll it to detect updates cheaply
+		uint64_t publishCount() const { return header->publishCount.load(std::memory_order_acquire); }
+
+	private:
+		// Reads of one slot before giving up on it; a yield separates the attempts that
+		// find the writer mid-update, so a live but preempted writer is waited for
+		static constexpr uint32_t MAX_READ_ATTEMPTS = 1 << 16;
+
+		void refreshIndex();
+		static bool readSlot(const ShmBookSlot& slot, ShmBookView& view);
+
+		size_t regionSize = 0;
+		const ShmRegionHeader* header = nullptr;
+		const ShmBookSlot* slots = nullptr;
+		std::unordered_map<int32_t, uint32_t> slotIndex;
+		uint32_t indexedCount = 0;
+		std::string error;
+};
+
+#endif // SHM_BOOK_READER_H
@@ -1,14 +1,40 @@
 #include "SimbaDecoder.h"
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <cstring>
 #include <cassert>
+#include <charconv>
+#include <cstddef>
 
 #include "log.h"
+#include "DecodedEvent.h"
+#include "LatencyTracer.h"
+#include "PerfCounters.h"
+
+char* Decimal5::toChars(char* out) const noexcept {
+	// Work on the unsigned magnitude so INT64_MIN does not overflow
+	uint64_t magnitude = static_cast<uint64_t>(mantissa);
+	if (mantissa < 0) {
+		*out++ = '-';
+		magnitude = ~magnitude + 1;
+	}
+
+	out = std::to_chars(out, out + 20, magnitude / 100000).ptr;
+	*out++ = '.';
+
+	uint32_t fraction = static_cast<uint32_t>(magnitude % 100000);
+	for (int i = 4; i >= 0; --i) {
+		out[i] = static_cast<char>('0' + fraction % 10);
+		fraction /= 10;
+	}
+	return out + 5;
+}
 
 std::ostream& operator<<(std::ostream& os, const Decimal5& d) {
-	return os << d.toDouble();
+	char buffer[Decimal5::MAX_CHARS];
+	return os.write(buffer, d.toChars(buffer) - buffer);
 }
 
 bool isFragmented(uint16_t msgFlags) {
@@ -63,7 +89,8 @@ IncrementalPacketHeader SimbaDecoder::decodeIncrementalPacketHeader(const uint8_
 	LOG_DEBUG("  TransactTime: " << header.transactTime );
 	LOG_DEBUG("  ExchangeTradingSessionID: " << header.exchangeTradingSessionID );
 
-	// Additional information about TransactTime
+#ifndef NDEBUG
+	// Additional information about TransactTime; localtime() alone would cost more than the decode
 	time_t seconds = header.transactTime / 1000000000; // Nanoseconds to seconds
 	struct tm *timeinfo = localtime(&seconds);
 	char buffer[80];
@@ -71,6 +98,7 @@ IncrementalPacketHeader SimbaDecoder::decodeIncrementalPacketHeader(const uint8_
 	LOG_DEBUG("  TransactTime (human-readable): " << buffer 
 			<< "." << std::setfill('0') << std::setw(9) 
 			<< header.transactTime % 1000000000 );
+#endif
 
 	return header;
 }
@@ -117,7 +145,10 @@ SBEHeader SimbaDecoder::decodeSBEHeader(const uint8_t* data) const {
 	return header;
 }
 
-std::optional<DecodedMessage> SimbaDecoder::decodeMessage(const uint8_t* data, size_t length) {
+std::optional<PayloadView> SimbaDecoder::nextPayload(const uint8_t* data, size_t length) {
+	releaseCompletedPayload();
+	++packetCount;
+
 	if (length < sizeof(MarketDataPacketHeader)) {
 		LOG_WARNING("Message too short to contain a valid header" );
 		return std::nullopt;
@@ -135,6 +166,25 @@ std::optional<DecodedMessage> SimbaDecoder::decodeMessage(const uint8_t* data, s
 
 	LOG_DEBUG("sizeof(MarketDataPacketHeader) = " << sizeof(MarketDataPacketHeader) );
 
+	Channel channel = (mdHeader.msgFlags & 0x08) != 0 ? Channel::Incremental : Channel::Snapshot;
+	if (resumeAfterMsgSeqNum) [[unlikely]] {
+		// Restored from a checkpoint without a usable pcap offset: skip what it already covers.
+		// Only the incremental feed is numbered continuously; snapshot numbers restart each cycle
+		if (channel != Channel::Incremental || mdHeader.msgSeqNum <= *resumeAfterMsgSeqNum) {
+			return std::nullopt;
+		}
+		LOG_INFO("Resuming after incremental MsgSeqNum " << *resumeAfterMsgSeqNum << " at " << mdHeader.msgSeqNum);
+		resumeAfterMsgSeqNum.reset();
+	}
+	channelMsgSeqNum[static_cast<size_t>(channel)] = mdHeader.msgSeqNum;
+	lastSendingTime = mdHeader.sendingTime;
+
+	// Buffers of messages whose last fragment never arrived are dropped here, between packets
+	if (++packetsSinceSweep >= FRAGMENT_SWEEP_INTERVAL
+			|| fragmentStats.memoryBytes > fragmentLimits.memoryBudget) [[unlikely]] {
+		evictStaleFragments();
+	}
+
 	bool isIncrementalPacket [[maybe_unused]] = (mdHeader.msgFlags & 0x08) != 0;
 	bool isLastFragment [[maybe_unused]] = (mdHeader.msgFlags & 0x01) != 0;
 	bool isStartOfSnapshot [[maybe_unused]] = (mdHeader.msgFlags & 0x02) != 0;
@@ -155,6 +205,7 @@ std::optional<DecodedMessage> SimbaDecoder::decodeMessage(const uint8_t* data, s
 		}
 		IncrementalPacketHeader incHeader = decodeIncrementalPacketHeader(data + offset);
 		transactTime = incHeader.transactTime;
+		lastTransactTime = transactTime;
 		offset += sizeof(IncrementalPacketHeader);
 
 		LOG_DEBUG("offset = " << offset << " sizeof(IncrementalPacketHeader) = " << sizeof(IncrementalPacketHeader) );
@@ -174,21 +225,281 @@ std::optional<DecodedMessage> SimbaDecoder::decodeMessage(const uint8_t* data, s
 		case TEMPLATE_ID_ORDER_EXECUTION: // OrderExecution
 		case TEMPLATE_ID_ORDER_BOOK_SNAPSHOT: // OrderBookSnapshot
 			break;
+		case TEMPLATE_ID_SECURITY_DEFINITION: // SecurityDefinition: only its SecurityID is used
+			if (length >= offset + sizeof(SBEHeader) + SECURITY_DEFINITION_SECURITY_ID_OFFSET + SIMBA_INT32_SIZE) {
+				instruments.assign(decodeInt32(data + offset + sizeof(SBEHeader) + SECURITY_DEFINITION_SECURITY_ID_OFFSET));
+			}
+			return std::nullopt;
 		default:
 			LOG_DEBUG("Ignoring message with TemplateID: " << sbeHeader.templateId );
 			return std::nullopt;
 	}
 
-	return processFragment(data + offset, length - offset, mdHeader.msgFlags, transactTime, sbeHeader.templateId);
+	auto payload = processFragment(data + offset, length - offset, mdHeader.msgFlags, sbeHeader.templateId);
+	if (payload) {
+		payload->msgSeqNum = mdHeader.msgSeqNum;
+		payload->sendingTime = mdHeader.sendingTime;
+		payload->transactTime = transactTime;
+	}
+	return payload;
 }
 
-std::optional<DecodedMessage> SimbaDecoder::processFragment(const uint8_t* data, size_t length,
-		uint16_t msgFlags, [[maybe_unused]] uint64_t transactTime,
-		uint16_t templateId) {
+void SimbaDecoder::releaseCompletedPayload() {
+	switch (completedPayload) {
+		case CompletedPayload::None:
+			return;
+		case CompletedPayload::OrderUpdateFragments:
+		case CompletedPayload::OrderExecutionFragments:
+			{
+				auto& fragments = completedPayload == CompletedPayload::OrderUpdateFragments
+					? orderUpdateFragments : orderExecutionFragments;
+				auto it = fragments.find(completedPayloadSecurityId);
+				if (it != fragments.end()) {
+					eraseFragment(fragments, it);
+				}
+			}
+			break;
+		case CompletedPayload::Snapshot:
+			{
+				// Clearing the buffer while preserving allocated memory
+				auto it = snapshotFragments.find(completedPayloadSecurityId);
+				if (it != snapshotFragments.end()) {
+					it->second.data.clear();
+				}
+			}
+			break;
+	}
+	completedPayload = CompletedPayload::None;
+}
+
+std::optional<DecodedMessage> SimbaDecoder::decodeMessage(const uint8_t* data, size_t length, uint64_t captureTime) {
+	uint64_t decodeStartTime = latencyTracer ? LatencyTracer::wallClockNs() : 0;
+
+	if (perfCounters) {
+		perfCounters->begin();
+	}
+	auto payload = nextPayload(data, length);
+	if (perfCounters) {
+		perfCounters->end(PerfStage::Reassembly);
+	}
+	if (!payload) {
+		return std::nullopt;
+	}
+
+	if (perfCounters) {
+		perfCounters->begin();
+	}
+	auto result = decodePayload(*payload);
+	if (perfCounters) {
+		perfCounters->end(payload->isSnapshot ? PerfStage::SnapshotDecode : PerfStage::SbeDecode);
+	}
+
+	if (latencyTracer && result) {
+		LatencySample sample;
+		sample.transactTime = payload->transactTime;
+		sample.sendingTime = payload->sendingTime;
+		sample.captureTime = captureTime;
+		sample.decodeStartTime = decodeStartTime;
+		sample.decodeCompleteTime = LatencyTracer::wallClockNs();
+		traceLatency(*result, sample);
+	}
+
+	return result;
+}
+
+bool SimbaDecoder::decodeEvents(const uint8_t* data, size_t length, uint64_t captureTime, std::vector<DecodedEvent>& events) {
+	uint64_t decodeStartTime = latencyTracer ? LatencyTracer::wallClockNs() : 0;
+	events.clear();
+
+	if (perfCounters) {
+		perfCounters->begin();
+	}
+	auto payload = nextPayload(data, length);
+	if (perfCounters) {
+		perfCounters->end(PerfStage::Reassembly);
+	}
+	if (!payload) {
+		return false;
+	}
+
+	if (perfCounters) {
+		perfCounters->begin();
+	}
+	bool sharded = shard.count > 1;
+	messageOrdinals.clear();
+	EventCursor cursor(*this, *payload);
+	DecodedEvent event;
+	while (cursor.next(event)) {
+		events.push_back(event);
+		if (sharded) {
+			messageOrdinals.push_back(cursor.getMessageOrdinal());
+		}
+	}
+	if (perfCounters) {
+		perfCounters->end(payload->isSnapshot ? PerfStage::SnapshotDecode : PerfStage::SbeDecode);
+	}
+
+	if (latencyTracer && !events.empty()) {
+		LatencySample sample;
+		sample.transactTime = payload->transactTime;
+		sample.sendingTime = payload->sendingTime;
+		sample.captureTime = captureTime;
+		sample.decodeStartTime = decodeStartTime;
+		sample.decodeCompleteTime = LatencyTracer::wallClockNs();
+		traceLatency(events, sample);
+	}
+	return !events.empty();
+}
+
+void SimbaDecoder::decodeBatch(const PacketSpan* packets, size_t count, std::vector<std::optional<DecodedMessage>>& results) {
+	results.clear();
+	results.resize(count);
+	batchOrderUpdates.clear();
+	batchOrderExecutions.clear();
+
+	// Reassembly is stateful and runs in packet order. Payloads completed in a fragment
+	// buffer are decoded right away, since the next packet releases the buffer; those
+	// complete in their packet stay valid and are only classified by their first template.
+	if (perfCounters) {
+		perfCounters->begin();
+	}
+	for (size_t i = 0; i < count; ++i) {
+		if (i + BATCH_PREFETCH_DISTANCE < count) {
+			const uint8_t* ahead = packets[i + BATCH_PREFETCH_DISTANCE].data;
+			__builtin_prefetch(ahead);
+			__builtin_prefetch(ahead + 64);
+		}
+		auto payload = nextPayload(packets[i].data, packets[i].length);
+		if (!payload) {
+			continue;
+		}
+		if (payload->isSnapshot || completedPayload != CompletedPayload::None) {
+			results[i] = decodePayload(*payload);
+			continue;
+		}
+		switch (decodeUInt16(payload->data + SIMBA_UINT16_SIZE)) {
+			case TEMPLATE_ID_ORDER_UPDATE:
+				batchOrderUpdates.push_back(BatchEntry{i, payload->data, payload->length});
+				break;
+			case TEMPLATE_ID_ORDER_EXECUTION:
+				batchOrderExecutions.push_back(BatchEntry{i, payload->data, payload->length});
+				break;
+			default:
+				results[i] = decodePayload(*payload);
+				break;
+		}
+	}
+	if (perfCounters) {
+		perfCounters->end(PerfStage::Reassembly);
+		perfCounters->begin();
+	}
+
+	// Reassembly touched the first lines of each payload; fetch the rest of those further ahead
+	auto decodeAll = [&]<typename Message>(const std::vector<BatchEntry>& entries) {
+		for (size_t k = 0; k < entries.size(); ++k) {
+			if (k + BATCH_PREFETCH_DISTANCE < entries.size()) {
+				const BatchEntry& ahead = entries[k + BATCH_PREFETCH_DISTANCE];
+				for (size_t line = 128; line < ahead.length; line += 64) {
+					__builtin_prefetch(ahead.data + line);
+				}
+			}
+			results[entries[k].index] = decodeUniformIncremental<Message>(entries[k].data, entries[k].length);
+		}
+	};
+	decodeAll.template operator()<OrderUpdate>(batchOrderUpdates);
+	decodeAll.template operator()<OrderExecution>(batchOrderExecutions);
+	if (perfCounters) {
+		perfCounters->end(PerfStage::SbeDecode);
+	}
+}
+
+template<typename Message>
+std::optional<DecodedMessage> SimbaDecoder::decodeUniformIncremental(const uint8_t* data, size_t length) const {
+	constexpr uint16_t templateId = std::is_same_v<Message, OrderUpdate> ? TEMPLATE_ID_ORDER_UPDATE : TEMPLATE_ID_ORDER_EXECUTION;
+
+	std::vector<Message> messages;
+	messages.reserve(length / (sizeof(SBEHeader) + sizeof(Message)));
+	size_t offset = 0;
+	// Mirrors EventCursor::nextIncrementalEvent() for payloads of a single template
+	while (offset + sizeof(SBEHeader) <= length) {
+		uint16_t blockLength = decodeUInt16(data + offset);
+		uint16_t blockTemplateId = decodeUInt16(data + offset + SIMBA_UINT16_SIZE);
+		offset += sizeof(SBEHeader);
+		if (offset + blockLength > length) {
+			break;
+		}
+		if (blockTemplateId != templateId || blockLength < sizeof(Message)) [[unlikely]] {
+			return decodeIncrementalPacket(data, length);
+		}
+		if (shard.count > 1 && !ownsBlock(data + offset, templateId, blockLength)) {
+			foreignMessagesSkipped++;
+			offset += blockLength;
+			continue;
+		}
+		if constexpr (std::is_same_v<Message, OrderUpdate>) {
+			messages.push_back(*decodeOrderUpdate(data + offset, blockLength));
+		} else {
+			messages.push_back(*decodeOrderExecution(data + offset, blockLength));
+		}
+		offset += blockLength;
+	}
+
+	if (messages.empty()) {
+		return std::nullopt;
+	}
+	return DecodedMessage(std::move(messages));
+}
+
+std::optional<DecodedMessage> SimbaDecoder::decodePayload(const PayloadView& payload) const {
+	if (!payload.isSnapshot) {
+		return decodeIncrementalPacket(payload.data, payload.length);
+	}
+
+	auto [snapshots, size] = decodeOrderBookSnapshot(payload.data, payload.length);
+	if (snapshots.empty()) {
+		return std::nullopt;
+	}
+	return DecodedMessage(std::move(snapshots));
+}
+
+void SimbaDecoder::traceLatency(const DecodedMessage& message, const LatencySample& sample) const {
+	std::visit([&](const auto& messages) {
+			using T = std::decay_t<decltype(messages)>;
+			uint16_t templateId = TEMPLATE_ID_ORDER_BOOK_SNAPSHOT;
+			if constexpr (std::is_same_v<T, std::vector<OrderUpdate>>) {
+				templateId = TEMPLATE_ID_ORDER_UPDATE;
+			} else if constexpr (std::is_same_v<T, std::vector<OrderExecution>>) {
+				templateId = TEMPLATE_ID_ORDER_EXECUTION;
+			}
+			for (const auto& msg : messages) {
+				latencyTracer->recordMessage(msg.SecurityID, templateId, sample);
+			}
+		}, message);
+}
+
+void SimbaDecoder::traceLatency(const std::vector<DecodedEvent>& events, const LatencySample& sample) const {
+	for (const DecodedEvent& event : events) {
+		switch (event.type) {
+			case DecodedEventType::OrderUpdate:
+				latencyTracer->recordMessage(event.update.SecurityID, TEMPLATE_ID_ORDER_UPDATE, sample);
+				break;
+			case DecodedEventType::OrderExecution:
+				latencyTracer->recordMessage(event.execution.SecurityID, TEMPLATE_ID_ORDER_EXECUTION, sample);
+				break;
+			case DecodedEventType::SnapshotBegin:
+				latencyTracer->recordMessage(event.snapshotBegin.SecurityID, TEMPLATE_ID_ORDER_BOOK_SNAPSHOT, sample);
+				break;
+			case DecodedEventType::SnapshotEntry:
+				break;
+		}
+	}
+}
+
+std::optional<PayloadView> SimbaDecoder::processFragment(const uint8_t* data, size_t length,
+		uint16_t msgFlags, uint16_t templateId) {
 	LOG_DEBUG("Entering processFragment" );
 	LOG_DEBUG("  Length: " << length );
 	LOG_DEBUG("  MsgFlags: 0x" << std::hex << msgFlags << std::dec );
-	LOG_DEBUG("  TransactTime: " << transactTime );
 	LOG_DEBUG("  TemplateId: " << templateId );
 
 	bool isLastFragment = (msgFlags & 0x01) != 0;
@@ -211,7 +522,7 @@ std::optional<DecodedMessage> SimbaDecoder::processFragment(const uint8_t* data,
 	}
 }
 
-std::optional<DecodedMessage> SimbaDecoder::processIncrementalPacket(const uint8_t* data, size_t length,
+std::optional<PayloadView> SimbaDecoder::processIncrementalPacket(const uint8_t* data, size_t length,
 		bool isLastFragment, uint16_t templateId,
 		int32_t securityId) {
 	if (length == 0 || length > ETHERNET_MTU_SIZE) [[unlikely]] {
@@ -220,36 +531,41 @@ std::optional<DecodedMessage> SimbaDecoder::processIncrementalPacket(const uint8
 		return std::nullopt;
 	}
 
-	auto& fragments = (templateId == TEMPLATE_ID_ORDER_UPDATE) ? orderUpdateFragments : orderExecutionFragments;
-	auto& buffer = fragments[securityId].data;
+	bool isOrderUpdate = (templateId == TEMPLATE_ID_ORDER_UPDATE);
+	auto& fragments = isOrderUpdate ? orderUpdateFragments : orderExecutionFragments;
 
 	if (!isLastFragment) {
-		buffer.insert(buffer.end(), data, data + length);
+		auto& buffer = fragments[securityId];
+		appendFragment(buffer, Channel::Incremental, data, length, INITIAL_FRAGMENT_SIZE);
 
 		LOG_DEBUG("Added incremental fragment for SecurityID " << securityId
-				<< ". Total size: " << buffer.size());
+				<< ". Total size: " << buffer.data.size());
 
 		return std::nullopt;
-	} else {
-		if (!buffer.empty()) {
-			buffer.insert(buffer.end(), data, data + length);
-
-			LOG_DEBUG("Processing complete incremental message for SecurityID "
-					<< securityId << ". Size: " << buffer.size());
+	}
 
-			auto result = decodeIncrementalPacket(buffer.data(), buffer.size());
-			fragments.erase(securityId);
-			return result;
-		} else {
-			LOG_DEBUG("Processing complete incremental message for SecurityID "
-					<< securityId << ". Size: " << length);
+	// Complete in one packet: decode in place without touching the fragment map
+	auto it = fragments.find(securityId);
+	if (it == fragments.end() || it->second.data.empty()) {
+		LOG_DEBUG("Processing complete incremental message for SecurityID "
+				<< securityId << ". Size: " << length);
 
-			return decodeIncrementalPacket(data, length);
-		}
+		return PayloadView{data, length, false};
 	}
+
+	appendFragment(it->second, Channel::Incremental, data, length, INITIAL_FRAGMENT_SIZE);
+	const auto& buffer = it->second.data;
+
+	LOG_DEBUG("Processing complete incremental message for SecurityID "
+			<< securityId << ". Size: " << buffer.size());
+
+	// The buffer is released on the next call, once the caller is done with the payload
+	completedPayload = isOrderUpdate ? CompletedPayload::OrderUpdateFragments : CompletedPayload::OrderExecutionFragments;
+	completedPayloadSecurityId = securityId;
+	return PayloadView{buffer.data(), buffer.size(), false};
 }
 
-std::optional<DecodedMessage> SimbaDecoder::processSnapshotPacket(const uint8_t* data, size_t length,
+std::optional<PayloadView> SimbaDecoder::processSnapshotPacket(const uint8_t* data, size_t length,
 		bool isStartOfSnapshot, bool isEndOfSnapshot,
 		[[maybe_unused]] uint16_t templateId,
 		int32_t securityId) {
@@ -268,27 +584,73 @@ std::optional<DecodedMessage> SimbaDecoder::processSnapshotPacket(const uint8_t*
 	}
 	lastProcessedSecurityId = securityId;
 
-	auto& buffer = snapshotFragments[securityId];
+	if (isStartOfSnapshot && (skipUnchangedSnapshots || shard.count > 1)) {
+		int32_t instrument = 0;
+		SnapshotIdentity identity;
+		bool peeked = peekSnapshotIdentity(data, length, instrument, identity);
+		skippingForeignSnapshot = peeked && !ownsInstrument(instrument);
+		skippingSnapshot = false;
+		if (skippingForeignSnapshot) {
+			foreignSnapshotsSkipped++;
+		} else if (skipUnchangedSnapshots) {
+			uint32_t index = peeked ? instruments.find(instrument) : InstrumentIndex::NOT_FOUND;
+			skippingSnapshot = index < lastSnapshots.size() && lastSnapshots[index] == identity;
+			if (skippingSnapshot) {
+				LOG_DEBUG("Skipping unchanged snapshot for SecurityID " << instrument << ", RptSeq " << identity.rptSeq);
+				snapshotsSkipped++;
+			}
+		}
+	}
+	if (skippingSnapshot || skippingForeignSnapshot) {
+		(skippingForeignSnapshot ? foreignSnapshotBytesSkipped : snapshotBytesSkipped) += length;
+		if (isEndOfSnapshot) {
+			skippingSnapshot = false;
+			skippingForeignSnapshot = false;
+		}
+		return std::nullopt;
+	}
+
+	auto& fragment = snapshotFragments[securityId];
 
 	if (isStartOfSnapshot) {
 		LOG_DEBUG(getTimeStamp() << " Started new snapshot for SecurityID " << securityId );
-		buffer.clear();
-		buffer.reserve(INITIAL_RESERVE_SIZE);
+		fragment.data.clear();
+		fragment.gap = false;
+	} else if (fragment.data.empty() || getLastMsgSeqNum(Channel::Snapshot) != fragment.lastMsgSeqNum + 1) {
+		fragment.gap = true;
 	}
 
-	buffer.insert(buffer.end(), data, data + length);
+	appendFragment(fragment, Channel::Snapshot, data, length, isStartOfSnapshot ? INITIAL_RESERVE_SIZE : 0);
+	const auto& buffer = fragment.data;
 
 	if (isEndOfSnapshot) {
 		LOG_DEBUG(getTimeStamp() << " Completing snapshot for SecurityID " << securityId );
 		LOG_DEBUG(getTimeStamp() << " Completed snapshot. Total size: " << buffer.size() );
 
-		auto [snapshots, size] = decodeOrderBookSnapshot(buffer.data(), buffer.size());
-		if (!snapshots.empty()) {
-			totalSnapshotsProcessed++;
-			buffer.clear();  // Clearing the buffer after processing, while preserving allocated memory
-			return DecodedMessage(std::move(snapshots));
+		totalSnapshotsProcessed++;
+
+		if (skipUnchangedSnapshots) {
+			int32_t instrument = 0;
+			SnapshotIdentity identity;
+			if (peekSnapshotIdentity(buffer.data(), buffer.size(), instrument, identity)) {
+				uint32_t index = instruments.assign(instrument);
+				if (index >= lastSnapshots.size()) {
+					lastSnapshots.resize(instruments.size());
+				}
+				// A truncated image must not make the next, complete cycle look unchanged
+				if (fragment.gap) {
+					LOG_DEBUG("Snapshot for SecurityID " << instrument << " missed a fragment; next cycle is not skipped");
+					lastSnapshots[index].reset();
+				} else {
+					lastSnapshots[index] = identity;
+				}
+			}
 		}
-		buffer.clear();  // Clearing the buffer even if decoding failed
+
+		// Cleared (keeping its capacity) on the next call, once the caller is done with the payload
+		completedPayload = CompletedPayload::Snapshot;
+		completedPayloadSecurityId = securityId;
+		return PayloadView{buffer.data(), buffer.size(), true};
 	} else if (!isStartOfSnapshot) {
 		LOG_DEBUG(getTimeStamp() << " Added intermediate fragment for SecurityID " << securityId );
 	}
@@ -296,67 +658,239 @@ std::optional<DecodedMessage> SimbaDecoder::processSnapshotPacket(const uint8_t*
 	return std::nullopt;
 }
 
-std::optional<DecodedMessage> SimbaDecoder::decodeIncrementalPacket(const uint8_t* data, size_t length) const {
-	std::vector<OrderUpdate> updates;
-	std::vector<OrderExecution> executions;
-	size_t offset = 0;
+bool SimbaDecoder::peekSnapshotIdentity(const uint8_t* data, size_t length, int32_t& securityId,
+		SnapshotIdentity& identity) noexcept {
+	// SBE header, then SecurityID, LastMsgSeqNumProcessed, RptSeq, ExchangeTradingSessionID
+	if (length < sizeof(SBEHeader) + 4 * SIMBA_UINT32_SIZE) {
+		return false;
+	}
+	const uint8_t* body = data + sizeof(SBEHeader);
+	securityId = decodeInt32(body);
+	identity.rptSeq = decodeUInt32(body + 2 * SIMBA_UINT32_SIZE);
+	identity.tradingSessionId = decodeUInt32(body + 3 * SIMBA_UINT32_SIZE);
+	return true;
+}
 
+uint32_t SimbaDecoder::shardOf(int32_t securityId, uint32_t count) noexcept {
+	if (count <= 1) {
+		return 0;
+	}
+	// MurmurHash3 finalizer: consecutive SecurityIDs spread evenly over the shards
+	uint32_t hash = static_cast<uint32_t>(securityId);
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+	return hash % count;
+}
+
+bool SimbaDecoder::ownsBlock(const uint8_t* block, uint16_t templateId, uint16_t blockLength) const noexcept {
+	size_t securityIdOffset = templateId == TEMPLATE_ID_ORDER_UPDATE
+		? offsetof(OrderUpdate, SecurityID) : offsetof(OrderExecution, SecurityID);
+	// A block too short to hold its SecurityID is left to the decoder, which reports it
+	return blockLength < securityIdOffset + SIMBA_INT32_SIZE || ownsInstrument(decodeInt32(block + securityIdOffset));
+}
+
+SimbaDecoder::EventCursor::EventCursor(const SimbaDecoder& decoder, const PayloadView& payload) noexcept
+	: decoder(&decoder), data(payload.data), length(payload.length), isSnapshot(payload.isSnapshot),
+	transactTime(payload.transactTime) {}
+
+bool SimbaDecoder::EventCursor::next(DecodedEvent& event) {
+	event.transactTime = transactTime;
+	return isSnapshot ? nextSnapshotEvent(event) : nextIncrementalEvent(event);
+}
+
+void SimbaDecoder::EventCursor::skipForeignMessages() noexcept {
+	while (decoder->shard.count > 1 && offset + sizeof(SBEHeader) <= length) {
+		uint16_t blockLength = decodeUInt16(data + offset);
+		uint16_t templateId = decodeUInt16(data + offset + SIMBA_UINT16_SIZE);
+		const uint8_t* block = data + offset + sizeof(SBEHeader);
+		if ((templateId != TEMPLATE_ID_ORDER_UPDATE && templateId != TEMPLATE_ID_ORDER_EXECUTION)
+				|| offset + sizeof(SBEHeader) + blockLength > length
+				|| decoder->ownsBlock(block, templateId, blockLength)) {
+			return;
+		}
+		decoder->foreignMessagesSkipped++;
+		messagesSeen++;
+		offset += sizeof(SBEHeader) + blockLength;
+	}
+}
+
+bool SimbaDecoder::EventCursor::nextIncrementalEvent(DecodedEvent& event) {
+	skipForeignMessages();
 	while (offset < length) {
 		if (offset + sizeof(SBEHeader) > length) {
 			LOG_DEBUG("Insufficient data for SBE Header. Remaining: " 
 					<< (length - offset) << ", Required: " << sizeof(SBEHeader) );
+			LOG_DEBUG("Warning: " << (length - offset) << " bytes remaining after processing incremental packet" );
+			offset = length;
 			break;
 		}
 
-		SBEHeader sbeHeader = decodeSBEHeader(data + offset);
+		SBEHeader sbeHeader = decoder->decodeSBEHeader(data + offset);
 		offset += sizeof(SBEHeader);
 
 		if (offset + sbeHeader.blockLength > length) {
 			LOG_DEBUG("Insufficient data for message block. Remaining: " 
 					<< (length - offset) << ", Required: " << sbeHeader.blockLength );
+			offset = length;
 			break;
 		}
 
+		const uint8_t* block = data + offset;
+		offset += sbeHeader.blockLength; // Blocks are skipped even if decoding fails
+		eventOrdinal = messagesSeen++;
+
 		switch (sbeHeader.templateId) {
 			case TEMPLATE_ID_ORDER_UPDATE:
-				{
-					std::optional<OrderUpdate> maybeUpdate = decodeOrderUpdate(data + offset, sbeHeader.blockLength);
-					if (maybeUpdate) {
-						updates.push_back(*maybeUpdate);
-						offset += sbeHeader.blockLength;
-					} else {
-						LOG_WARNING("Failed to decode OrderUpdate at offset " << offset);
-						offset += sbeHeader.blockLength; // Skip this block even if decoding failed
-					}
+				if (std::optional<OrderUpdate> maybeUpdate = decoder->decodeOrderUpdate(block, sbeHeader.blockLength)) {
+					event.type = DecodedEventType::OrderUpdate;
+					event.update = *maybeUpdate;
+					skipForeignMessages();
+					event.endOfMessage = offset + sizeof(SBEHeader) > length;
+					return true;
 				}
+				LOG_WARNING("Failed to decode OrderUpdate at offset " << (block - data));
 				break;
 			case TEMPLATE_ID_ORDER_EXECUTION:
-				{
-					std::optional<OrderExecution> maybeExecution = decodeOrderExecution(data + offset, sbeHeader.blockLength);
-					if (maybeExecution) {
-						executions.push_back(*maybeExecution);
-						offset += sbeHeader.blockLength;
-					} else {
-						LOG_WARNING("Failed to decode OrderExecution at offset " << offset);
-						offset += sbeHeader.blockLength; // Skip this block even if decoding failed
-					}
+				if (std::optional<OrderExecution> maybeExecution = decoder->decodeOrderExecution(block, sbeHeader.blockLength)) {
+					event.type = DecodedEventType::OrderExecution;
+					event.execution = *maybeExecution;
+					skipForeignMessages();
+					event.endOfMessage = offset + sizeof(SBEHeader) > length;
+					return true;
 				}
+				LOG_WARNING("Failed to decode OrderExecution at offset " << (block - data));
 				break;
 			default:
 				LOG_DEBUG("Unknown templateId in incremental packet: " << sbeHeader.templateId );
 				// Skipping unknown block
-				offset += sbeHeader.blockLength;
 				break;
 		}
+		skipForeignMessages();
 	}
+	return false;
+}
+
+void SimbaDecoder::EventCursor::skipForeignSnapshots() noexcept {
+	while (decoder->shard.count > 1 && offset + sizeof(SBEHeader) + SNAPSHOT_HEADER_SIZE <= length) {
+		const uint8_t* header = data + offset + sizeof(SBEHeader);
+		size_t entriesSize = static_cast<size_t>(decodeUInt16(header + 4 * SIMBA_UINT32_SIZE))
+			* header[4 * SIMBA_UINT32_SIZE + SIMBA_UINT16_SIZE];
+		size_t end = offset + sizeof(SBEHeader) + SNAPSHOT_HEADER_SIZE + entriesSize;
+		if (end > length || decoder->ownsInstrument(decodeInt32(header))) {
+			return;
+		}
+		decoder->foreignMessagesSkipped++;
+		messagesSeen++;
+		offset = end;
+	}
+}
 
-	if (offset < length) {
-		LOG_DEBUG("Warning: " << (length - offset) << " bytes remaining after processing incremental packet" );
+bool SimbaDecoder::EventCursor::nextSnapshotEvent(DecodedEvent& event) {
+	constexpr size_t MIN_ENTRY_SIZE = 8;  // Minimum size for OrderBookEntry
+
+	if (entriesLeft > 0) {
+		if (entryBlockLength < MIN_ENTRY_SIZE) {
+			LOG_ERROR("Invalid blockLength " << entryBlockLength << " for snapshot entry");
+			entriesLeft = 0;
+			offset = length;
+			return false;
+		}
+
+		event.type = DecodedEventType::SnapshotEntry;
+		event.snapshotEntry = SnapshotEntryEvent{snapshotSecurityId, snapshotRptSeq,
+			decoder->decodeOrderBookEntry(data + offset, entryBlockLength)};
+		offset += entryBlockLength;
+		--entriesLeft;
+		if (entriesLeft == 0) {
+			skipForeignSnapshots();
+		}
+		event.endOfMessage = entriesLeft == 0 && offset + sizeof(SBEHeader) + SNAPSHOT_HEADER_SIZE > length;
+		return true;
+	}
+
+	skipForeignSnapshots();
+	if (offset + sizeof(SBEHeader) + SNAPSHOT_HEADER_SIZE > length) {
+		return false;
+	}
+
+	offset += sizeof(SBEHeader);
+	eventOrdinal = messagesSeen++;
+
+	SnapshotBeginEvent begin;
+	begin.SecurityID = decodeInt32(data + offset);
+	offset += SIMBA_INT32_SIZE;
+	begin.LastMsgSeqNumProcessed = decodeUInt32(data + offset);
+	offset += SIMBA_UINT32_SIZE;
+	begin.RptSeq = decodeUInt32(data + offset);
+	offset += SIMBA_UINT32_SIZE;
+	begin.ExchangeTradingSessionID = decodeUInt32(data + offset);
+	offset += SIMBA_UINT32_SIZE;
+
+	uint16_t blockLength = decodeUInt16(data + offset);
+	offset += SIMBA_UINT16_SIZE;
+	uint8_t noMDEntries = data[offset];
+	offset += SIMBA_UINT8_SIZE;
+
+	LOG_DEBUG("Decoding snapshot for SecurityID: " << begin.SecurityID
+			<< ", NoMDEntries: " << static_cast<int>(noMDEntries)
+			<< ", BlockLength: " << blockLength );
+
+	// Checking for sufficient data for all entries
+	if (offset + static_cast<size_t>(blockLength) * noMDEntries > length) {
+		LOG_WARNING("Incomplete snapshot data for SecurityID: " << begin.SecurityID );
+		offset = length;
+		return false;
+	}
+
+	begin.entryCount = noMDEntries;
+	// Several messages of one instrument in a payload continue the same book image
+	begin.resetBook = !snapshotStarted || begin.SecurityID != snapshotSecurityId;
+
+	snapshotStarted = true;
+	snapshotSecurityId = begin.SecurityID;
+	snapshotRptSeq = begin.RptSeq;
+	entryBlockLength = blockLength;
+	entriesLeft = noMDEntries;
+	if (entriesLeft == 0) {
+		skipForeignSnapshots();
+	}
+
+	event.type = DecodedEventType::SnapshotBegin;
+	event.snapshotBegin = begin;
+	event.endOfMessage = entriesLeft == 0 && offset + sizeof(SBEHeader) + SNAPSHOT_HEADER_SIZE > length;
+	return true;
+}
+
+std::optional<DecodedMessage> SimbaDecoder::decodeIncrementalPacket(const uint8_t* data, size_t length) const {
+	std::vector<OrderUpdate> updates;
+	std::vector<OrderExecution> executions;
+	bool sharded = shard.count > 1;
+	messageOrdinals.clear();
+	executionOrdinals.clear();
+
+	EventCursor cursor(*this, PayloadView{data, length, false});
+	DecodedEvent event;
+	while (cursor.next(event)) {
+		if (event.type == DecodedEventType::OrderUpdate) {
+			updates.push_back(event.update);
+			if (sharded) {
+				messageOrdinals.push_back(cursor.getMessageOrdinal());
+			}
+		} else if (event.type == DecodedEventType::OrderExecution) {
+			executions.push_back(event.execution);
+			if (sharded) {
+				executionOrdinals.push_back(cursor.getMessageOrdinal());
+			}
+		}
 	}
 
 	if (!updates.empty()) {
 		return DecodedMessage(std::move(updates));
 	} else if (!executions.empty()) {
+		messageOrdinals.swap(executionOrdinals);
 		return DecodedMessage(std::move(executions));
 	}
 
@@ -478,69 +1012,31 @@ std::optional<OrderExecution> SimbaDecoder::decodeOrderExecution(const uint8_t*
 
 std::pair<std::vector<OrderBookSnapshot>, size_t> SimbaDecoder::decodeOrderBookSnapshot(const uint8_t* data, size_t length) const {
 	std::vector<OrderBookSnapshot> snapshots;
-	size_t offset = 0;
-	constexpr size_t HEADER_SIZE = 19;  // 4 + 4 + 4 + 4 + 2 + 1
-	constexpr size_t MIN_ENTRY_SIZE = 8;  // Minimum size for OrderBookEntry
-
-	while (offset + HEADER_SIZE <= length) {
-		OrderBookSnapshot snapshot;
-
-		offset += sizeof(SBEHeader);
-
-		size_t initialOffset [[maybe_unused]] = offset;
-
-		snapshot.SecurityID = decodeInt32(data + offset);
-		offset += SIMBA_INT32_SIZE;
-		snapshot.LastMsgSeqNumProcessed = decodeUInt32(data + offset);
-		offset += SIMBA_UINT32_SIZE;
-		snapshot.RptSeq = decodeUInt32(data + offset);
-		offset += SIMBA_UINT32_SIZE;
-		snapshot.ExchangeTradingSessionID = decodeUInt32(data + offset);
-		offset += SIMBA_UINT32_SIZE;
-
-		uint16_t blockLength = decodeUInt16(data + offset);
-		offset += SIMBA_UINT16_SIZE;
-		uint8_t noMDEntries = data[offset];
-		offset += SIMBA_UINT8_SIZE;
-
-		LOG_DEBUG("Decoding snapshot for SecurityID: " << snapshot.SecurityID
-				<< ", NoMDEntries: " << static_cast<int>(noMDEntries)
-				<< ", BlockLength: " << blockLength );
-
-		// Checking for sufficient data for all entries
-		if (offset + blockLength * noMDEntries > length) {
-			LOG_WARNING("Incomplete snapshot data for SecurityID: " << snapshot.SecurityID );
-			break;
-		}
-
-		snapshot.entries.reserve(noMDEntries);
-
-		for (int i = 0; i < noMDEntries; ++i) {
-			if (blockLength < MIN_ENTRY_SIZE) {
-				LOG_ERROR("Invalid blockLength for entry " << i );
-				break;
+	messageOrdinals.clear();
+
+	EventCursor cursor(*this, PayloadView{data, length, true});
+	DecodedEvent event;
+	while (cursor.next(event)) {
+		if (event.type == DecodedEventType::SnapshotBegin) {
+			if (shard.count > 1) {
+				messageOrdinals.push_back(cursor.getMessageOrdinal());
 			}
-
-			snapshot.entries.emplace_back(decodeOrderBookEntry(data + offset, blockLength));
-			offset += blockLength;
-		}
-
-		LOG_DEBUG("Snapshot decoded. Entries: " << snapshot.entries.size()
-				<< ", Bytes processed: " << (offset - initialOffset) );
-
-		snapshots.push_back(std::move(snapshot));
-
-		// Checking for end of data or incomplete next snapshot
-		if (offset + HEADER_SIZE > length) {
-			break;
+			OrderBookSnapshot& snapshot = snapshots.emplace_back();
+			snapshot.SecurityID = event.snapshotBegin.SecurityID;
+			snapshot.LastMsgSeqNumProcessed = event.snapshotBegin.LastMsgSeqNumProcessed;
+			snapshot.RptSeq = event.snapshotBegin.RptSeq;
+			snapshot.ExchangeTradingSessionID = event.snapshotBegin.ExchangeTradingSessionID;
+			snapshot.entries.reserve(event.snapshotBegin.entryCount);
+		} else {
+			snapshots.back().entries.push_back(event.snapshotEntry.entry);
 		}
 	}
 
 	LOG_DEBUG("Total snapshots decoded: " << snapshots.size()
-			<< ", Total bytes processed: " << offset
+			<< ", Total bytes processed: " << cursor.getOffset()
 			<< " out of " << length );
 
-	return {snapshots, offset};
+	return {snapshots, cursor.getOffset()};
 }
 
 OrderBookEntry SimbaDecoder::decodeOrderBookEntry(const uint8_t* data, [[maybe_unused]] size_t length) const {
@@ -633,9 +1129,151 @@ std::string SimbaDecoder::getTimeStamp() {
 	return ss.str();
 }
 
+void SimbaDecoder::restorePendingFragment(FragmentKind kind, int32_t securityId, const uint8_t* data, size_t length) {
+	switch (kind) {
+		case FragmentKind::OrderUpdate:
+		case FragmentKind::OrderExecution:
+			{
+				auto& buffer = (kind == FragmentKind::OrderUpdate ? orderUpdateFragments : orderExecutionFragments)[securityId];
+				buffer.data.clear();
+				appendFragment(buffer, Channel::Incremental, data, length, INITIAL_FRAGMENT_SIZE);
+			}
+			break;
+		case FragmentKind::Snapshot:
+			{
+				auto& buffer = snapshotFragments[securityId];
+				buffer.data.clear();
+				appendFragment(buffer, Channel::Snapshot, data, length, INITIAL_RESERVE_SIZE);
+			}
+			break;
+	}
+}
+
+void SimbaDecoder::appendFragment(FragmentBuffer& buffer, Channel channel, const uint8_t* data, size_t length, size_t initialReserve) {
+	size_t capacity = buffer.data.capacity();
+	if (capacity < initialReserve) {
+		buffer.data.reserve(initialReserve);
+	}
+	buffer.data.insert(buffer.data.end(), data, data + length);
+	buffer.lastMsgSeqNum = getLastMsgSeqNum(channel);
+	buffer.lastSendingTime = lastSendingTime;
+
+	fragmentStats.memoryBytes += buffer.data.capacity() - capacity;
+	fragmentStats.peakMemoryBytes = std::max(fragmentStats.peakMemoryBytes, fragmentStats.memoryBytes);
+}
+
+SimbaDecoder::FragmentMap::iterator SimbaDecoder::eraseFragment(FragmentMap& fragments, FragmentMap::iterator it) {
+	fragmentStats.memoryBytes -= it->second.data.capacity();
+	return fragments.erase(it);
+}
+
+void SimbaDecoder::evictStaleFragments() {
+	packetsSinceSweep = 0;
+
+	auto sweep = [this](FragmentMap& fragments, Channel channel, const char* kind) {
+		uint32_t lastMsgSeqNum = getLastMsgSeqNum(channel);
+		for (auto it = fragments.begin(); it != fragments.end();) {
+			const FragmentBuffer& buffer = it->second;
+			// Unsigned distance, so a MsgSeqNum reset at a new session counts as far away
+			bool bySeqDistance = fragmentLimits.maxSeqDistance != 0
+				&& lastMsgSeqNum - buffer.lastMsgSeqNum > fragmentLimits.maxSeqDistance;
+			bool byAge = fragmentLimits.maxAgeNs != 0 && buffer.lastSendingTime != 0
+				&& lastSendingTime > buffer.lastSendingTime + fragmentLimits.maxAgeNs;
+			if (!bySeqDistance && !byAge) {
+				++it;
+				continue;
+			}
+
+			if (buffer.data.empty()) {
+				fragmentStats.idleBuffersReleased++;
+			} else {
+				(bySeqDistance ? fragmentStats.evictedBySeqDistance : fragmentStats.evictedByAge)++;
+				fragmentStats.evictedBytes += buffer.data.size();
+				LOG_WARNING("Evicting incomplete " << kind << " for SecurityID " << it->first
+						<< ": " << buffer.data.size() << " bytes, last fragment in MsgSeqNum " << buffer.lastMsgSeqNum);
+			}
+			it = eraseFragment(fragments, it);
+		}
+	};
+	sweep(orderUpdateFragments, Channel::Incremental, "OrderUpdate");
+	sweep(orderExecutionFragments, Channel::Incremental, "OrderExecution");
+	sweep(snapshotFragments, Channel::Snapshot, "OrderBookSnapshot");
+
+	enforceFragmentBudget();
+}
+
+void SimbaDecoder::enforceFragmentBudget() {
+	if (fragmentStats.memoryBytes <= fragmentLimits.memoryBudget) {
+		return;
+	}
+
+	struct Candidate {
+		FragmentMap* fragments;
+		int32_t securityId;
+		bool idle;
+		uint32_t distance;
+	};
+	std::vector<Candidate> candidates;
+	auto collect = [&](FragmentMap& fragments, Channel channel) {
+		uint32_t lastMsgSeqNum = getLastMsgSeqNum(channel);
+		for (const auto& [securityId, buffer] : fragments) {
+			candidates.push_back({&fragments, securityId, buffer.data.empty(), lastMsgSeqNum - buffer.lastMsgSeqNum});
+		}
+	};
+	collect(orderUpdateFragments, Channel::Incremental);
+	collect(orderExecutionFragments, Channel::Incremental);
+	collect(snapshotFragments, Channel::Snapshot);
+	// Idle buffers lose nothing, then the least recently appended messages
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+			return a.idle != b.idle ? a.idle : a.distance > b.distance;
+		});
+
+	for (const Candidate& candidate : candidates) {
+		if (fragmentStats.memoryBytes <= fragmentLimits.memoryBudget) {
+			break;
+		}
+		auto it = candidate.fragments->find(candidate.securityId);
+		if (candidate.idle) {
+			fragmentStats.idleBuffersReleased++;
+		} else {
+			fragmentStats.evictedByBudget++;
+			fragmentStats.evictedBytes += it->second.data.size();
+			LOG_WARNING("Evicting incomplete message for SecurityID " << candidate.securityId
+					<< " to stay within the fragment memory budget: " << it->second.data.size() << " bytes");
+		}
+		eraseFragment(*candidate.fragments, it);
+	}
+}
+
+SimbaDecoder::FragmentStats SimbaDecoder::getFragmentStats() const noexcept {
+	FragmentStats stats = fragmentStats;
+	stats.buffers = orderUpdateFragments.size() + orderExecutionFragments.size() + snapshotFragments.size();
+	return stats;
+}
+
 void SimbaDecoder::printStatistics() {
+	if (resumeAfterMsgSeqNum) {
+		LOG_WARNING("No incremental packet after checkpoint MsgSeqNum " << *resumeAfterMsgSeqNum << ", all packets were skipped");
+	}
 	LOG_INFO("Total snapshots processed: " << totalSnapshotsProcessed);
+	FragmentStats stats = getFragmentStats();
+	LOG_INFO("Fragment buffers: " << stats.buffers << " holding " << stats.memoryBytes << " bytes, peak "
+			<< stats.peakMemoryBytes << " bytes (budget " << fragmentLimits.memoryBudget << ")");
+	LOG_INFO("Incomplete messages evicted: " << stats.evictedBySeqDistance << " by MsgSeqNum distance, "
+			<< stats.evictedByAge << " by age, " << stats.evictedByBudget << " by memory budget, "
+			<< stats.evictedBytes << " bytes; idle buffers released: " << stats.idleBuffersReleased);
+	if (instruments.size() > 0) {
+		LOG_INFO("Instruments indexed: " << instruments.size());
+	}
 	LOG_INFO("Mixed snapshots detected: " << mixedSnapshotsDetected);
+	if (shard.count > 1) {
+		LOG_INFO("Shard " << shard.index << " of " << shard.count << ": skipped " << foreignSnapshotsSkipped
+				<< " snapshots (" << foreignSnapshotBytesSkipped << " bytes) and " << foreignMessagesSkipped
+				<< " messages of other shards' instruments");
+	}
+	if (skipUnchangedSnapshots) {
+		LOG_INFO("Unchanged snapshots skipped: " << snapshotsSkipped << " (" << snapshotBytesSkipped << " bytes not copied or decoded)");
+	}
 	if (totalSnapshotsProcessed > 0) {
 		double mixedPercentage = (static_cast<double>(mixedSnapshotsDetected) / totalSnapshotsProcessed) * 100.0;
 		LOG_INFO("Percentage of mixed snapshots: " << std::fixed << std::setprecision(2) << mixedPercentage << "%");
@@ -8,12 +8,14 @@
 #include <optional>
 #include <variant>
 #include <map>
-#include <unordered_map>
 #include <chrono>
 #include <ostream>
 #include <iomanip>
 #include <iostream>
 
+#include "FlatMap.h"
+#include "InstrumentIndex.h"
+
 enum class MDUpdateAction : uint8_t {
 	New = 0,
 	Change = 1,
@@ -33,9 +35,16 @@ struct Decimal5 {
 	int64_t mantissa;
 	static constexpr int exponent = -5;
 
+	// Longest rendering: sign, 15 integer digits, point, 5 fraction digits
+	static constexpr size_t MAX_CHARS = 22;
+
 	[[nodiscard]] constexpr double toDouble() const noexcept {
 		return static_cast<double>(mantissa) / 100000.0;
 	}
+
+	// Writes the exact fixed-point value ("-123.45000") to out and returns the end pointer;
+	// out must have room for MAX_CHARS characters
+	char* toChars(char* out) const noexcept;
 };
 
 std::ostream& operator<<(std::ostream& os, const Decimal5& d);
@@ -110,6 +119,31 @@ struct SBEHeader {
 
 using DecodedMessage = std::variant<std::vector<OrderUpdate>, std::vector<OrderExecution>, std::vector<OrderBookSnapshot>>;
 
+class LatencyTracer;
+class PerfCounters;
+struct LatencySample;
+struct DecodedEvent;
+
+// Complete (reassembled) SBE payload of a packet. It points either into the
+// packet itself or into a decoder fragment buffer and stays valid until the
+// next call into the decoder.
+struct PayloadView {
+	const uint8_t* data;
+	size_t length;
+	bool isSnapshot;
+	uint32_t msgSeqNum = 0;
+	uint64_t sendingTime = 0;
+	uint64_t transactTime = 0;   // 0 for snapshot packets
+};
+
+// SIMBA payload of one packet handed to SimbaDecoder::decodeBatch(); the
+// bytes must stay valid until the call returns
+struct PacketSpan {
+	const uint8_t* data;
+	size_t length;
+	uint64_t captureTime = 0;   // ns since epoch, 0 if unknown
+};
+
 class SimbaDecoder {
 	public:
 		SimbaDecoder() = default;
@@ -120,14 +154,198 @@ class SimbaDecoder {
 		SimbaDecoder(SimbaDecoder&&) = default;
 		SimbaDecoder& operator=(SimbaDecoder&&) = default;
 
-		// Main decoding method
-		[[nodiscard]] std::optional<DecodedMessage> decodeMessage(const uint8_t* data, size_t length);
+		// Main decoding method. captureTime is the pcap timestamp in nanoseconds (0 if unknown).
+		// A DecodedMessage holds one template only: of a packet mixing OrderUpdate and
+		// OrderExecution messages it returns the updates. Consumers that need every message
+		// use decodeEvents().
+		[[nodiscard]] std::optional<DecodedMessage> decodeMessage(const uint8_t* data, size_t length, uint64_t captureTime = 0);
+
+		// Lossless counterpart of decodeMessage(): refills events with every event of the
+		// payload the packet completes, in wire order, the last one marked endOfMessage.
+		// False if the packet completes no payload.
+		bool decodeEvents(const uint8_t* data, size_t length, uint64_t captureTime, std::vector<DecodedEvent>& events);
+
+		// Decodes count packets at once; results[i] is what decodeMessage() would return for
+		// packets[i]. Packets are reassembled in order while the payloads further ahead are
+		// prefetched, then single-packet incrementals are grouped by template and decoded in
+		// one tight loop per template. Latency tracing is per decodeMessage() call only.
+		void decodeBatch(const PacketSpan* packets, size_t count, std::vector<std::optional<DecodedMessage>>& results);
+
+		// Pull-based decoding: reassembles a packet and returns its complete payload, if any,
+		// without decoding it. Events are then read one at a time with an EventCursor.
+		[[nodiscard]] std::optional<PayloadView> nextPayload(const uint8_t* data, size_t length);
+
+		// Decodes a complete payload into per-packet vectors
+		[[nodiscard]] std::optional<DecodedMessage> decodePayload(const PayloadView& payload) const;
+
+		// Walks the messages of one complete payload, decoding each only when asked for
+		class EventCursor {
+			public:
+				EventCursor(const SimbaDecoder& decoder, const PayloadView& payload) noexcept;
+
+				// Decodes the next event into event; false when the payload is exhausted
+				bool next(DecodedEvent& event);
+
+				[[nodiscard]] size_t getOffset() const noexcept { return offset; }
+				// Position in the payload of the SBE message the last event came from
+				[[nodiscard]] uint32_t getMessageOrdinal() const noexcept { return eventOrdinal; }
+
+			private:
+				// SecurityID, LastMsgSeqNumProcessed, RptSeq, ExchangeTradingSessionID, then
+				// the BlockLength and NoMDEntries of the entry group
+				static constexpr size_t SNAPSHOT_HEADER_SIZE = 19;
+
+				bool nextIncrementalEvent(DecodedEvent& event);
+				bool nextSnapshotEvent(DecodedEvent& event);
+				// Step over messages of instruments owned by other shards, so that
+				// endOfMessage is set on the last message this shard decodes
+				void skipForeignMessages() noexcept;
+				void skipForeignSnapshots() noexcept;
+
+				const SimbaDecoder* decoder;
+				const uint8_t* data;
+				size_t length;
+				size_t offset = 0;
+				bool isSnapshot;
+				uint64_t transactTime;
+				uint32_t messagesSeen = 0;    // SBE messages decoded or stepped over
+				uint32_t eventOrdinal = 0;
+
+				// Snapshot state between SnapshotBegin and its entries
+				bool snapshotStarted = false;
+				int32_t snapshotSecurityId = 0;
+				uint32_t snapshotRptSeq = 0;
+				uint16_t entryBlockLength = 0;
+				uint8_t entriesLeft = 0;
+		};
+
+		// Checkpoint support: partially received messages and the last packet sequence number
+		enum class FragmentKind : uint8_t {
+			OrderUpdate = 0,
+			OrderExecution,
+			Snapshot
+		};
+
+		// Calls fn(FragmentKind, int32_t securityId, const std::vector<uint8_t>&) for every
+		// buffer holding an incomplete message
+		template<typename Fn>
+		void forEachPendingFragment(Fn&& fn) const {
+			auto visit = [&](FragmentKind kind, CompletedPayload completed, int32_t securityId, const std::vector<uint8_t>& data) {
+				// The payload returned last is already consumed, it just has not been released yet
+				if (data.empty() || (completedPayload == completed && completedPayloadSecurityId == securityId)) {
+					return;
+				}
+				fn(kind, securityId, data);
+			};
+			for (const auto& [securityId, buffer] : orderUpdateFragments) {
+				visit(FragmentKind::OrderUpdate, CompletedPayload::OrderUpdateFragments, securityId, buffer.data);
+			}
+			for (const auto& [securityId, buffer] : orderExecutionFragments) {
+				visit(FragmentKind::OrderExecution, CompletedPayload::OrderExecutionFragments, securityId, buffer.data);
+			}
+			for (const auto& [securityId, buffer] : snapshotFragments) {
+				visit(FragmentKind::Snapshot, CompletedPayload::Snapshot, securityId, buffer.data);
+			}
+		}
+
+		void restorePendingFragment(FragmentKind kind, int32_t securityId, const uint8_t* data, size_t length);
+
+		// The incremental and snapshot feeds number their packets independently
+		enum class Channel : uint8_t {
+			Incremental = 0,
+			Snapshot
+		};
+
+		// MsgSeqNum of the last packet seen on a channel
+		[[nodiscard]] uint32_t getLastMsgSeqNum(Channel channel) const noexcept {
+			return channelMsgSeqNum[static_cast<size_t>(channel)];
+		}
+		void setLastMsgSeqNum(Channel channel, uint32_t msgSeqNum) noexcept {
+			channelMsgSeqNum[static_cast<size_t>(channel)] = msgSeqNum;
+		}
+
+		// TransactTime (ns since epoch) of the last incremental packet, the exchange time of its
+		// OrderUpdate/OrderExecution messages; those carry no timestamp of their own
+		[[nodiscard]] uint64_t getLastTransactTime() const noexcept { return lastTransactTime; }
+
+		// Drops packets of both channels until the first incremental packet numbered above
+		// msgSeqNum, an incremental MsgSeqNum; used to resume from a checkpoint when the
+		// capture cannot be repositioned by offset
+		void resumeAfter(uint32_t msgSeqNum) { resumeAfterMsgSeqNum = msgSeqNum; }
+
+		// Optional per-message latency tracing; the tracer must outlive the decoder
+		void setLatencyTracer(LatencyTracer* tracer) noexcept { latencyTracer = tracer; }
+
+		// Optional hardware counters around reassembly and decoding in decodeMessage()
+		void setPerfCounters(PerfCounters* counters) noexcept { perfCounters = counters; }
+
+		// Bounds on reassembly buffers. A message whose last fragment is lost would
+		// otherwise pin its buffer forever. Buffers untouched for maxSeqDistance packets
+		// or maxAgeNs of exchange time are evicted (0 disables either check), and if the
+		// buffers still hold more than memoryBudget bytes the least recently used go first.
+		struct FragmentLimits {
+			size_t memoryBudget = 256 * 1024 * 1024;
+			uint32_t maxSeqDistance = 100000;
+			uint64_t maxAgeNs = 60ULL * 1000000000;
+		};
+
+		struct FragmentStats {
+			size_t memoryBytes = 0;              // Capacity of all reassembly buffers
+			size_t peakMemoryBytes = 0;
+			size_t buffers = 0;
+			uint64_t evictedBySeqDistance = 0;   // Incomplete messages dropped, by reason
+			uint64_t evictedByAge = 0;
+			uint64_t evictedByBudget = 0;
+			uint64_t evictedBytes = 0;           // Payload bytes of the dropped messages
+			uint64_t idleBuffersReleased = 0;    // Empty snapshot buffers given back
+		};
+
+		// Snapshot-cycle change detection: a snapshot whose RptSeq and trading session match
+		// the last one completed for its instrument describes an unchanged book, so its
+		// fragments are dropped on arrival, without being copied or decoded
+		void setSkipUnchangedSnapshots(bool enabled) noexcept { skipUnchangedSnapshots = enabled; }
+		[[nodiscard]] uint64_t getSnapshotsSkipped() const noexcept { return snapshotsSkipped; }
+
+		// Dense SecurityID numbering shared with per-instrument consumers. SecurityDefinition
+		// messages register their instrument; setInstruments() preassigns a known universe
+		[[nodiscard]] const InstrumentIndex& getInstruments() const noexcept { return instruments; }
+		void setInstruments(const InstrumentIndex& preassigned) { instruments = preassigned; }
+
+		// Multi-process sharding: a decoder set to shard index of count decodes only the
+		// instruments whose SecurityID hashes to that shard. Snapshots of other instruments
+		// are dropped at their first fragment, and their incremental messages are stepped
+		// over by SBE block length without being decoded
+		struct Shard {
+			uint32_t index = 0;
+			uint32_t count = 1;
+		};
+		void setShard(const Shard& selected) noexcept { shard = selected; }
+		[[nodiscard]] const Shard& getShard() const noexcept { return shard; }
+		// Depends on the SecurityID only, so every process and host agrees on the owner
+		[[nodiscard]] static uint32_t shardOf(int32_t securityId, uint32_t count) noexcept;
+		[[nodiscard]] bool ownsInstrument(int32_t securityId) const noexcept {
+			return shard.count <= 1 || shardOf(securityId, shard.count) == shard.index;
+		}
+
+		// Packets handed to the decoder so far. Every shard reading the same capture counts
+		// the same packets, which orders their exports for simba_shard_merge
+		[[nodiscard]] uint64_t getPacketCount() const noexcept { return packetCount; }
+		// Sharded decoders only: for each message of the last decodeMessage() result, or each
+		// event of the last decodeEvents() call, its
+		// position among all SBE messages of the payload, other shards' included. Orders the
+		// rows of one packet that several shards export
+		[[nodiscard]] const std::vector<uint32_t>& getMessageOrdinals() const noexcept { return messageOrdinals; }
+
+		void setFragmentLimits(const FragmentLimits& limits) noexcept { fragmentLimits = limits; }
+		[[nodiscard]] FragmentStats getFragmentStats() const noexcept;
 
 		void printStatistics();
 
 	private:
 		static constexpr size_t ETHERNET_MTU_SIZE = 1500;
 		static constexpr size_t INITIAL_FRAGMENT_SIZE = 1024 * 64; // 64KB initial size for fragments
+		static constexpr uint32_t FRAGMENT_SWEEP_INTERVAL = 1024;  // Packets between staleness sweeps
+		static constexpr size_t BATCH_PREFETCH_DISTANCE = 4;       // Packets reassembly runs ahead of its prefetches
 
 		static constexpr size_t SIMBA_INT64_SIZE = 8;
 		static constexpr size_t SIMBA_UINT64_SIZE = 8;
@@ -139,40 +357,124 @@ class SimbaDecoder {
 		static constexpr int TEMPLATE_ID_ORDER_UPDATE = 15;
 		static constexpr int TEMPLATE_ID_ORDER_EXECUTION = 16;
 		static constexpr int TEMPLATE_ID_ORDER_BOOK_SNAPSHOT = 17;
+		static constexpr int TEMPLATE_ID_SECURITY_DEFINITION = 18;
+		// SecurityDefinition body: TotNumReports (uint32), Symbol (char[25]), SecurityID
+		static constexpr size_t SECURITY_DEFINITION_SECURITY_ID_OFFSET = 29;
+
+		InstrumentIndex instruments;
 
 		struct FragmentBuffer {
 			std::vector<uint8_t> data;
-
-			FragmentBuffer() { data.reserve(INITIAL_FRAGMENT_SIZE); }
+			uint32_t lastMsgSeqNum = 0;      // Packet that last appended to the buffer, on its channel
+			uint64_t lastSendingTime = 0;
+			bool gap = false;                // Snapshots: a fragment between start and end was missed
 		};
 
-		std::unordered_map<int32_t, FragmentBuffer> orderUpdateFragments;
-		std::unordered_map<int32_t, FragmentBuffer> orderExecutionFragments;
+		// Keyed by the first word of the SBE header (BlockLength | TemplateID << 16), so
+		// each map holds about one entry per message layout: a flat scan beats hashing
+		using FragmentMap = FlatMap<int32_t, FragmentBuffer>;
+		FragmentMap orderUpdateFragments;
+		FragmentMap orderExecutionFragments;
 
 		static constexpr size_t INITIAL_RESERVE_SIZE = 1024 * 1024;
-		std::unordered_map<int32_t, std::vector<uint8_t>> snapshotFragments;    
+		FragmentMap snapshotFragments;
+
+		FragmentLimits fragmentLimits;
+		FragmentStats fragmentStats;
+		uint32_t packetsSinceSweep = 0;
+		uint64_t lastSendingTime = 0;
+
+		// Fragment buffer holding the payload returned last; released on the next call
+		enum class CompletedPayload : uint8_t {
+			None,
+			OrderUpdateFragments,
+			OrderExecutionFragments,
+			Snapshot
+		};
+		CompletedPayload completedPayload = CompletedPayload::None;
+		int32_t completedPayloadSecurityId = 0;
+
+		uint32_t channelMsgSeqNum[2] = {0, 0};   // By Channel
+		uint64_t lastTransactTime = 0;
+		std::optional<uint32_t> resumeAfterMsgSeqNum;
+
+		// Identity of the last completed snapshot of each instrument
+		struct SnapshotIdentity {
+			uint32_t rptSeq = 0;
+			uint32_t tradingSessionId = 0;
+
+			bool operator==(const SnapshotIdentity&) const = default;
+		};
+		static bool peekSnapshotIdentity(const uint8_t* data, size_t length, int32_t& securityId, SnapshotIdentity& identity) noexcept;
+
+		bool skipUnchangedSnapshots = false;
+		bool skippingSnapshot = false;      // Dropping the fragments of an unchanged snapshot
+		std::vector<std::optional<SnapshotIdentity>> lastSnapshots;   // By instrument index
+		uint64_t snapshotsSkipped = 0;
+		uint64_t snapshotBytesSkipped = 0;
+
+		Shard shard;
+		uint64_t packetCount = 0;
+		bool skippingForeignSnapshot = false;   // Dropping the fragments of another shard's snapshot
+		uint64_t foreignSnapshotsSkipped = 0;
+		uint64_t foreignSnapshotBytesSkipped = 0;
+		mutable uint64_t foreignMessagesSkipped = 0;   // Counted by the const decoding paths
+		mutable std::vector<uint32_t> messageOrdinals;
+		mutable std::vector<uint32_t> executionOrdinals;   // Until a payload turns out to hold no updates
+
+		// False for an OrderUpdate/OrderExecution block of an instrument owned by another shard
+		bool ownsBlock(const uint8_t* block, uint16_t templateId, uint16_t blockLength) const noexcept;
 
 		int totalSnapshotsProcessed = 0;
 		int mixedSnapshotsDetected = 0;
 		int32_t lastProcessedSecurityId = -1;
 
+		LatencyTracer* latencyTracer = nullptr;
+		PerfCounters* perfCounters = nullptr;
+
                 MarketDataPacketHeader decodeMarketDataPacketHeader(const uint8_t* data);
                 IncrementalPacketHeader decodeIncrementalPacketHeader(const uint8_t* data);
                 SBEHeader decodeSBEHeader(const uint8_t* data) const;
 
 		std::string getTimeStamp();
 
-		std::optional<DecodedMessage> processFragment(const uint8_t* data, size_t length, uint16_t msgFlags, uint64_t transactTime, uint16_t templateId);
+		void releaseCompletedPayload();
+
+		// Appends to a reassembly buffer, keeping memory accounting and staleness stamps current;
+		// the buffer is stamped with the last MsgSeqNum of the channel that carries its fragments
+		void appendFragment(FragmentBuffer& buffer, Channel channel, const uint8_t* data, size_t length, size_t initialReserve);
+		FragmentMap::iterator eraseFragment(FragmentMap& fragments, FragmentMap::iterator it);
+		void evictStaleFragments();
+		void enforceFragmentBudget();
+
+		std::optional<PayloadView> processFragment(const uint8_t* data, size_t length, uint16_t msgFlags, uint16_t templateId);
 
-		std::optional<DecodedMessage> processIncrementalPacket(const uint8_t* data, size_t length, bool isLastFragment, uint16_t templateId,int32_t securityId);
+		std::optional<PayloadView> processIncrementalPacket(const uint8_t* data, size_t length, bool isLastFragment, uint16_t templateId,int32_t securityId);
 
-		std::optional<DecodedMessage> processSnapshotPacket(const uint8_t* data, size_t length,
+		std::optional<PayloadView> processSnapshotPacket(const uint8_t* data, size_t length,
 				bool isStartOfSnapshot, bool isEndOfSnapshot,
 				uint16_t templateId,
 				int32_t securityId);
 
+		void traceLatency(const DecodedMessage& message, const LatencySample& sample) const;
+		void traceLatency(const std::vector<DecodedEvent>& events, const LatencySample& sample) const;
+
 		std::optional<DecodedMessage> decodeIncrementalPacket(const uint8_t* data, size_t length) const;
 
+		// decodeBatch(): in-place payloads of one template, decoded after reassembly
+		struct BatchEntry {
+			size_t index;             // Into the batch
+			const uint8_t* data;
+			size_t length;
+		};
+		std::vector<BatchEntry> batchOrderUpdates;
+		std::vector<BatchEntry> batchOrderExecutions;
+
+		// Decodes a payload made of Message blocks only; any other block falls back to
+		// decodeIncrementalPacket(), so the result is always the same
+		template<typename Message>
+		std::optional<DecodedMessage> decodeUniformIncremental(const uint8_t* data, size_t length) const;
+
 		// Specialized decoding methods
 		std::optional<OrderUpdate> decodeOrderUpdate(const uint8_t* data, size_t length) const;
 		std::optional<OrderExecution> decodeOrderExecution(const uint8_t* data, size_t length) const;
@@ -0,0 +1,33 @@
+#include "SimbaEvents.h"
+
+#include "PCAPParser.h"
+#include "log.h"
+
+namespace simba {
+
+// filename is taken by value: it must live in the coroutine frame
+Generator<DecodedEvent> events(std::string filename) {
+	PCAPParser parser(filename);
+	if (!parser.isValid()) {
+		LOG_ERROR("Failed to initialize PCAPParser for " << filename);
+		co_return;
+	}
+
+	SimbaDecoder decoder;
+	CapturedPacket packet;
+	DecodedEvent event;
+
+	while (parser.nextPacket(packet)) {
+		std::optional<PayloadView> payload = decoder.nextPayload(packet.data, packet.length);
+		if (!payload) {
+			continue;
+		}
+
+		SimbaDecoder::EventCursor cursor(decoder, *payload);
+		while (cursor.next(event)) {
+			co_yield event;
+		}
+	}
+}
+
+} // namespace simba
@@ -0,0 +1,25 @@
+// SimbaEvents.h
+
+#ifndef SIMBA_EVENTS_H
+#define SIMBA_EVENTS_H
+
+#include <string>
+
+#include "DecodedEvent.h"
+#include "Generator.h"
+
+namespace simba {
+
+// Lazily decoded events of a pcap capture:
+//
+//   for (const DecodedEvent& ev : simba::events("file.pcap")) { ... }
+//
+// Packets are read and decoded only as the consumer advances, one event at a
+// time and without per-packet vectors. Breaking out of the loop (or a
+// std::views::take_while) stops reading the file immediately. The reference
+// is valid until the next increment.
+Generator<DecodedEvent> events(std::string filename);
+
+} // namespace simba
+
+#endif // SIMBA_EVENTS_H
@@ -0,0 +1,307 @@
+#include "TextExporter.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "log.h"
+
+TextExporter::TextExporter(const std::string& filename, ExportFormat format, ExportContent content, size_t bufferSize)
+	: format(format), content(content), buffer(std::max(bufferSize, MAX_ROW_SIZE * 4), "export buffer") {
+	bufferStart = static_cast<char*>(buffer.data());
+	bufferEnd = bufferStart ? bufferStart + buffer.size() : nullptr;
+	cursor = bufferStart;
+	if (!bufferStart) {
+		return;
+	}
+
+	fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		LOG_ERROR("Cannot open export file " << filename << ": " << std::strerror(errno));
+		return;
+	}
+	LOG_INFO("Exporting " << (content == ExportContent::Bars ? "bars"
+			: content == ExportContent::TopOfBook ? "conflated top of book"
+			: content == ExportContent::ShardedEvents ? "decoded messages of one shard" : "decoded messages") << " to " << filename << " as " << (format == ExportFormat::Csv ? "CSV" : "JSONL"));
+
+	writeHeader();
+}
+
+TextExporter::~TextExporter() {
+	if (isValid()) {
+		flush();
+		close(fd);
+		LOG_INFO("Exported " << rowsWritten << " rows");
+	}
+}
+
+void TextExporter::flush() {
+	const char* data = bufferStart;
+	size_t remaining = static_cast<size_t>(cursor - data);
+	while (remaining > 0) {
+		ssize_t written = ::write(fd, data, remaining);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOG_ERROR("Export write failed: " << std::strerror(errno));
+			break;
+		}
+		data += written;
+		remaining -= static_cast<size_t>(written);
+	}
+	cursor = bufferStart;
+}
+
+void TextExporter::writeHeader() {
+	if (format == ExportFormat::Csv && content == ExportContent::Bars) {
+		append("type,security_id,interval,start_time,open,high,low,close,volume,vwap,trades\n");
+	} else if (format == ExportFormat::Csv && content == ExportContent::TopOfBook) {
+		append("type,security_id,rpt_seq,bid_px,bid_size,bid_orders,ask_px,ask_size,ask_orders,"
+				"last_px,last_qty,transact_time,updates\n");
+	} else if (format == ExportFormat::Csv) {
+		if (content == ExportContent::ShardedEvents) {
+			append("packet,ordinal,");
+		}
+		append("type,security_id,rpt_seq,md_entry_id,update_action,entry_type,px,size,"
+				"last_px,last_qty,trade_id,transact_time,md_flags,md_flags2\n");
+	}
+}
+
+void TextExporter::beginRow(std::string_view type) {
+	if (static_cast<size_t>(bufferEnd - cursor) < MAX_ROW_SIZE) [[unlikely]] {
+		flush();
+	}
+
+	if (format == ExportFormat::Csv) {
+		if (content == ExportContent::ShardedEvents) {
+			appendInteger(orderKey);
+			*cursor++ = ',';
+			appendInteger(messageOrdinal);
+			*cursor++ = ',';
+		}
+		append(type);
+	} else {
+		if (content == ExportContent::ShardedEvents) {
+			append("{\"packet\":");
+			appendInteger(orderKey);
+			append(",\"ordinal\":");
+			appendInteger(messageOrdinal);
+			append(",\"type\":\"");
+		} else {
+			append("{\"type\":\"");
+		}
+		append(type);
+		append("\"");
+	}
+}
+
+void TextExporter::endRow() {
+	append(format == ExportFormat::Csv ? "\n" : "}\n");
+	rowsWritten++;
+}
+
+void TextExporter::appendSeparator(std::string_view name) {
+	if (format == ExportFormat::Csv) {
+		*cursor++ = ',';
+	} else {
+		append(",\"");
+		append(name);
+		append("\":");
+	}
+}
+
+void TextExporter::appendField(std::string_view name, int64_t value) {
+	appendSeparator(name);
+	appendInteger(value);
+}
+
+void TextExporter::appendField(std::string_view name, uint64_t value) {
+	appendSeparator(name);
+	appendInteger(value);
+}
+
+void TextExporter::appendField(std::string_view name, Decimal5 value) {
+	appendSeparator(name);
+	cursor = value.toChars(cursor);
+}
+
+void TextExporter::appendField(std::string_view name, char value) {
+	appendSeparator(name);
+	if (format == ExportFormat::Csv) {
+		if (value == ',' || value == '"' || value == '\n' || value == '\r') {
+			// Quoted, with a quote doubled
+			*cursor++ = '"';
+			if (value == '"') {
+				*cursor++ = '"';
+			}
+			*cursor++ = value;
+			*cursor++ = '"';
+		} else {
+			*cursor++ = value;
+		}
+		return;
+	}
+
+	*cursor++ = '"';
+	auto byte = static_cast<unsigned char>(value);
+	if (value == '"' || value == '\\') {
+		*cursor++ = '\\';
+		*cursor++ = value;
+	} else if (byte < 0x20 || byte >= 0x7F) {
+		// Control characters are not allowed in a JSON string, lone non-ASCII bytes are not UTF-8
+		static constexpr char HEX[] = "0123456789abcdef";
+		append("\\u00");
+		*cursor++ = HEX[byte >> 4];
+		*cursor++ = HEX[byte & 0xF];
+	} else {
+		*cursor++ = value;
+	}
+	*cursor++ = '"';
+}
+
+void TextExporter::appendEmptyField([[maybe_unused]] std::string_view name) {
+	if (format == ExportFormat::Csv) {
+		*cursor++ = ',';
+	}
+}
+
+void TextExporter::appendTransactTime(uint64_t transactTime) {
+	if (transactTime != 0) {
+		appendField("transact_time", transactTime);
+	} else {
+		appendEmptyField("transact_time");
+	}
+}
+
+void TextExporter::write(const OrderUpdate& update, uint64_t transactTime) {
+	beginRow("update");
+	appendField("security_id", int64_t{update.SecurityID});
+	appendField("rpt_seq", uint64_t{update.RptSeq});
+	appendField("md_entry_id", int64_t{update.MDEntryID});
+	appendField("update_action", uint64_t{static_cast<uint8_t>(update.UpdateAction)});
+	appendField("entry_type", static_cast<char>(update.EntryType));
+	appendField("px", update.MDEntryPx);
+	appendField("size", int64_t{update.MDEntrySize});
+	appendEmptyField("last_px");
+	appendEmptyField("last_qty");
+	appendEmptyField("trade_id");
+	appendTransactTime(transactTime);
+	appendField("md_flags", uint64_t{update.MDFlags});
+	appendField("md_flags2", uint64_t{update.MDFlags2});
+	endRow();
+}
+
+void TextExporter::write(const OrderExecution& execution, uint64_t transactTime) {
+	beginRow("execution");
+	appendField("security_id", int64_t{execution.SecurityID});
+	appendField("rpt_seq", uint64_t{execution.RptSeq});
+	appendField("md_entry_id", int64_t{execution.MDEntryID});
+	appendField("update_action", uint64_t{static_cast<uint8_t>(execution.UpdateAction)});
+	appendField("entry_type", static_cast<char>(execution.EntryType));
+	appendField("px", execution.MDEntryPx);
+	appendField("size", int64_t{execution.MDEntrySize});
+	appendField("last_px", execution.LastPx);
+	appendField("last_qty", int64_t{execution.LastQty});
+	appendField("trade_id", int64_t{execution.TradeID});
+	appendTransactTime(transactTime);
+	appendField("md_flags", uint64_t{execution.MDFlags});
+	appendField("md_flags2", uint64_t{execution.MDFlags2});
+	endRow();
+}
+
+void TextExporter::appendEntry(int32_t securityId, uint32_t rptSeq, const OrderBookEntry& entry) {
+	beginRow("entry");
+	appendField("security_id", int64_t{securityId});
+	appendField("rpt_seq", uint64_t{rptSeq});
+	appendField("md_entry_id", int64_t{entry.MDEntryID});
+	appendEmptyField("update_action");
+	appendField("entry_type", static_cast<char>(entry.EntryType));
+	appendField("px", entry.MDEntryPx);
+	appendField("size", int64_t{entry.MDEntrySize});
+	appendEmptyField("last_px");
+	appendEmptyField("last_qty");
+	appendField("trade_id", int64_t{entry.TradeID});
+	appendField("transact_time", uint64_t{entry.TransactTime});
+	appendField("md_flags", uint64_t{entry.MDFlags});
+	appendField("md_flags2", uint64_t{entry.MDFlags2});
+	endRow();
+}
+
+void TextExporter::write(const OrderBookSnapshot& snapshot) {
+	for (const OrderBookEntry& entry : snapshot.entries) {
+		appendEntry(snapshot.SecurityID, snapshot.RptSeq, entry);
+	}
+}
+
+void TextExporter::write(const DecodedEvent& event) {
+	switch (event.type) {
+		case DecodedEventType::OrderUpdate:
+			write(event.update, event.transactTime);
+			break;
+		case DecodedEventType::OrderExecution:
+			write(event.execution, event.transactTime);
+			break;
+		case DecodedEventType::SnapshotEntry:
+			appendEntry(event.snapshotEntry.SecurityID, event.snapshotEntry.RptSeq, event.snapshotEntry.entry);
+			break;
+		case DecodedEventType::SnapshotBegin:
+			break;
+	}
+}
+
+void TextExporter::write(const std::vector<DecodedEvent>& events) {
+	for (size_t i = 0; i < events.size(); ++i) {
+		messageOrdinal = i < messageOrdinals.size() ? messageOrdinals[i] : 0;
+		write(events[i]);
+	}
+}
+
+void TextExporter::write(const Bar& bar) {
+	beginRow("bar");
+	appendField("security_id", int64_t{bar.securityId});
+	appendField("interval", bar.interval);
+	appendField("start_time", bar.startTime);
+	appendField("open", bar.open);
+	appendField("high", bar.high);
+	appendField("low", bar.low);
+	appendField("close", bar.close);
+	appendField("volume", int64_t{bar.volume});
+	appendField("vwap", bar.vwap());
+	appendField("trades", uint64_t{bar.tradeCount});
+	endRow();
+}
+
+void TextExporter::write(const TopOfBook& top) {
+	beginRow("tob");
+	appendField("security_id", int64_t{top.securityId});
+	appendField("rpt_seq", uint64_t{top.rptSeq});
+	if (top.bidSize > 0) {
+		appendField("bid_px", top.bidPrice);
+		appendField("bid_size", int64_t{top.bidSize});
+		appendField("bid_orders", uint64_t{top.bidOrders});
+	} else {
+		appendEmptyField("bid_px");
+		appendEmptyField("bid_size");
+		appendEmptyField("bid_orders");
+	}
+	if (top.askSize > 0) {
+		appendField("ask_px", top.askPrice);
+		appendField("ask_size", int64_t{top.askSize});
+		appendField("ask_orders", uint64_t{top.askOrders});
+	} else {
+		appendEmptyField("ask_px");
+		appendEmptyField("ask_size");
+		appendEmptyField("ask_orders");
+	}
+	if (top.lastQty > 0) {
+		appendField("last_px", top.lastPrice);
+		appendField("last_qty", int64_t{top.lastQty});
+	} else {
+		appendEmptyField("last_px");
+		appendEmptyField("last_qty");
+	}
+	appendField("transact_time", top.transactTime);
+	appendField("updates", top.updates);
+	endRow();
+}
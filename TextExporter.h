@@ -0,0 +1,121 @@
+// TextExporter.h
+
+#ifndef TEXT_EXPORTER_H
+#define TEXT_EXPORTER_H
+
+#include <charconv>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BarAggregator.h"
+#include "DecodedEvent.h"
+#include "Placement.h"
+#include "SimbaDecoder.h"
+#include "TopOfBookConflator.h"
+
+enum class ExportFormat {
+	Csv,
+	Jsonl
+};
+
+// What a file holds; selects the CSV header
+enum class ExportContent {
+	Events,
+	ShardedEvents,   // Events led by a "packet,ordinal" order key, merged by simba_shard_merge
+	Bars,
+	TopOfBook
+};
+
+// Allocation-free CSV/JSONL writer for decoded messages. Rows are formatted
+// with std::to_chars straight into one large reusable buffer which is handed
+// to write(2) when full; prices are rendered exactly from the Decimal5 mantissa.
+//
+// All row kinds share one schema; fields that do not apply to a kind are left
+// empty (CSV) or omitted (JSONL). Snapshot entries are written as "entry" rows
+// carrying the SecurityID and RptSeq of their snapshot. Bars go to files of
+// their own (ExportContent::Bars) with a bar schema, and so do conflated
+// top-of-book rows (ExportContent::TopOfBook). The export of one shard
+// (ExportContent::ShardedEvents) leads every row with the order key last set:
+// the packet and the position of the row's message within it.
+class TextExporter {
+	public:
+		static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+		TextExporter(const std::string& filename, ExportFormat format,
+				ExportContent content = ExportContent::Events, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+		~TextExporter();
+
+		TextExporter(const TextExporter&) = delete;
+		TextExporter& operator=(const TextExporter&) = delete;
+
+		bool isValid() const { return fd >= 0 && buffer.data() != nullptr; }
+
+		// Rows for every event of one payload (SimbaDecoder::decodeEvents())
+		void write(const std::vector<DecodedEvent>& events);
+		// transactTime is the packet's TransactTime, written when non-zero
+		void write(const OrderUpdate& update, uint64_t transactTime = 0);
+		void write(const OrderExecution& execution, uint64_t transactTime = 0);
+		void write(const OrderBookSnapshot& snapshot);
+		void write(const DecodedEvent& event);
+		void write(const Bar& bar);
+		void write(const TopOfBook& top);
+
+		void flush();
+
+		// Order key of the rows that follow, written by ExportContent::ShardedEvents only:
+		// the packet, and for each event of the next write(events) its message's ordinal
+		// within the packet (SimbaDecoder::getMessageOrdinals()); missing ordinals are 0
+		void setOrderKey(uint64_t packet, std::span<const uint32_t> ordinals = {}) noexcept {
+			orderKey = packet;
+			messageOrdinals = ordinals;
+			messageOrdinal = 0;
+		}
+
+		[[nodiscard]] uint64_t getRowsWritten() const noexcept { return rowsWritten; }
+
+	private:
+		// Upper bound of one formatted row, checked once per row instead of per field
+		static constexpr size_t MAX_ROW_SIZE = 512;
+
+		void beginRow(std::string_view type);
+		void endRow();
+
+		void appendField(std::string_view name, int64_t value);
+		void appendField(std::string_view name, uint64_t value);
+		void appendField(std::string_view name, Decimal5 value);
+		void appendField(std::string_view name, char value);
+		void appendEmptyField(std::string_view name);
+		void appendTransactTime(uint64_t transactTime);
+		void appendEntry(int32_t securityId, uint32_t rptSeq, const OrderBookEntry& entry);
+
+		void appendSeparator(std::string_view name);
+
+		void append(std::string_view text) noexcept {
+			std::memcpy(cursor, text.data(), text.size());
+			cursor += text.size();
+		}
+
+		template<typename Int>
+		void appendInteger(Int value) noexcept {
+			cursor = std::to_chars(cursor, cursor + 24, value).ptr;
+		}
+
+		void writeHeader();
+
+		int fd = -1;
+		ExportFormat format;
+		ExportContent content;
+		HugePageBuffer buffer;
+		char* bufferStart = nullptr;
+		char* bufferEnd = nullptr;
+		char* cursor = nullptr;
+		uint64_t rowsWritten = 0;
+		uint64_t orderKey = 0;
+		std::span<const uint32_t> messageOrdinals;
+		uint32_t messageOrdinal = 0;
+};
+
+#endif // TEXT_EXPORTER_H
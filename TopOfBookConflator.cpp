@@ -0,0 +1,197 @@
+#include "TopOfBookConflator.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <variant>
+
+#include "Placement.h"
+#include "log.h"
+
+TopOfBookConflator::TopOfBookConflator(uint32_t maxInstruments)
+	: maxInstruments(maxInstruments), slots(std::make_unique<Slot[]>(maxInstruments)) {
+	latest.reserve(std::min<uint32_t>(maxInstruments, 1024));
+}
+
+TopOfBookConflator::~TopOfBookConflator() {
+	stop();
+}
+
+void TopOfBookConflator::addConsumer(const std::string& name, TopOfBookConsumer onUpdate, uint64_t periodNs) {
+	auto consumer = std::make_unique<Consumer>();
+	consumer->name = name;
+	consumer->onUpdate = std::move(onUpdate);
+	consumer->periodNs = periodNs;
+	uint32_t capacity = std::bit_ceil(std::max<uint32_t>(maxInstruments, 1));
+	consumer->dirty = std::make_unique<std::atomic<uint8_t>[]>(maxInstruments);
+	consumer->queue = std::make_unique<uint32_t[]>(capacity);
+	consumer->mask = capacity - 1;
+	consumers.push_back(std::move(consumer));
+}
+
+void TopOfBookConflator::start() {
+	running = true;
+	for (size_t i = 0; i < consumers.size(); ++i) {
+		consumers[i]->thread = std::thread(&TopOfBookConflator::run, this, std::ref(*consumers[i]));
+		Placement::pinThread(consumers[i]->thread, ThreadRole::Consumer, i);
+	}
+	LOG_INFO("Conflated top of book started with " << consumers.size() << " consumers, "
+			<< maxInstruments << " instrument slots");
+}
+
+TopOfBook* TopOfBookConflator::latestFor(int32_t securityId, uint32_t& index) {
+	index = slotIndex.find(securityId);
+	if (index != InstrumentIndex::NOT_FOUND) [[likely]] {
+		return &latest[index];
+	}
+
+	if (slotIndex.size() >= maxInstruments) {
+		if (!overflowReported) {
+			LOG_WARNING("Top of book slots are full (" << maxInstruments << " instruments), SecurityID "
+					<< securityId << " and later ones are not published");
+			overflowReported = true;
+		}
+		return nullptr;
+	}
+
+	index = slotIndex.assign(securityId);
+	latest.emplace_back();
+	latest.back().securityId = securityId;
+	return &latest.back();
+}
+
+void TopOfBookConflator::onEvents(const std::vector<DecodedEvent>& events, const std::vector<int32_t>& changed,
+		const OrderBookManager& books) {
+	touched.clear();
+	uint32_t index;
+	for (const DecodedEvent& event : events) {
+		if (event.type != DecodedEventType::OrderExecution) {
+			continue;
+		}
+		const OrderExecution& execution = event.execution;
+		TopOfBook* top = latestFor(execution.SecurityID, index);
+		if (!top) {
+			continue;
+		}
+		top->lastPrice = execution.LastPx;
+		top->lastQty = execution.LastQty;
+		top->updates++;
+		if (std::find(touched.begin(), touched.end(), index) == touched.end()) {
+			touched.push_back(index);
+		}
+	}
+
+	for (int32_t securityId : changed) {
+		TopOfBook* top = latestFor(securityId, index);
+		const OrderBook* book = books.find(securityId);
+		if (!top || !book) {
+			continue;
+		}
+		PriceLevel bid{0, 0, 0};
+		PriceLevel ask{0, 0, 0};
+		book->topLevels(MDEntryType::Bid, &bid, 1);
+		book->topLevels(MDEntryType::Offer, &ask, 1);
+		top->rptSeq = book->getRptSeq();
+		top->bidPrice = Decimal5{bid.price};
+		top->bidSize = bid.size;
+		top->bidOrders = bid.orders;
+		top->askPrice = Decimal5{ask.price};
+		top->askSize = ask.size;
+		top->askOrders = ask.orders;
+		top->updates++;
+		if (std::find(touched.begin(), touched.end(), index) == touched.end()) {
+			touched.push_back(index);
+		}
+	}
+
+	// Every event of a payload carries the packet's TransactTime, 0 for snapshots
+	uint64_t transactTime = events.empty() ? 0 : events.front().transactTime;
+	for (uint32_t slot : touched) {
+		if (transactTime != 0) {
+			latest[slot].transactTime = transactTime;
+		}
+		publish(slot);
+	}
+}
+
+void TopOfBookConflator::publish(uint32_t index) {
+	Slot& slot = slots[index];
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.value = latest[index];
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	published++;
+
+	for (auto& consumer : consumers) {
+		// The exchange pairs with the consumer's, which clears the flag before reading the
+		// slot: either the consumer sees this update or the slot is queued again
+		if (consumer->dirty[index].exchange(1, std::memory_order_acq_rel)) {
+			consumer->conflated++;
+			continue;
+		}
+		uint64_t head = consumer->head.load(std::memory_order_relaxed);
+		consumer->queue[head & consumer->mask] = index;
+		consumer->head.store(head + 1, std::memory_order_release);
+		consumer->notified++;
+	}
+}
+
+void TopOfBookConflator::read(uint32_t index, TopOfBook& out) const noexcept {
+	const Slot& slot = slots[index];
+	for (;;) {
+		uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence & 1) {
+			continue;
+		}
+		out = slot.value;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+			return;
+		}
+	}
+}
+
+void TopOfBookConflator::run(Consumer& consumer) const {
+	TopOfBook top;
+	for (;;) {
+		// Read before the queue: once closed, everything published is already queued
+		bool finished = closed.load(std::memory_order_acquire);
+		uint64_t head = consumer.head.load(std::memory_order_acquire);
+		consumer.maxDepth = std::max(consumer.maxDepth, head - consumer.tail);
+		bool drained = consumer.tail < head;
+		for (; consumer.tail < head; ++consumer.tail) {
+			uint32_t index = consumer.queue[consumer.tail & consumer.mask];
+			consumer.dirty[index].exchange(0, std::memory_order_acq_rel);
+			read(index, top);
+			consumer.onUpdate(top);
+			consumer.delivered++;
+		}
+		if (finished) {
+			return;
+		}
+		if (consumer.periodNs > 0) {
+			std::this_thread::sleep_for(std::chrono::nanoseconds(consumer.periodNs));
+		} else if (!drained) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TopOfBookConflator::stop() {
+	if (!running) {
+		return;
+	}
+	closed.store(true, std::memory_order_release);
+	for (auto& consumer : consumers) {
+		consumer->thread.join();
+	}
+	running = false;
+}
+
+void TopOfBookConflator::printStatistics() const {
+	LOG_INFO("Top of book: " << slotIndex.size() << " instruments, " << published << " updates published");
+	for (const auto& consumer : consumers) {
+		LOG_INFO("Top of book consumer " << consumer->name << ": delivered " << consumer->delivered
+				<< ", conflated " << consumer->conflated << " updates, max queue depth " << consumer->maxDepth);
+	}
+}
@@ -0,0 +1,117 @@
+// TopOfBookConflator.h
+
+#ifndef TOP_OF_BOOK_CONFLATOR_H
+#define TOP_OF_BOOK_CONFLATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "InstrumentIndex.h"
+#include "OrderBook.h"
+#include "SimbaDecoder.h"
+
+// Latest best bid/offer and last trade of an instrument. An empty side has
+// size 0 and price 0.
+struct TopOfBook {
+	int32_t securityId = 0;
+	uint32_t rptSeq = 0;
+	Decimal5 bidPrice{0};
+	int64_t bidSize = 0;
+	uint32_t bidOrders = 0;
+	uint32_t askOrders = 0;
+	Decimal5 askPrice{0};
+	int64_t askSize = 0;
+	Decimal5 lastPrice{0};
+	int64_t lastQty = 0;         // 0 until the first trade
+	uint64_t transactTime = 0;   // TransactTime of the last incremental packet that touched the instrument
+	uint64_t updates = 0;        // Book changes and trades folded in since the start
+};
+
+// Conflated top-of-book stream for consumers that cannot keep up with every
+// OrderUpdate (GUIs, risk). The decoding thread overwrites one latest-value
+// slot per instrument, guarded by a seqlock, and queues the instrument as
+// dirty for every consumer that has not been told about it yet. Each consumer
+// thread drains its dirty queue at its own pace and reads the slot, so it
+// always sees the freshest state; updates made meanwhile are folded into the
+// one pending notification. An instrument is queued at most once per
+// consumer, so queues are bounded by the instrument count and the decoder
+// never waits for a consumer, however slow.
+class TopOfBookConflator {
+	public:
+		static constexpr uint32_t DEFAULT_MAX_INSTRUMENTS = 16384;
+
+		using TopOfBookConsumer = std::function<void(const TopOfBook&)>;
+
+		explicit TopOfBookConflator(uint32_t maxInstruments = DEFAULT_MAX_INSTRUMENTS);
+		~TopOfBookConflator();
+
+		TopOfBookConflator(const TopOfBookConflator&) = delete;
+		TopOfBookConflator& operator=(const TopOfBookConflator&) = delete;
+
+		// Consumers must be added before start(). A consumer with a period drains its
+		// queue at most once per periodNs, e.g. at a screen's refresh rate; otherwise
+		// it drains as fast as onUpdate returns. Threads are pinned like fan-out consumers.
+		void addConsumer(const std::string& name, TopOfBookConsumer onUpdate, uint64_t periodNs = 0);
+
+		void start();
+
+		// Decoding thread, after a payload's events were applied to books; changed as filled
+		// by OrderBookManager::apply. Execution events become the last trade, and the events'
+		// TransactTime the instruments' time; snapshots keep the time they had.
+		void onEvents(const std::vector<DecodedEvent>& events, const std::vector<int32_t>& changed,
+				const OrderBookManager& books);
+
+		// Waits until every consumer has drained its queue, so each one ends with the final state
+		void stop();
+
+		void printStatistics() const;
+
+	private:
+		struct alignas(64) Slot {
+			std::atomic<uint32_t> sequence{0};   // Odd while the decoding thread updates the slot
+			TopOfBook value;
+		};
+
+		// Single-producer, single-consumer queue of slot indices. Capacity covers every
+		// slot, and a slot is queued at most once, so a push always succeeds.
+		struct Consumer {
+			std::string name;
+			TopOfBookConsumer onUpdate;
+			uint64_t periodNs = 0;
+			std::unique_ptr<std::atomic<uint8_t>[]> dirty;
+			std::unique_ptr<uint32_t[]> queue;
+			uint32_t mask = 0;
+			alignas(64) std::atomic<uint64_t> head{0};   // Written by the decoding thread
+			alignas(64) uint64_t tail = 0;               // Consumer thread
+			uint64_t delivered = 0;
+			uint64_t maxDepth = 0;
+			alignas(64) uint64_t notified = 0;           // Decoding thread: queue pushes
+			uint64_t conflated = 0;                      // Decoding thread: updates folded into a pending one
+			std::thread thread;
+		};
+
+		void publish(uint32_t index);
+		void run(Consumer& consumer) const;
+		void read(uint32_t index, TopOfBook& out) const noexcept;
+
+		// Slot of securityId on the decoding thread, or nullptr once all slots are taken
+		TopOfBook* latestFor(int32_t securityId, uint32_t& index);
+
+		uint32_t maxInstruments;
+		std::unique_ptr<Slot[]> slots;
+		InstrumentIndex slotIndex;
+		std::vector<TopOfBook> latest;   // Decoding thread's copy of every slot
+		std::vector<uint32_t> touched;   // Slots changed by the current message
+		std::vector<std::unique_ptr<Consumer>> consumers;
+		std::atomic<bool> closed{false};
+		bool running = false;
+		bool overflowReported = false;
+		uint64_t published = 0;
+};
+
+#endif // TOP_OF_BOOK_CONFLATOR_H
@@ -1,6 +1,7 @@
 #include "log.h"
 
 std::ofstream Logger::log_file;
+bool Logger::enabled = true;
 
 void Logger::init_log(const std::string& filename) {
     log_file.open(filename, std::ios::out | std::ios::app);
@@ -9,11 +9,16 @@
 class Logger {
 private:
     static std::ofstream log_file;
+    static bool enabled;
 
 public:
     static void init_log(const std::string& filename);
     static void close_log();
 
+    // Drops every message, before it is formatted, while disabled (e.g. inside a benchmark)
+    static void set_enabled(bool on) { enabled = on; }
+    static bool is_enabled() { return enabled; }
+
     template<typename... Args>
     static void log(const std::string& level, const Args&... args) {
         if (log_file.is_open()) {
@@ -30,9 +35,11 @@ private:
 
 #define LOG_IMPL(level, ...) \
     do { \
-        std::ostringstream log_stream; \
-        log_stream << __VA_ARGS__; \
-        Logger::log(level, log_stream.str()); \
+        if (Logger::is_enabled()) { \
+            std::ostringstream log_stream; \
+            log_stream << __VA_ARGS__; \
+            Logger::log(level, log_stream.str()); \
+        } \
     } while(0)
 
 #ifdef NDEBUG
@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AsyncPcapReader.h"
+#include "BarAggregator.h"
+#include "Benchmark.h"
+#include "BookIndex.h"
+#include "Checkpoint.h"
+#include "EventFanout.h"
+#include "LatencyTracer.h"
+#include "MultiPcapReader.h"
+#include "OrderBook.h"
+#include "PCAPParser.h"
+#include "PcapStreamReader.h"
+#include "PcapngReader.h"
+#include "PerfCounters.h"
+#include "Placement.h"
+#include "ShmBookPublisher.h"
+#include "SimbaDecoder.h"
+#include "TextExporter.h"
+#include "TopOfBookConflator.h"
+#include "log.h"
+
+// Parses the whole of text as a number of type T; false on junk, a sign T cannot hold or overflow
+template<typename T>
+static bool parseNumber(std::string_view text, T& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <pcap_file|directory|glob>...\n"
+              << "Inputs may be pcap (micro- or nanosecond) or pcapng captures.\n"
+              << "Several captures, a directory of *.pcap/*.pcapng files or a quoted glob are merged by capture time;\n"
+              << "'-' or a FIFO is read as a stream, e.g. tcpdump -w - | " << program << " -\n"
+              << "gzip and zstd compressed captures (.pcap.gz, .pcap.zst) are decompressed on the fly\n"
+              << "Options:\n"
+              << "  --bench                     Preload the capture and report decode throughput over repeated passes\n"
+              << "  --bench-iterations <count>  Measured passes in --bench mode (default 5)\n"
+              << "  --bench-batch <packets>     Decode --bench passes with decodeBatch() in batches of <packets>\n"
+              << "  --bench-latency-passes <n>  Further passes timing every packet for the percentiles (default 1)\n"
+              << "  --latency                   Trace per-message latency and report it at exit\n"
+              << "  --perf-counters             Count cycles, instructions and cache/branch misses per stage\n"
+              << "  --fanout                    Run consumers on their own threads behind a broadcast ring\n"
+              << "  --fanout-lossy              As --fanout, but slow consumers skip events instead of stalling decoding\n"
+              << "                              (not with --shm-books)\n"
+              << "  --shm-books <name>          Publish order books to POSIX shared memory <name>\n"
+              << "  --csv <file>                Export decoded messages as CSV\n"
+              << "  --jsonl <file>              Export decoded messages as JSON lines\n"
+              << "  --bars <interval>           Aggregate executions into OHLCV/VWAP bars (250ms, 1s, 5m, 1h; repeatable)\n"
+              << "  --bars-out <file>           Write closed bars to <file>, as CSV unless --jsonl is given\n"
+              << "  --checkpoint <file>         Restore state from <file> and checkpoint into it periodically\n"
+              << "  --checkpoint-every <count>  Decoded messages between checkpoints (default 100000)\n"
+              << "  --book-index <file>         Write per-instrument book images for simba_book_query (single capture)\n"
+              << "  --book-index-interval <int> TransactTime between book index boundaries (default 10s)\n"
+              << "  --top-of-book <file>        Write a conflated BBO/last trade stream, drained on its own thread\n"
+              << "  --top-of-book-period <int>  Drain the top-of-book stream at most once per interval (e.g. 100ms)\n"
+              << "  --skip-unchanged-snapshots  Drop snapshots whose RptSeq has not moved since the last cycle\n"
+              << "  --fragment-budget <MB>      Memory bound for reassembly buffers (default 256)\n"
+              << "  --instruments <file>        Preassign instruments listed in <file> (SecurityID[,...] per line)\n"
+              << "  --reader-core <core>        Pin the reading and decoding thread to <core>\n"
+              << "  --prefetch-core <core>      Pin the multi-file read-ahead thread to <core>\n"
+              << "  --consumer-cores <list>     Pin fan-out consumers to cores, e.g. 2,4-6 (round robin)\n"
+              << "  --numa-node <node>          Allocate memory on <node> (default: node of --reader-core)\n"
+              << "  --huge-pages                Back large buffers with 2 MB pages, falling back to normal pages\n"
+              << "  --direct-io                 Read a single pcap file with O_DIRECT and io_uring (cold captures)\n"
+              << "  --shard <i>/<K>             Decode only instruments of shard i of K (SecurityID hash); exported rows\n"
+              << "                              carry a packet and ordinal key for simba_shard_merge, the log goes to simba.shard<i>.log"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> inputSpecs;
+    std::string checkpointFile;
+    uint64_t checkpointEvery = 100000;
+    std::string shmBooksName;
+    std::string exportFile;
+    ExportFormat exportFormat = ExportFormat::Csv;
+    bool traceLatency = false;
+    bool perfCounters = false;
+    bool fanout = false;
+    bool fanoutLossy = false;
+    SimbaDecoder::FragmentLimits fragmentLimits;
+    std::vector<uint64_t> barIntervals;
+    PlacementConfig placement;
+    bool skipUnchangedSnapshots = false;
+    std::string instrumentsFile;
+    bool configurePlacement = false;
+    std::string barsFile;
+    bool bench = false;
+    BenchmarkConfig benchConfig;
+    std::string bookIndexFile;
+    uint64_t bookIndexInterval = 10ULL * 1000000000;
+    std::string topOfBookFile;
+    uint64_t topOfBookPeriod = 0;
+    bool directIo = false;
+    SimbaDecoder::Shard shard;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--bench-iterations" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], benchConfig.iterations)) {
+                std::cerr << "Invalid benchmark iteration count: " << argv[i] << std::endl;
+                return 1;
+            }
+            benchConfig.iterations = std::max(1u, benchConfig.iterations);
+        } else if (arg == "--bench-latency-passes" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], benchConfig.latencyIterations)) {
+                std::cerr << "Invalid benchmark latency pass count: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--bench-batch" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], benchConfig.batchSize)) {
+                std::cerr << "Invalid benchmark batch size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--latency") {
+            traceLatency = true;
+        } else if (arg == "--perf-counters") {
+            perfCounters = true;
+        } else if (arg == "--fanout") {
+            fanout = true;
+        } else if (arg == "--fanout-lossy") {
+            fanout = true;
+            fanoutLossy = true;
+        } else if (arg == "--shm-books" && i + 1 < argc) {
+            shmBooksName = argv[++i];
+        } else if ((arg == "--csv" || arg == "--jsonl") && i + 1 < argc) {
+            exportFormat = (arg == "--csv") ? ExportFormat::Csv : ExportFormat::Jsonl;
+            exportFile = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointFile = argv[++i];
+        } else if (arg == "--checkpoint-every" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], checkpointEvery)) {
+                std::cerr << "Invalid checkpoint interval: " << argv[i] << std::endl;
+                return 1;
+            }
+            checkpointEvery = std::max<uint64_t>(1, checkpointEvery);
+        } else if (arg == "--bars" && i + 1 < argc) {
+            auto interval = BarAggregator::parseInterval(argv[++i]);
+            if (!interval) {
+                std::cerr << "Invalid bar interval: " << argv[i] << std::endl;
+                return 1;
+            }
+            barIntervals.push_back(*interval);
+        } else if (arg == "--book-index" && i + 1 < argc) {
+            bookIndexFile = argv[++i];
+        } else if (arg == "--book-index-interval" && i + 1 < argc) {
+            auto interval = BarAggregator::parseInterval(argv[++i]);
+            if (!interval) {
+                std::cerr << "Invalid book index interval: " << argv[i] << std::endl;
+                return 1;
+            }
+            bookIndexInterval = *interval;
+        } else if (arg == "--top-of-book" && i + 1 < argc) {
+            topOfBookFile = argv[++i];
+        } else if (arg == "--top-of-book-period" && i + 1 < argc) {
+            auto period = BarAggregator::parseInterval(argv[++i]);
+            if (!period) {
+                std::cerr << "Invalid top-of-book period: " << argv[i] << std::endl;
+                return 1;
+            }
+            topOfBookPeriod = *period;
+        } else if (arg == "--bars-out" && i + 1 < argc) {
+            barsFile = argv[++i];
+        } else if (arg == "--reader-core" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], placement.readerCore) || placement.readerCore < 0) {
+                std::cerr << "Invalid reader core: " << argv[i] << std::endl;
+                return 1;
+            }
+            configurePlacement = true;
+        } else if (arg == "--prefetch-core" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], placement.prefetchCore) || placement.prefetchCore < 0) {
+                std::cerr << "Invalid prefetch core: " << argv[i] << std::endl;
+                return 1;
+            }
+            configurePlacement = true;
+        } else if (arg == "--consumer-cores" && i + 1 < argc) {
+            if (!Placement::parseCoreList(argv[++i], placement.consumerCores)) {
+                std::cerr << "Invalid core list: " << argv[i] << std::endl;
+                return 1;
+            }
+            configurePlacement = true;
+        } else if (arg == "--numa-node" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], placement.numaNode) || placement.numaNode < 0) {
+                std::cerr << "Invalid NUMA node: " << argv[i] << std::endl;
+                return 1;
+            }
+            configurePlacement = true;
+        } else if (arg == "--huge-pages") {
+            placement.hugePages = true;
+            configurePlacement = true;
+        } else if (arg == "--direct-io") {
+            directIo = true;
+        } else if (arg == "--shard" && i + 1 < argc) {
+            std::string_view spec = argv[++i];
+            size_t slash = spec.find('/');
+            if (slash == std::string_view::npos || !parseNumber(spec.substr(0, slash), shard.index)
+                    || !parseNumber(spec.substr(slash + 1), shard.count)) {
+                std::cerr << "Invalid shard, expected <index>/<count>: " << spec << std::endl;
+                return 1;
+            }
+            if (shard.count == 0 || shard.index >= shard.count) {
+                std::cerr << "Shard index must be below the shard count: " << spec << std::endl;
+                return 1;
+            }
+        } else if (arg == "--skip-unchanged-snapshots") {
+            skipUnchangedSnapshots = true;
+        } else if (arg == "--instruments" && i + 1 < argc) {
+            instrumentsFile = argv[++i];
+        } else if (arg == "--fragment-budget" && i + 1 < argc) {
+            size_t megabytes = 0;
+            if (!parseNumber(argv[++i], megabytes) || megabytes > std::numeric_limits<size_t>::max() / (1024 * 1024)) {
+                std::cerr << "Invalid fragment budget: " << argv[i] << std::endl;
+                return 1;
+            }
+            fragmentLimits.memoryBudget = megabytes * 1024 * 1024;
+        } else if (!arg.starts_with("--")) {
+            inputSpecs.push_back(arg);
+        } else {
+            inputSpecs.clear();
+            break;
+        }
+    }
+
+    std::vector<std::string> pcapFiles;
+    for (const std::string& spec : inputSpecs) {
+        std::vector<std::string> expanded = MultiPcapReader::expandInputs(spec);
+        pcapFiles.insert(pcapFiles.end(), expanded.begin(), expanded.end());
+    }
+    if (pcapFiles.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (fanout && !checkpointFile.empty()) {
+        // Books are owned by a consumer thread in fan-out mode
+        std::cerr << "--checkpoint cannot be combined with --fanout" << std::endl;
+        return 1;
+    }
+    if (!bookIndexFile.empty() && (fanout || !checkpointFile.empty() || pcapFiles.size() != 1)) {
+        // Boundaries record offsets into one capture decoded from its start, with books on this thread
+        std::cerr << "--book-index needs a single capture and cannot be combined with --fanout or --checkpoint" << std::endl;
+        return 1;
+    }
+    if (fanout && !barIntervals.empty()) {
+        // Bars are aggregated on the decoding thread, which only publishes in fan-out mode
+        std::cerr << "--bars cannot be combined with --fanout" << std::endl;
+        return 1;
+    }
+    if (shard.count > 1 && (fanout || !checkpointFile.empty())) {
+        // Exported rows are keyed by the decoder's packet count, which neither carries across threads nor restarts
+        std::cerr << "--shard cannot be combined with --fanout or --checkpoint" << std::endl;
+        return 1;
+    }
+    if (fanoutLossy && !shmBooksName.empty()) {
+        // A lapped consumer would go on applying events to books that missed some, and publish them
+        std::cerr << "--shm-books cannot be combined with --fanout-lossy" << std::endl;
+        return 1;
+    }
+    if (fanout && !topOfBookFile.empty()) {
+        // The conflated stream is fed from books applied on the decoding thread
+        std::cerr << "--top-of-book cannot be combined with --fanout" << std::endl;
+        return 1;
+    }
+
+    // Shards of one capture usually run side by side in one directory
+    Logger::init_log(shard.count > 1 ? "simba.shard" + std::to_string(shard.index) + ".log" : "simba.log");
+
+    // Before any buffer or thread is created, so all of them inherit the placement
+    if (configurePlacement && !Placement::configure(placement)) {
+        LOG_WARNING("Continuing with partial CPU/memory placement");
+    }
+
+    // A single capture is read directly, so checkpoints can record and seek to a file offset
+    std::string pcapFile = pcapFiles.size() == 1 ? pcapFiles.front() : std::string();
+    std::unique_ptr<SeekablePacketSource> parser;
+    std::unique_ptr<MultiPcapReader> multiReader;
+    std::unique_ptr<PcapStreamReader> streamReader;
+    PacketSource* source = nullptr;
+    if (directIo && (pcapFile.empty() || PcapStreamReader::needsStreaming(pcapFile)
+            || PcapngReader::isPcapngFile(pcapFile))) {
+        LOG_WARNING("--direct-io applies to a single uncompressed pcap file, ignored");
+    }
+    if (!pcapFile.empty() && PcapStreamReader::needsStreaming(pcapFile)) {
+        streamReader = std::make_unique<PcapStreamReader>(pcapFile);
+        if (!streamReader->isValid()) {
+            LOG_ERROR("Failed to read a pcap stream from " << pcapFile);
+            Logger::close_log();
+            return 1;
+        }
+        source = streamReader.get();
+    } else if (!pcapFile.empty()) {
+        if (PcapngReader::isPcapngFile(pcapFile)) {
+            parser = std::make_unique<PcapngReader>(pcapFile);
+        } else if (directIo) {
+            parser = std::make_unique<AsyncPcapReader>(pcapFile);
+        } else {
+            parser = std::make_unique<PCAPParser>(pcapFile);
+        }
+        if (!parser->isValid()) {
+            LOG_ERROR("Failed to initialize the capture reader");
+            Logger::close_log();
+            return 1;
+        }
+        source = parser.get();
+    } else {
+        if (std::any_of(pcapFiles.begin(), pcapFiles.end(), PcapStreamReader::isStream)) {
+            LOG_ERROR("A stream cannot be merged with other inputs");
+            Logger::close_log();
+            return 1;
+        }
+        multiReader = std::make_unique<MultiPcapReader>(pcapFiles);
+        if (!multiReader->isValid()) {
+            LOG_ERROR("None of the " << pcapFiles.size() << " input files is a readable capture");
+            Logger::close_log();
+            return 1;
+        }
+        source = multiReader.get();
+    }
+
+    InstrumentIndex instruments;
+    if (!instrumentsFile.empty() && !instruments.loadFile(instrumentsFile)) {
+        Logger::close_log();
+        return 1;
+    }
+    auto setupDecoder = [&](SimbaDecoder& target) {
+        target.setFragmentLimits(fragmentLimits);
+        target.setSkipUnchangedSnapshots(skipUnchangedSnapshots);
+        target.setInstruments(instruments);
+        target.setShard(shard);
+    };
+    SimbaDecoder decoder;
+    setupDecoder(decoder);
+
+    if (bench) {
+        // Decoder only: exporters, books, checkpoints and tracing are not part of the measurement
+        Benchmark benchmark(benchConfig);
+        bool loaded = benchmark.load(*source);
+        parser.reset();
+        multiReader.reset();
+        streamReader.reset();
+        if (!loaded) {
+            LOG_ERROR("No packets to benchmark");
+            Logger::close_log();
+            return 1;
+        }
+        Benchmark::printReport(benchmark.run(setupDecoder));
+        Logger::close_log();
+        return 0;
+    }
+
+    OrderBookManager books;
+    books.reserve(decoder.getInstruments().size());
+    if (!checkpointFile.empty()) {
+        CheckpointInfo checkpoint;
+        if (Checkpoint::restore(checkpointFile, decoder, books, checkpoint)) {
+            // Same capture: continue right after the checkpointed packet, otherwise by sequence number
+            if (parser && checkpoint.pcapFile == pcapFile && checkpoint.pcapFileSize <= parser->getFileSize()
+                    && parser->seek(checkpoint.pcapOffset)) {
+                LOG_INFO("Resuming " << pcapFile << " at offset " << checkpoint.pcapOffset);
+            } else {
+                LOG_INFO("Resuming after incremental MsgSeqNum " << checkpoint.lastIncrementalMsgSeqNum);
+                decoder.resumeAfter(checkpoint.lastIncrementalMsgSeqNum);
+            }
+        } else {
+            // Never continue from a partially restored state
+            decoder = SimbaDecoder();
+            setupDecoder(decoder);
+            books = OrderBookManager();
+            books.reserve(decoder.getInstruments().size());
+        }
+    }
+
+    LatencyTracer latencyTracer;
+    if (traceLatency) {
+        latencyTracer.reserve(decoder.getInstruments().size());
+        decoder.setLatencyTracer(&latencyTracer);
+    }
+
+    std::unique_ptr<PerfCounters> counters;
+    if (perfCounters) {
+        counters = std::make_unique<PerfCounters>();
+        if (counters->isValid()) {
+            decoder.setPerfCounters(counters.get());
+            if (parser) {
+                parser->setPerfCounters(counters.get());
+            } else if (multiReader) {
+                multiReader->setPerfCounters(counters.get());
+            }
+        }
+    }
+
+    std::unique_ptr<ShmBookPublisher> shmPublisher;
+    if (!shmBooksName.empty()) {
+        shmPublisher = std::make_unique<ShmBookPublisher>(shmBooksName);
+        if (!shmPublisher->isValid()) {
+            Logger::close_log();
+            return 1;
+        }
+    }
+
+    std::unique_ptr<TextExporter> exporter;
+    if (!exportFile.empty()) {
+        exporter = std::make_unique<TextExporter>(exportFile, exportFormat,
+                shard.count > 1 ? ExportContent::ShardedEvents : ExportContent::Events);
+        if (!exporter->isValid()) {
+            Logger::close_log();
+            return 1;
+        }
+    }
+
+    // Merged inputs have no single file offset and resume by sequence number only
+    auto saveCheckpoint = [&]() {
+        Checkpoint::save(checkpointFile, decoder, books, pcapFile,
+                parser ? parser->position() : 0, parser ? parser->getFileSize() : 0);
+    };
+
+    std::unique_ptr<TextExporter> barExporter;
+    if (!barsFile.empty() && !barIntervals.empty()) {
+        barExporter = std::make_unique<TextExporter>(barsFile, exportFile.empty() ? ExportFormat::Csv : exportFormat,
+                ExportContent::Bars);
+        if (!barExporter->isValid()) {
+            Logger::close_log();
+            return 1;
+        }
+    }
+    std::vector<std::unique_ptr<BarAggregator>> barAggregators;
+    for (uint64_t interval : barIntervals) {
+        BarHandler onClose;
+        if (barExporter) {
+            onClose = [&](const Bar& bar) { barExporter->write(bar); };
+        }
+        barAggregators.push_back(std::make_unique<BarAggregator>(interval, std::move(onClose)));
+        barAggregators.back()->reserve(decoder.getInstruments().size());
+    }
+
+    std::unique_ptr<BookIndexWriter> bookIndex;
+    if (!bookIndexFile.empty()) {
+        if (!parser) {
+            LOG_ERROR("--book-index needs a seekable capture file, not a stream or compressed input");
+            Logger::close_log();
+            return 1;
+        }
+        bookIndex = std::make_unique<BookIndexWriter>(bookIndexFile, bookIndexInterval, pcapFile,
+                parser->getFileSize(), parser->position());
+        if (!bookIndex->isValid()) {
+            Logger::close_log();
+            return 1;
+        }
+    }
+
+    // The exporter is written by the conflator's consumer thread only, and outlives it
+    std::unique_ptr<TextExporter> topOfBookExporter;
+    std::unique_ptr<TopOfBookConflator> conflator;
+    if (!topOfBookFile.empty()) {
+        topOfBookExporter = std::make_unique<TextExporter>(topOfBookFile,
+                exportFile.empty() ? ExportFormat::Csv : exportFormat, ExportContent::TopOfBook);
+        if (!topOfBookExporter->isValid()) {
+            Logger::close_log();
+            return 1;
+        }
+        conflator = std::make_unique<TopOfBookConflator>();
+        conflator->addConsumer("top-of-book", [&](const TopOfBook& top) {
+                topOfBookExporter->write(top);
+            }, topOfBookPeriod);
+        conflator->start();
+    }
+
+    std::vector<int32_t> changedBooks;
+    uint64_t messagesSinceCheckpoint = 0;
+    EventHandler handler;
+    EventFanout eventFanout(fanoutLossy);
+    if (fanout) {
+        // Every consumer runs on its own thread, fed from one broadcast ring
+        if (shmPublisher) {
+            eventFanout.addConsumer("shm-books", [&](const DecodedEvent& event) {
+                    books.apply(event);
+                    int32_t securityId = event.securityId();
+                    if (std::find(changedBooks.begin(), changedBooks.end(), securityId) == changedBooks.end()) {
+                        changedBooks.push_back(securityId);
+                    }
+                    if (event.endOfMessage) {
+                        for (int32_t changed : changedBooks) {
+                            shmPublisher->publish(changed, *books.find(changed));
+                        }
+                        changedBooks.clear();
+                    }
+                });
+        }
+        if (exporter) {
+            eventFanout.addConsumer("exporter", [&](const DecodedEvent& event) {
+                    exporter->write(event);
+                });
+        }
+        eventFanout.start();
+        handler = [&](const std::vector<DecodedEvent>& events) {
+            eventFanout.publish(events);
+        };
+    } else if (shmPublisher || exporter || !checkpointFile.empty() || !barAggregators.empty() || bookIndex
+            || conflator) {
+        handler = [&](const std::vector<DecodedEvent>& events) {
+            if (shmPublisher || !checkpointFile.empty() || bookIndex || conflator) {
+                books.apply(events, changedBooks);
+            }
+            if (conflator) {
+                conflator->onEvents(events, changedBooks, books);
+            }
+            if (bookIndex) {
+                bookIndex->onMessage(changedBooks, books, decoder.getLastTransactTime(), decoder.getLastMsgSeqNum(SimbaDecoder::Channel::Incremental),
+                        parser->position());
+            }
+            if (shmPublisher) {
+                for (int32_t securityId : changedBooks) {
+                    shmPublisher->publish(securityId, *books.find(securityId));
+                }
+            }
+            if (exporter) {
+                exporter->setOrderKey(decoder.getPacketCount(), decoder.getMessageOrdinals());
+                exporter->write(events);
+            }
+            if (!barAggregators.empty()) {
+                for (const DecodedEvent& event : events) {
+                    if (event.type != DecodedEventType::OrderExecution) {
+                        continue;
+                    }
+                    for (const auto& aggregator : barAggregators) {
+                        aggregator->onExecution(event.execution, decoder.getLastTransactTime());
+                    }
+                }
+            }
+            // Called between packets, so the parser position is the first packet not yet applied
+            if (!checkpointFile.empty() && ++messagesSinceCheckpoint >= checkpointEvery) {
+                saveCheckpoint();
+                messagesSinceCheckpoint = 0;
+            }
+        };
+    }
+
+    decodePacketEvents(*source, decoder, handler);
+    if (!checkpointFile.empty()) {
+        saveCheckpoint();
+    }
+    if (bookIndex && !bookIndex->finish(books, decoder.getLastTransactTime(), decoder.getLastMsgSeqNum(SimbaDecoder::Channel::Incremental),
+            parser->position())) {
+        Logger::close_log();
+        return 1;
+    }
+    if (fanout) {
+        eventFanout.stop();
+        eventFanout.printStatistics();
+    }
+    if (conflator) {
+        conflator->stop();
+        conflator->printStatistics();
+    }
+
+    for (const auto& aggregator : barAggregators) {
+        aggregator->closeAll();
+        LOG_INFO("Bars of " << aggregator->getInterval() << " ns: " << aggregator->getBarsClosed() << " closed, "
+                << aggregator->getLateTrades() << " late trades folded into a later bar");
+    }
+
+    decoder.printStatistics();
+    if (traceLatency) {
+        latencyTracer.printReport();
+    }
+    if (counters) {
+        counters->printReport();
+    }
+
+    Logger::close_log();
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BookIndex.h"
+#include "DecodedEvent.h"
+#include "OrderBook.h"
+#include "PCAPParser.h"
+#include "PacketPeek.h"
+#include "PcapExtractor.h"
+#include "PcapngReader.h"
+#include "SimbaDecoder.h"
+#include "log.h"
+
+// Parses the whole of text as a number of type T; false on junk, a sign T cannot hold or overflow
+template<typename T>
+static bool parseNumber(std::string_view text, T& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] --index <file> --security-id <id> (--at <seconds> | --rpt-seq <n>)\n"
+              << "Prints the order book of one instrument at a point in time, from a book index written by\n"
+              << "simba_decoder --book-index and at most one index interval of the capture\n"
+              << "Options:\n"
+              << "  --at <seconds>      TransactTime, seconds since epoch (fraction allowed)\n"
+              << "  --rpt-seq <n>       The book right after the instrument's update <n>\n"
+              << "  --depth <levels>    Price levels per side (default 10)\n"
+              << "  --capture <file>    Capture to replay, if it moved since the index was built"
+              << std::endl;
+}
+
+static void printSide(const char* name, const OrderBook& book, MDEntryType side, size_t depth) {
+    std::vector<PriceLevel> levels(depth);
+    size_t count = book.topLevels(side, levels.data(), depth);
+    for (size_t i = 0; i < count; ++i) {
+        std::cout << name << "," << i + 1 << "," << Decimal5{levels[i].price} << "," << levels[i].size << ","
+                  << levels[i].orders << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string indexFile;
+    std::string captureFile;
+    int32_t securityId = 0;
+    bool haveSecurityId = false;
+    uint64_t atNs = 0;
+    bool haveTime = false;
+    uint32_t rptSeq = 0;
+    bool haveRptSeq = false;
+    size_t depth = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--index" && i + 1 < argc) {
+            indexFile = argv[++i];
+        } else if (arg == "--security-id" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], securityId)) {
+                std::cerr << "Invalid SecurityID: " << argv[i] << std::endl;
+                return 1;
+            }
+            haveSecurityId = true;
+        } else if (arg == "--at" && i + 1 < argc) {
+            if (!ExtractFilter::parseTime(argv[++i], atNs)) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+            haveTime = true;
+        } else if (arg == "--rpt-seq" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], rptSeq)) {
+                std::cerr << "Invalid RptSeq: " << argv[i] << std::endl;
+                return 1;
+            }
+            haveRptSeq = true;
+        } else if (arg == "--depth" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], depth) || depth == 0) {
+                std::cerr << "Invalid depth: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--capture" && i + 1 < argc) {
+            captureFile = argv[++i];
+        } else {
+            indexFile.clear();
+            break;
+        }
+    }
+    if (indexFile.empty() || !haveSecurityId || haveTime == haveRptSeq) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Logger::init_log("simba.log");
+    auto started = std::chrono::steady_clock::now();
+
+    BookIndex index(indexFile);
+    if (!index.isValid()) {
+        Logger::close_log();
+        return 1;
+    }
+
+    // The image to start from and the boundary to replay from. Images are only written for books
+    // that changed, so the book is the same at every boundary up to its next image.
+    auto [first, last] = index.entriesOf(securityId);
+    const BookIndexEntry* image = nullptr;
+    size_t startBoundary = SIZE_MAX;   // SIZE_MAX: the image is the answer, nothing to replay
+    if (haveTime) {
+        startBoundary = index.boundaryAt(atNs);
+        for (const BookIndexEntry* entry = first; entry != last && entry->boundary <= startBoundary; ++entry) {
+            image = entry;
+        }
+    } else {
+        const BookIndexEntry* next = first;
+        for (; next != last && next->rptSeq <= rptSeq; ++next) {
+            image = next;
+        }
+        if (next != last) {
+            startBoundary = next->boundary - 1;
+        }
+    }
+
+    OrderBookManager books;
+    OrderBook& book = books.restoreBook(securityId);
+    if (image) {
+        index.restore(*image, book);
+    }
+
+    uint64_t packetsRead = 0;
+    uint64_t packetsDecoded = 0;
+    if (startBoundary != SIZE_MAX) {
+        const BookIndexBoundary& boundary = index.boundary(startBoundary);
+        if (captureFile.empty()) {
+            captureFile = index.pcapFile();
+        }
+        std::unique_ptr<SeekablePacketSource> capture;
+        if (PcapngReader::isPcapngFile(captureFile)) {
+            capture = std::make_unique<PcapngReader>(captureFile);
+        } else {
+            capture = std::make_unique<PCAPParser>(captureFile);
+        }
+        if (!capture->isValid() || capture->getFileSize() != index.pcapFileSize()) {
+            LOG_ERROR("Capture " << captureFile << " is unreadable or is not the one indexed ("
+                    << index.pcapFileSize() << " bytes)");
+            Logger::close_log();
+            return 1;
+        }
+        if (!capture->seek(boundary.pcapOffset)) {
+            Logger::close_log();
+            return 1;
+        }
+        LOG_INFO("Replaying " << captureFile << " from offset " << boundary.pcapOffset << " (boundary "
+                << startBoundary << ", TransactTime " << boundary.transactTime << ")");
+
+        // Only packets carrying the instrument are decoded; the others are skipped on their SecurityIDs
+        SimbaDecoder decoder;
+        CapturedPacket packet;
+        std::vector<DecodedEvent> events;
+        bool done = false;
+        while (!done && capture->nextPacket(packet)) {
+            packetsRead++;
+            uint16_t msgFlags;
+            uint64_t transactTime;
+            if (!PacketPeek::header(packet.data, packet.length, msgFlags, transactTime)) {
+                continue;
+            }
+            if (haveTime && transactTime > atNs) {
+                break;
+            }
+            bool mentioned = false;
+            PacketPeek::forEachSecurityId(packet.data, packet.length, [&](int32_t id, uint16_t) {
+                    mentioned = (id == securityId);
+                    return !mentioned;
+                });
+            if (!mentioned) {
+                continue;
+            }
+
+            // Every event of the payload: a packet may mix updates and executions
+            packetsDecoded++;
+            if (!decoder.decodeEvents(packet.data, packet.length, packet.captureTime, events)) {
+                continue;
+            }
+            for (const DecodedEvent& event : events) {
+                if (event.securityId() != securityId) {
+                    continue;
+                }
+                if (haveRptSeq) {
+                    uint32_t eventRptSeq = 0;
+                    switch (event.type) {
+                        case DecodedEventType::OrderUpdate: eventRptSeq = event.update.RptSeq; break;
+                        case DecodedEventType::OrderExecution: eventRptSeq = event.execution.RptSeq; break;
+                        case DecodedEventType::SnapshotBegin: eventRptSeq = event.snapshotBegin.RptSeq; break;
+                        case DecodedEventType::SnapshotEntry: eventRptSeq = event.snapshotEntry.RptSeq; break;
+                    }
+                    if (eventRptSeq > rptSeq) {
+                        done = true;
+                        break;
+                    }
+                }
+                books.apply(event);
+            }
+        }
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    LOG_INFO("Book of SecurityID " << securityId << " rebuilt in " << elapsedMs << " ms: "
+            << (image ? "image of boundary " + std::to_string(image->boundary) : std::string("no image"))
+            << ", " << packetsRead << " packets read, " << packetsDecoded << " decoded");
+
+    std::cout << "# SecurityID " << securityId << ", RptSeq " << book.getRptSeq() << ", " << book.orderCount()
+              << " orders; " << packetsRead << " packets replayed, " << packetsDecoded << " decoded in "
+              << elapsedMs << " ms\n"
+              << "side,level,price,size,orders\n";
+    printSide("bid", book, MDEntryType::Bid, depth);
+    printSide("ask", book, MDEntryType::Offer, depth);
+    std::cout.flush();
+
+    Logger::close_log();
+    return 0;
+}
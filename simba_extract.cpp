@@ -0,0 +1,92 @@
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "PCAPParser.h"
+#include "PcapExtractor.h"
+#include "PcapWriter.h"
+#include "log.h"
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input.pcap> <output.pcap>\n"
+              << "Copies the packets of selected instruments, channels and time range into a new capture\n"
+              << "Options:\n"
+              << "  --security-id <id>          Keep packets with a message of instrument <id> (repeatable)\n"
+              << "  --from <seconds>            Window start, seconds since epoch (fraction allowed)\n"
+              << "  --to <seconds>              Window end, inclusive\n"
+              << "  --channel <ip[:port]|:port> Keep packets sent to this UDP destination (repeatable)\n"
+              << "  --no-snapshots              Do not prepend the last snapshot cycle before --from"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    ExtractFilter filter;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--security-id" && i + 1 < argc) {
+            std::string_view text = argv[++i];
+            int32_t securityId = 0;
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), securityId);
+            if (error != std::errc() || end != text.data() + text.size()) {
+                std::cerr << "Invalid SecurityID: " << text << std::endl;
+                return 1;
+            }
+            filter.securityIds.push_back(securityId);
+        } else if ((arg == "--from" || arg == "--to") && i + 1 < argc) {
+            if (!ExtractFilter::parseTime(argv[++i], arg == "--from" ? filter.fromNs : filter.toNs)) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--channel" && i + 1 < argc) {
+            ExtractChannel channel;
+            if (!ExtractFilter::parseChannel(argv[++i], channel)) {
+                std::cerr << "Invalid channel: " << argv[i] << std::endl;
+                return 1;
+            }
+            filter.channels.push_back(channel);
+        } else if (arg == "--no-snapshots") {
+            filter.seedSnapshots = false;
+        } else if (!arg.starts_with("--")) {
+            files.push_back(arg);
+        } else {
+            files.clear();
+            break;
+        }
+    }
+    if (files.size() != 2 || filter.fromNs > filter.toNs) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Logger::init_log("simba.log");
+
+    PCAPParser input(files[0]);
+    if (!input.isValid()) {
+        LOG_ERROR("Failed to initialize PCAPParser");
+        Logger::close_log();
+        return 1;
+    }
+    PcapWriter output(files[1], input.getFileHeader());
+    if (!output.isValid()) {
+        Logger::close_log();
+        return 1;
+    }
+
+    PcapExtractor extractor(filter);
+    bool ok = extractor.run(input, output);
+    const ExtractStats& stats = extractor.getStats();
+    LOG_INFO("Extracted " << stats.packetsWritten << " of " << stats.packetsRead << " packets read into " << files[1]
+            << " (" << stats.seedPackets << " packets of " << stats.seedCycles << " snapshot cycles and "
+            << stats.seedUpdatePackets << " incremental packets before the window)");
+    if (stats.seedCyclesDropped > 0) {
+        LOG_WARNING(stats.seedCyclesDropped << " snapshot cycles were dropped as too old to seed the window");
+    }
+    std::cout << stats.packetsWritten << " packets written to " << files[1] << std::endl;
+
+    Logger::close_log();
+    return ok ? 0 : 1;
+}
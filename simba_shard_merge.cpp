@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ShardMerger.h"
+#include "log.h"
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <output> <shard export>...\n"
+              << "Merges the --csv or --jsonl exports of simba_decoder --shard i/K runs over one capture into\n"
+              << "a single export in capture order, e.g.\n"
+              << "  for i in 0 1 2 3; do simba_decoder --shard $i/4 --csv shard$i.csv day.pcap & done; wait\n"
+              << "  " << program << " day.csv shard0.csv shard1.csv shard2.csv shard3.csv"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.starts_with("--")) {
+            files.clear();
+            break;
+        }
+        files.push_back(arg);
+    }
+    if (files.size() < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Logger::init_log("simba.log");
+
+    ShardMerger merger(std::vector<std::string>(files.begin() + 1, files.end()), files[0]);
+    bool ok = merger.isValid() && merger.run();
+    LOG_INFO("Merged " << merger.getRowsWritten() << " rows of " << files.size() - 1 << " shards into " << files[0]);
+    std::cout << merger.getRowsWritten() << " rows written to " << files[0] << std::endl;
+
+    Logger::close_log();
+    return ok ? 0 : 1;
+}